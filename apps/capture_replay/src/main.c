@@ -0,0 +1,262 @@
+/**
+ * Copyright (C) 2017-2018, Decawave Limited, All Rights Reserved
+ * 
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ * 
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <assert.h>
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "sysinit/sysinit.h"
+#include "os/os.h"
+#include "bsp/bsp.h"
+#ifdef ARCH_sim
+#include "mcu/mcu_sim.h"
+#else
+#error "capture_replay is a host tool, build it for the native bsp"
+#endif
+
+#include <dw1000/dw1000_ftypes.h>
+#include <dw1000/dw1000_rng.h>
+#include <capture/dw1000_capture.h>
+#include <nrngtof/dw1000_nrngtof.h>
+#include "replay.h"
+
+typedef struct _replay_stats_t{
+    uint32_t npairs;
+    uint32_t ncompared;
+    uint32_t usec;
+    float max_delta;
+    double sum_delta;
+    double sum_delta2;
+}replay_stats_t;
+
+static int
+replay_class(uint16_t code, replay_class_t * class){
+
+    switch(code){
+        case DWT_SS_TWR ... DWT_SS_TWR_END:
+            *class = REPLAY_SS_TWR;
+            return 0;
+        case DWT_DS_TWR ... DWT_DS_TWR_END:
+        case DWT_DS_TWR_EXT ... DWT_DS_TWR_EXT_END:
+            *class = REPLAY_DS_TWR;
+            return 0;
+        case DWT_DS_TWR_NRNG ... DWT_DS_TWR_NRNG_END:
+        case DWT_DS_TWR_NRNG_EXT ... DWT_DS_TWR_NRNG_EXT_END:
+            *class = REPLAY_NRNG;
+            return 0;
+        default:
+            return -1;
+    }
+}
+
+static void
+replay_frame(const capture_block_t * block, uint16_t i, twr_frame_t * frame){
+
+    memset(frame, 0, sizeof(twr_frame_t));
+    frame->src_address = block->src ? block->src[i] : 0;
+    frame->dst_address = block->dst ? block->dst[i] : 0;
+    frame->code = block->code[i];
+    frame->request_timestamp = block->request[i];
+    frame->response_timestamp = block->response[i];
+    frame->reception_timestamp = block->reception[i];
+    frame->transmission_timestamp = block->transmission[i];
+}
+
+/*
+ * Rebuild the exchanges of [t0, t1] from the capture. A double sided record
+ * following a record of the same src/dst pair within REPLAY_PAIR_WINDOW is
+ * its final frame; an unmatched double sided record waits for its final.
+ */
+static uint32_t
+replay_load(capture_reader_t * reader, uint64_t t0, uint64_t t1, replay_pair_t * pairs, uint32_t npairs){
+
+    uint32_t n = 0;
+    replay_pair_t pending;
+    bool is_pending = false;
+    capture_block_t block;
+
+    for (uint32_t b = capture_reader_seek(reader, t0); b < reader->nblocks; b++){
+        if (capture_reader_block(reader, b, &block) != 0){
+            printf("{\"msg\": \"corrupt block %lu\"}\n", (unsigned long) b);
+            break;
+        }
+        if (block.header->utime_first > t1)
+            break;
+        for (uint16_t i = 0; i < block.nrecords && n < npairs; i++){
+            uint64_t utime = capture_block_utime(&block, i);
+            replay_class_t class;
+            if (utime < t0 || utime > t1 || replay_class(block.code[i], &class) != 0)
+                continue;
+
+            replay_pair_t * pair = &pairs[n];
+            replay_frame(&block, i, &pair->final);
+            pair->utime = utime;
+            pair->class = class;
+            pair->rssi_valid = block.rssi && block.rssi[i] != INT16_MIN;
+            pair->rssi = pair->rssi_valid ? block.rssi[i] : 0;
+            pair->fp_idx = block.fp_idx ? block.fp_idx[i] : 0;
+
+            if (class == REPLAY_SS_TWR){
+                pair->first = pair->final;
+                n++;
+                continue;
+            }
+            if (is_pending && pending.class == class
+                    && pending.final.src_address == pair->final.src_address
+                    && pending.final.dst_address == pair->final.dst_address
+                    && utime - pending.utime <= MYNEWT_VAL(REPLAY_PAIR_WINDOW)){
+                pair->first = pending.final;
+                is_pending = false;
+                n++;
+            }else{
+                pending = *pair;
+                is_pending = true;
+            }
+        }
+    }
+    return n;
+}
+
+static void
+replay_run(const replay_algorithm_t * algorithm, const replay_pair_t * pairs, uint32_t npairs,
+        float * range, replay_stats_t * stats){
+
+    memset(stats, 0, sizeof(replay_stats_t));
+    uint32_t tic = os_cputime_get32();
+    for (uint16_t loop = 0; loop < MYNEWT_VAL(REPLAY_NLOOPS); loop++){
+        if (algorithm->reset)
+            algorithm->reset(algorithm->state);
+        for (uint32_t i = 0; i < npairs; i++)
+            if (algorithm->classes & REPLAY_CLASS(pairs[i].class))
+                range[i] = algorithm->range(&pairs[i], algorithm->state);
+            else
+                range[i] = NAN;
+    }
+    stats->usec = os_cputime_ticks_to_usecs(os_cputime_get32() - tic);
+    for (uint32_t i = 0; i < npairs; i++)
+        if (!isnan(range[i]))
+            stats->npairs++;
+}
+
+/*
+ * Compare algorithm a with the reference of each exchange class, i.e. the
+ * first algorithm in the table handling that class.
+ */
+static void
+replay_compare(const replay_algorithm_t * algorithms, uint16_t a, const replay_pair_t * pairs,
+        const float * range, uint32_t npairs, replay_stats_t * stats){
+
+    uint16_t reference[REPLAY_NCLASSES];
+    for (uint16_t c = 0; c < REPLAY_NCLASSES; c++)
+        for (reference[c] = 0; reference[c] < a && !(algorithms[reference[c]].classes & REPLAY_CLASS(c)); reference[c]++);
+
+    for (uint32_t i = 0; i < npairs; i++){
+        uint16_t r = reference[pairs[i].class];
+        if (r == a || isnan(range[a * npairs + i]) || isnan(range[r * npairs + i]))
+            continue;
+        float delta = range[a * npairs + i] - range[r * npairs + i];
+        if (fabsf(delta) > stats->max_delta)
+            stats->max_delta = fabsf(delta);
+        stats->sum_delta += delta;
+        stats->sum_delta2 += (double) delta * delta;
+        stats->ncompared++;
+    }
+}
+
+int main(int argc, char **argv){
+
+    sysinit();
+    replay_algorithms_init();
+
+    const char * filename = getenv("CAPTURE_FILE") ? getenv("CAPTURE_FILE") : MYNEWT_VAL(REPLAY_FILE);
+    uint64_t t0 = getenv("CAPTURE_T0") ? strtoull(getenv("CAPTURE_T0"), NULL, 0) : 0;
+    uint64_t t1 = getenv("CAPTURE_T1") ? strtoull(getenv("CAPTURE_T1"), NULL, 0) : UINT64_MAX;
+
+    int fd = open(filename, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0){
+        printf("{\"msg\": \"cannot open %s\"}\n", filename);
+        exit(1);
+    }
+    void * base = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    assert(base != MAP_FAILED);
+
+    capture_reader_t reader;
+    if (capture_reader_open(&reader, base, st.st_size) != 0){
+        printf("{\"msg\": \"%s is not a capture\"}\n", filename);
+        exit(1);
+    }
+
+    replay_pair_t * pairs = (replay_pair_t *) malloc(sizeof(replay_pair_t) * (reader.nrecords + 1));
+    float * range = (float *) malloc(sizeof(float) * (reader.nrecords + 1) * replay_nalgorithms);
+    assert(pairs && range);
+    uint32_t npairs = replay_load(&reader, t0, t1, pairs, reader.nrecords);
+
+    printf("{\"replay\": \"%s\",\"nrecords\": %lu,\"nblocks\": %lu,\"indexed\": %d,\"npairs\": %lu}\n",
+            filename, (unsigned long) reader.nrecords, (unsigned long) reader.nblocks,
+            reader.index != NULL, (unsigned long) npairs);
+
+    replay_stats_t stats[replay_nalgorithms];
+    for (uint16_t a = 0; a < replay_nalgorithms; a++)
+        replay_run(&replay_algorithms[a], pairs, npairs, &range[a * npairs], &stats[a]);
+
+    for (uint16_t a = 0; a < replay_nalgorithms; a++){
+        replay_compare(replay_algorithms, a, pairs, range, npairs, &stats[a]);
+        uint32_t nranges = stats[a].npairs * MYNEWT_VAL(REPLAY_NLOOPS);
+        uint32_t ncompared = stats[a].ncompared ? stats[a].ncompared : 1;
+        printf("{\"algorithm\": \"%s\",\"npairs\": %lu,\"usec\": %lu,\"ranges_per_sec\": %.0f,"
+                "\"ncompared\": %lu,\"max_delta_mm\": %.3f,\"mean_delta_mm\": %.3f,\"rms_delta_mm\": %.3f}\n",
+                replay_algorithms[a].name,
+                (unsigned long) stats[a].npairs,
+                (unsigned long) stats[a].usec,
+                stats[a].usec ? 1e6 * nranges / stats[a].usec : 0.0,
+                (unsigned long) stats[a].ncompared,
+                1000 * stats[a].max_delta,
+                1000 * stats[a].sum_delta / ncompared,
+                1000 * sqrt(stats[a].sum_delta2 / ncompared)
+        );
+    }
+
+#if MYNEWT_VAL(REPLAY_DUMP)
+    printf("utime,src_address,dst_address,class,rssi");
+    for (uint16_t a = 0; a < replay_nalgorithms; a++)
+        printf(",%s", replay_algorithms[a].name);
+    printf("\n");
+    for (uint32_t i = 0; i < npairs; i++){
+        printf("%llu,0x%X,0x%X,%d,", (unsigned long long) pairs[i].utime,
+                pairs[i].final.src_address, pairs[i].final.dst_address, pairs[i].class);
+        if (pairs[i].rssi_valid)
+            printf("%.2f", pairs[i].rssi / 256.0f);
+        for (uint16_t a = 0; a < replay_nalgorithms; a++)
+            printf(",%.4f", range[a * npairs + i]);
+        printf("\n");
+    }
+#endif
+
+    munmap(base, st.st_size);
+    close(fd);
+    exit(0);
+    return 0;
+}
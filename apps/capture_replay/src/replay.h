@@ -0,0 +1,81 @@
+/**
+ * Copyright 2018, Decawave Limited, All Rights Reserved
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _REPLAY_H_
+#define _REPLAY_H_
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <dw1000/dw1000_ftypes.h>
+#include <dw1000/dw1000_rng.h>
+
+/*
+ * Exchange classes found in a capture. Single sided exchanges are one record,
+ * double sided and nranges exchanges are the first and final frame recorded
+ * back to back by the apps.
+ */
+typedef enum _replay_class_t{
+    REPLAY_SS_TWR = 0,
+    REPLAY_DS_TWR,
+    REPLAY_NRNG,
+    REPLAY_NCLASSES
+}replay_class_t;
+
+#define REPLAY_CLASS(c) (1UL << (c))
+#define REPLAY_ALL_CLASSES (REPLAY_CLASS(REPLAY_NCLASSES) - 1)
+
+typedef struct _replay_pair_t{
+    uint64_t utime;
+    replay_class_t class;
+    bool rssi_valid;                // rssi column captured and the level not empty
+    int16_t rssi;                   // dBm in Q8
+    uint16_t fp_idx;
+    twr_frame_t first;              // Equal to final for single sided exchanges
+    twr_frame_t final;
+}replay_pair_t;
+
+typedef struct _replay_algorithm_t{
+    const char * name;
+    uint32_t classes;               // Bitmask of replay_class_t handled
+    void (*reset)(void * state);    // Called before each pass over the session, may be NULL
+    float (*range)(const replay_pair_t * pair, void * state);    // Range in meters
+    void * state;
+}replay_algorithm_t;
+
+/*
+ * Algorithm table, the first entry handling a class is the reference the
+ * others are compared against.
+ */
+extern const replay_algorithm_t replay_algorithms[];
+extern const uint16_t replay_nalgorithms;
+
+void replay_algorithms_init(void);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* _REPLAY_H_ */
@@ -0,0 +1,161 @@
+/**
+ * Copyright 2018, Decawave Limited, All Rights Reserved
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <assert.h>
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+#include "os/os.h"
+
+#include <dw1000/dw1000_dev.h>
+#include <dw1000/dw1000_ftypes.h>
+#include <dw1000/dw1000_rng.h>
+#include <rssi/dw1000_rssi.h>
+#include <nrngtof/dw1000_nrngtof.h>
+#include <rngbias/dw1000_rngbias.h>
+#include <rngfilter/dw1000_rngfilter.h>
+#include "replay.h"
+
+/*
+ * The driver ToF routine reads the exchange out of rng->frames, so the pair is
+ * staged in a two frame instance mirroring dw1000_rng_init().
+ */
+static dw1000_rng_instance_t * g_rng;
+
+static float
+rng_twr_to_tof_range(const replay_pair_t * pair, void * state){
+
+    g_rng->frames[0] = (twr_frame_t *) &pair->first;
+    g_rng->frames[1] = (twr_frame_t *) &pair->final;
+    g_rng->idx = 1;
+    return dw1000_rng_tof_to_meters(dw1000_rng_twr_to_tof(g_rng));
+}
+
+/*
+ * dw1000_nranges_twr_to_tof_frames() of lib/nrngtof, as linked into the nranges apps.
+ */
+static float
+nranges_twr_to_tof_range(const replay_pair_t * pair, void * state){
+
+    return dw1000_rng_tof_to_meters(dw1000_nranges_twr_to_tof_frames(&pair->first, &pair->final));
+}
+
+/*
+ * Double precision reference, no clock offset correction on single sided exchanges.
+ */
+static float
+twr_double_range(const replay_pair_t * pair, void * state){
+
+    const twr_frame_t * first_frame = &pair->first;
+    const twr_frame_t * final_frame = &pair->final;
+    double T1R = (uint32_t)(first_frame->response_timestamp - first_frame->request_timestamp);
+    double T1r = (uint32_t)(first_frame->transmission_timestamp - first_frame->reception_timestamp);
+    double ToF;
+
+    if (pair->class == REPLAY_SS_TWR)
+        ToF = (T1R - T1r) / 2;
+    else{
+        double T2R = (uint32_t)(final_frame->response_timestamp - final_frame->request_timestamp);
+        double T2r = (uint32_t)(final_frame->transmission_timestamp - final_frame->reception_timestamp);
+        ToF = (T1R * T2R - T1r * T2r) / (T1R + T2R + T1r + T2r);
+    }
+    return dw1000_rng_tof_to_meters((float) ToF);
+}
+
+/*
+ * twr_double corrected with the lib/rngbias table of RNGBIAS_CHANNEL, on pairs
+ * captured with an rssi.
+ */
+static rngbias_instance_t g_rngbias;
+
+static float
+twr_double_rngbias_range(const replay_pair_t * pair, void * state){
+
+    float range = twr_double_range(pair, NULL);
+    if (!pair->rssi_valid)
+        return range;
+    return rngbias_correct((rngbias_instance_t *) state, range, pair->rssi);
+}
+
+/*
+ * twr_double through the lib/rngfilter median and alpha-beta tracker, links
+ * keyed as captured.
+ */
+static rngfilter_instance_t g_rngfilter;
+
+static void
+twr_double_rngfilter_reset(void * state){
+    rngfilter_reset((rngfilter_instance_t *) state);
+}
+
+static float
+twr_double_rngfilter_range(const replay_pair_t * pair, void * state){
+
+    rngfilter_output_t filtered;
+    float range = twr_double_range(pair, NULL);
+    rngfilter_update((rngfilter_instance_t *) state, pair->first.src_address, pair->first.dst_address,
+            (uint32_t) pair->utime, (int32_t)(range * 1000), &filtered);
+    return filtered.range_mm / 1000.0f;
+}
+
+const replay_algorithm_t replay_algorithms[] = {
+    {
+        .name = "rng_twr_to_tof",
+        .classes = REPLAY_CLASS(REPLAY_SS_TWR) | REPLAY_CLASS(REPLAY_DS_TWR),
+        .range = rng_twr_to_tof_range
+    },
+    {
+        .name = "nranges_twr_to_tof_frames",
+        .classes = REPLAY_CLASS(REPLAY_NRNG),
+        .range = nranges_twr_to_tof_range
+    },
+    {
+        .name = "twr_double",
+        .classes = REPLAY_ALL_CLASSES,
+        .range = twr_double_range
+    },
+    {
+        .name = "twr_double_rngbias",
+        .classes = REPLAY_ALL_CLASSES,
+        .range = twr_double_rngbias_range,
+        .state = &g_rngbias
+    },
+    {
+        .name = "twr_double_rngfilter",
+        .classes = REPLAY_ALL_CLASSES,
+        .reset = twr_double_rngfilter_reset,
+        .range = twr_double_rngfilter_range,
+        .state = &g_rngfilter
+    }
+};
+
+const uint16_t replay_nalgorithms = sizeof(replay_algorithms)/sizeof(replay_algorithm_t);
+
+void
+replay_algorithms_init(void){
+
+    g_rng = (dw1000_rng_instance_t *) malloc(sizeof(dw1000_rng_instance_t) + 2 * sizeof(twr_frame_t *));
+    assert(g_rng);
+    memset(g_rng, 0, sizeof(dw1000_rng_instance_t));
+    g_rng->nframes = 2;
+    rngbias_init(&g_rngbias, MYNEWT_VAL(RNGBIAS_CHANNEL), MYNEWT_VAL(RSSI_PRF64));
+    rngfilter_init(&g_rngfilter);
+}
@@ -0,0 +1,164 @@
+/**
+ * Copyright (C) 2017-2018, Decawave Limited, All Rights Reserved
+ * 
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ * 
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <assert.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "sysinit/sysinit.h"
+#include "os/os.h"
+#include "bsp/bsp.h"
+#ifdef ARCH_sim
+#include "mcu/mcu_sim.h"
+#else
+#error "discovery_sim is a host tool, build it for the native bsp"
+#endif
+
+#include <discovery_table/dw1000_discovery_table.h>
+
+/*
+ * Rounds of discovery with every node answering in its discovery_slot(), a
+ * slot with a single response is heard, two or more are a collision the
+ * requester sees as an rx error. Capture effect is not modelled.
+ */
+
+static const uint16_t sim_nnodes[] = {10, 32, 100, 300, 500};
+
+typedef struct _sim_result_t{
+    uint32_t t_ms;                  // Last node discovered, first request at 0
+    uint16_t nrounds;
+    uint16_t nslots;                // Window of the last round
+    uint32_t ncollisions;
+    uint32_t ndropped;              // Nodes aged out while present, should stay 0
+    bool complete;
+}sim_result_t;
+
+typedef struct _sim_legacy_t{
+    uint16_t nfound;                // Nodes in the list the tag rebuilds each period
+    uint16_t ncollisions;
+}sim_legacy_t;
+
+static discovery_table_t g_table;
+static uint16_t g_count[MYNEWT_VAL(DISCOVERY_NSLOTS_MAX)];
+static uint16_t g_owner[MYNEWT_VAL(DISCOVERY_NSLOTS_MAX)];
+static bool g_heard[MYNEWT_VAL(DISCOVERY_NNODES)];
+_Static_assert(MYNEWT_VAL(DISCOVERY_SIM_LEGACY_NODES) <= MYNEWT_VAL(DISCOVERY_NSLOTS_MAX), "legacy slots exceed the slot counters");
+
+static void
+sim_run(uint16_t nnodes, uint32_t seed, sim_result_t * result){
+    uint16_t nslots = 0, nresponses = 0, ncollisions = 0, nheard = 0;
+
+    memset(result, 0, sizeof(sim_result_t));
+    memset(g_heard, 0, sizeof(g_heard));
+    discovery_table_init(&g_table);
+
+    for (uint16_t round = 0; round < MYNEWT_VAL(DISCOVERY_SIM_MAX_ROUNDS) && nheard < nnodes; round++){
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+        nslots = discovery_nslots(g_table.nnodes, nresponses, ncollisions, nslots);
+        nresponses = 0;
+        ncollisions = 0;
+        memset(g_count, 0, nslots * sizeof(uint16_t));
+
+        for (uint16_t i = 0; i < nnodes; i++){
+            // Distinct addresses, an odd multiplier is a bijection on 16 bits
+            uint16_t address = i * 40503 + 0x1111;
+            uint16_t slot = discovery_slot(address, seed, nslots);
+            g_owner[slot] = i;
+            g_count[slot]++;
+        }
+        for (uint16_t s = 0; s < nslots; s++){
+            if (g_count[s] == 1){
+                discovery_table_heard(&g_table, g_owner[s] * 40503 + 0x1111);
+                nheard += !g_heard[g_owner[s]];
+                g_heard[g_owner[s]] = true;
+                nresponses++;
+            }else if (g_count[s] > 1)
+                ncollisions++;
+        }
+        discovery_table_round(&g_table);
+        result->ndropped += g_table.ndropped;
+
+        result->nrounds = round + 1;
+        result->nslots = nslots;
+        result->ncollisions += ncollisions;
+        result->t_ms = round * MYNEWT_VAL(DISCOVERY_SIM_PERIOD_MS)
+                + (MYNEWT_VAL(DISCOVERY_HOLDOFF_USEC) + (nslots + 1) * MYNEWT_VAL(DISCOVERY_SLOT_USEC)) / 1000;
+    }
+    result->complete = nheard == nnodes;
+}
+
+/*
+ * Slot_id ordered provisioning, node i answers in slot i % NUM_NODES and the
+ * tag rebuilds its list from the responses of each period. The slots are the
+ * same every period, so nodes sharing a slot collide every time and one
+ * period gives the steady state.
+ */
+static void
+sim_legacy(uint16_t nnodes, sim_legacy_t * result){
+    uint16_t nslots = MYNEWT_VAL(DISCOVERY_SIM_LEGACY_NODES);
+
+    memset(result, 0, sizeof(sim_legacy_t));
+    memset(g_count, 0, nslots * sizeof(uint16_t));
+    for (uint16_t i = 0; i < nnodes; i++)
+        g_count[i % nslots]++;
+    for (uint16_t s = 0; s < nslots; s++){
+        if (g_count[s] == 1)
+            result->nfound++;
+        else if (g_count[s] > 1)
+            result->ncollisions++;
+    }
+}
+
+int main(int argc, char **argv){
+
+    sysinit();
+
+    for (uint16_t n = 0; n < sizeof(sim_nnodes)/sizeof(sim_nnodes[0]); n++){
+        double t_ms = 0, nrounds = 0, ncollisions = 0, ndropped = 0;
+        uint32_t t_worst = 0;
+        uint16_t nslots_max = 0, nincomplete = 0;
+
+        for (uint16_t r = 0; r < MYNEWT_VAL(DISCOVERY_SIM_NRUNS); r++){
+            sim_result_t result;
+            sim_run(sim_nnodes[n], 0x9E3779B9UL * (r + 1), &result);
+            t_ms += (double) result.t_ms / MYNEWT_VAL(DISCOVERY_SIM_NRUNS);
+            nrounds += (double) result.nrounds / MYNEWT_VAL(DISCOVERY_SIM_NRUNS);
+            ncollisions += (double) result.ncollisions / MYNEWT_VAL(DISCOVERY_SIM_NRUNS);
+            ndropped += (double) result.ndropped / MYNEWT_VAL(DISCOVERY_SIM_NRUNS);
+            if (result.t_ms > t_worst)
+                t_worst = result.t_ms;
+            if (result.nslots > nslots_max)
+                nslots_max = result.nslots;
+            nincomplete += !result.complete;
+        }
+        printf("{\"discovery_sim\": {\"nnodes\": %d,\"t_ms\": %.0f,\"t_worst_ms\": %lu,\"rounds\": %.2f,"
+                "\"collisions\": %.1f,\"dropped\": %.2f,\"nslots_max\": %d,\"incomplete\": %d}}\n",
+                sim_nnodes[n], t_ms, (unsigned long) t_worst, nrounds, ncollisions, ndropped, nslots_max, nincomplete);
+
+        sim_legacy_t legacy;
+        sim_legacy(sim_nnodes[n], &legacy);
+        printf("{\"discovery_sim\": {\"nnodes\": %d,\"legacy_found\": %d,\"legacy_collisions\": %d,\"legacy_complete\": %d}}\n",
+                sim_nnodes[n], legacy.nfound, legacy.ncollisions, legacy.nfound == sim_nnodes[n]);
+    }
+    return 0;
+}
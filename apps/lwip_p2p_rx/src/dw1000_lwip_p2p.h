@@ -24,6 +24,7 @@
 
 #include <stdlib.h>
 #include <stdint.h>
+#include <os/os.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -39,6 +40,14 @@ extern "C" {
 #include "lwip/inet_chksum.h"
 #include "lwip/icmp.h"
 #include <netif/lowpan6.h>
+#if MYNEWT_VAL(LWIPSLOT_ENABLED)
+#include <lwipslot/dw1000_lwipslot.h>
+#endif
+
+/*
+ * Static sizing, the instance and its buffers are carved out at link time.
+ */
+#define LWIP_P2P_NLINKS ((MYNEWT_VAL(MAX_NUM_NODES) * (MYNEWT_VAL(MAX_NUM_NODES) - 1)) / 2)
 
 /*
  * LWIP p2p config structure
@@ -51,7 +60,6 @@ typedef struct _dw1000_lwip_p2p_config_t{
  * LWIP p2p status Structure
  */
 typedef struct _dw1000_lwip_p2p_status_t{
-    uint16_t selfmalloc:1;
     uint16_t initialized:1;
     uint16_t valid:1;
     uint16_t start_tx_error:1;
@@ -59,6 +67,7 @@ typedef struct _dw1000_lwip_p2p_status_t{
     uint16_t rx_error:1;
     uint16_t request_timeout_error:1;
     uint16_t timer_enabled:1;
+    uint16_t rx_overrun:1;
 }dw1000_lwip_p2p_status_t;
 
 typedef struct _dw1000_lwip_p2p_payload_t{
@@ -69,7 +78,6 @@ typedef struct _dw1000_lwip_p2p_payload_t{
 typedef struct _dw1000_lwip_p2p_payload_info_t{
     ip_addr_t ip_addr[4];
     uint16_t node_addr;
-    dw1000_lwip_p2p_payload_t input_payload;
     dw1000_lwip_p2p_payload_t output_payload;
 }dw1000_lwip_p2p_payload_info_t;
 
@@ -86,13 +94,20 @@ typedef struct _dw1000_lwip_p2p_instance_t{
     dw1000_lwip_p2p_config_t config;
     uint32_t idx;
     uint16_t nnodes;
-    dw1000_lwip_p2p_payload_info_t * payload_info[];
+    struct os_mempool pool;                 // Payload buffers, LWIP_P2P_NBUFS of LWIP_P2P_BUF_SIZE
+    uint16_t rx_head;
+    uint16_t rx_tail;
+    struct pbuf * rx_pbuf[MYNEWT_VAL(LWIP_P2P_RXQ_LEN)];   // Received pbufs awaiting the postprocess
+#if MYNEWT_VAL(LWIPSLOT_ENABLED)
+    lwipslot_instance_t lwipslot;           // Transmissions deferred to the TDMA data slot
+#endif
+    dw1000_lwip_p2p_payload_info_t * payload_info[LWIP_P2P_NLINKS];
 }dw1000_lwip_p2p_instance_t;
 
 
 /**
  * [dw1000_lwip_p2p_init description]
- * Function to initialize and allocate memory for lwip p2p service.
+ * Function to initialize lwip p2p service, the instance and payload pool are statically allocated.
  * @param  inst   [Device instance]
  * @param  nnodes [Number of nodes]
  * @return        [Return lwip p2p instance]
@@ -112,7 +127,7 @@ void dw1000_lwip_p2p_set_frames(dw1000_dev_instance_t * inst, uint16_t nnodes, d
 
 /**
  * [dw1000_lwip_p2p_free description]
- * Free the memory allocated for lwip p2p service/instance
+ * Release any pending received pbufs and mark the instance uninitialized
  * @param inst [Device instance]
  */
 void dw1000_lwip_p2p_free(dw1000_lwip_p2p_instance_t * inst);
@@ -149,9 +164,40 @@ void dw1000_lwip_p2p_start(dw1000_dev_instance_t * inst);
  */
 void dw1000_lwip_p2p_stop(dw1000_dev_instance_t * inst);
 
+/**
+ * [dw1000_lwip_p2p_recv description]
+ * Raw pcb receive callback. Takes ownership of the pbuf, strips the IP header
+ * and queues it for the postprocess without copying the payload.
+ * @return     [1 if the packet was eaten, 0 if the receive queue is full]
+ */
 uint8_t
 dw1000_lwip_p2p_recv(void *arg, struct raw_pcb *pcb, struct pbuf *p, const ip_addr_t *addr);
 
+/**
+ * [dw1000_lwip_p2p_rx_get description]
+ * Dequeue the oldest received pbuf. The caller owns the reference and must
+ * pbuf_free() it, or pbuf_ref() it to hold on to the data beyond the call.
+ * @param inst [Device instance]
+ * @return     [Received pbuf, p->payload points at the user payload, NULL if none pending]
+ */
+struct pbuf * dw1000_lwip_p2p_rx_get(dw1000_dev_instance_t * inst);
+
+/**
+ * [dw1000_lwip_p2p_payload_alloc description]
+ * Get a LWIP_P2P_BUF_SIZE payload buffer from the instance pool.
+ * @param inst [Device instance]
+ * @return     [Buffer, NULL if the pool is exhausted]
+ */
+void * dw1000_lwip_p2p_payload_alloc(dw1000_dev_instance_t * inst);
+
+/**
+ * [dw1000_lwip_p2p_payload_free description]
+ * Return a payload buffer to the instance pool.
+ * @param inst [Device instance]
+ * @param buf  [Buffer from dw1000_lwip_p2p_payload_alloc]
+ */
+void dw1000_lwip_p2p_payload_free(dw1000_dev_instance_t * inst, void * buf);
+
 void 
 dw1000_lwip_p2p_send(dw1000_dev_instance_t * inst, uint8_t idx);
 
@@ -39,7 +39,10 @@
 #include <dw1000/dw1000_rng.h>
 #include <dw1000/dw1000_ftypes.h>
 
-#if MYNEWT_VAL(DW1000_CLOCK_CALIBRATION)
+#if MYNEWT_VAL(LWIPSLOT_ENABLED)
+#include <ccp/dw1000_ccp.h>
+#include <tdma/dw1000_tdma.h>
+#elif MYNEWT_VAL(DW1000_CLOCK_CALIBRATION)
 #include <dw1000/dw1000_ccp.h>
 #endif
 #if MYNEWT_VAL(DW1000_LWIP)
@@ -82,6 +85,7 @@ static dw1000_lwip_p2p_node_address_t master_node_addr[1] = {
 
 #if MYNEWT_VAL(DW1000_LWIP_P2P)
 #define FRAME_LEN   10
+_Static_assert(FRAME_LEN <= MYNEWT_VAL(LWIP_P2P_BUF_SIZE), "FRAME_LEN exceeds LWIP_P2P_BUF_SIZE");
 void lwip_p2p_postprocess(struct os_event * ev){
     assert(ev != NULL);
     assert(ev->ev_arg != NULL);
@@ -89,10 +93,11 @@ void lwip_p2p_postprocess(struct os_event * ev){
 
     hal_gpio_toggle(LED_BLINK_PIN);
     dw1000_dev_instance_t * inst = (dw1000_dev_instance_t *)ev->ev_arg;
-    char * rx_frame = (char *)inst->lwip->lwip_p2p->payload_info[0]->input_payload.payload_ptr;
-    printf("%s Received\n",rx_frame);
-
-    dw1000_lwip_start_rx(inst,0);
+    struct pbuf * p;
+    while ((p = dw1000_lwip_p2p_rx_get(inst)) != NULL){
+        printf("%.*s Received\n", p->len, (char *)p->payload);
+        pbuf_free(p);
+    }
 }
 #endif
 
@@ -114,7 +119,12 @@ int main(int argc, char **argv){
     dw1000_set_address16(inst, inst->my_short_address);
 
     dw1000_mac_init(inst, NULL);
-#if MYNEWT_VAL(DW1000_CLOCK_CALIBRATION)
+#if MYNEWT_VAL(LWIPSLOT_ENABLED)
+    /* Follow the ranging network's clock master, data goes out in LWIPSLOT_SLOT */
+    dw1000_ccp_init(inst, 2, MYNEWT_VAL(UUID_CCP_MASTER));
+    dw1000_ccp_start(inst, CCP_ROLE_SLAVE);
+    tdma_init(inst, MYNEWT_VAL(TDMA_PERIOD), MYNEWT_VAL(TDMA_NSLOTS));
+#elif MYNEWT_VAL(DW1000_CLOCK_CALIBRATION)
     dw1000_ccp_init(inst, 2, MYNEWT_VAL(UUID_CCP_MASTER));
 #endif
 
@@ -134,15 +144,12 @@ int main(int argc, char **argv){
     IP_ADDR6(payload_info[0].ip_addr, MYNEWT_VAL(TGT_IP6_ADDR_1), MYNEWT_VAL(TGT_IP6_ADDR_2), 
                             MYNEWT_VAL(TGT_IP6_ADDR_3), MYNEWT_VAL(TGT_IP6_ADDR_4));
 
-    payload_info[0].output_payload.payload_ptr = (void *)malloc(sizeof(char) * FRAME_LEN);
-    payload_info[0].input_payload.payload_ptr = (void *)malloc(sizeof(char) * FRAME_LEN);
+    dw1000_lwip_p2p_init(inst, 2, master_node_addr, payload_info);
 
-    assert(payload_info[0].input_payload.payload_ptr != NULL);
+    payload_info[0].output_payload.payload_ptr = dw1000_lwip_p2p_payload_alloc(inst);
     assert(payload_info[0].output_payload.payload_ptr != NULL);
     payload_info[0].output_payload.payload_size = sizeof(char) * FRAME_LEN;
-    payload_info[0].input_payload.payload_size = sizeof(char) * FRAME_LEN;
 
-    dw1000_lwip_p2p_init(inst, 2, master_node_addr, payload_info);
     inst->lwip->dst_addr = 0x1234;
     dw1000_lwip_p2p_set_postprocess(inst, &lwip_p2p_postprocess);
 #endif
@@ -154,11 +161,25 @@ int main(int argc, char **argv){
     printf("lotID = 0x%lX\n",inst->lotID);
     printf("xtal_trim = 0x%X\n",inst->xtal_trim);
 
+#if MYNEWT_VAL(DW1000_LWIP_P2P)
+    dw1000_lwip_context_t * cntxt = (dw1000_lwip_context_t *)inst->lwip->lwip_netif.state;
+    assert(cntxt);
+    while (1) {
+        /* Frames only reach dw1000_lwip_p2p_recv through the netif, pump it as lwip_ping_rx does
+         * and run the events posted meanwhile, the postprocess among them.
+         */
+        cntxt->rx_cb.recv(inst, 0xffff);
+        struct os_event * ev;
+        while ((ev = os_eventq_get_no_wait(os_eventq_dflt_get())) != NULL)
+            ev->ev_cb(ev);
+    }
+#else
     dw1000_lwip_start_rx(inst,0);
-    
+
     while (1) {
         os_eventq_run(os_eventq_dflt_get());
     }
+#endif
     assert(0);
     return rc;
 }
\ No newline at end of file
@@ -43,6 +43,9 @@ static void lwip_p2p_complete_cb(dw1000_dev_instance_t * inst);
 static struct os_callout lwip_p2p_callout_timer;
 static struct os_callout lwip_p2p_callout_postprocess;
 
+static dw1000_lwip_p2p_instance_t lwip_p2p_inst;
+static os_membuf_t lwip_p2p_pool_buf[OS_MEMPOOL_SIZE(MYNEWT_VAL(LWIP_P2P_NBUFS), MYNEWT_VAL(LWIP_P2P_BUF_SIZE))];
+
 static void rx_complete_cb(dw1000_dev_instance_t * inst);
 static void tx_complete_cb(dw1000_dev_instance_t * inst);
 static void rx_timeout_cb(dw1000_dev_instance_t * inst);
@@ -94,20 +97,22 @@ dw1000_lwip_p2p_init(dw1000_dev_instance_t * inst, uint16_t nnodes,
                         dw1000_lwip_p2p_payload_info_t payload_info[]){
                         
     assert(inst);
+    assert(nnodes <= MYNEWT_VAL(MAX_NUM_NODES));
 
     if (inst->lwip->lwip_p2p == NULL ) {
-        inst->lwip->lwip_p2p = (dw1000_lwip_p2p_instance_t *)malloc( sizeof(dw1000_lwip_p2p_instance_t) + 
-                                    (nnodes-1) * ( (sizeof(dw1000_lwip_p2p_payload_info_t *)) + 
-                                        (sizeof(dw1000_lwip_p2p_node_address_t *))) );
-
-        assert(inst->lwip->lwip_p2p);
+        inst->lwip->lwip_p2p = &lwip_p2p_inst;
         memset(inst->lwip->lwip_p2p, 0, sizeof(dw1000_lwip_p2p_instance_t));
-        inst->lwip->lwip_p2p->status.selfmalloc = 1;
         inst->lwip->lwip_p2p->nnodes = nnodes;
     }
     else
         assert(inst->lwip->lwip_p2p->nnodes == nnodes);
 
+    if (!inst->lwip->lwip_p2p->status.initialized) {
+        os_error_t err = os_mempool_init(&inst->lwip->lwip_p2p->pool, MYNEWT_VAL(LWIP_P2P_NBUFS),
+                            MYNEWT_VAL(LWIP_P2P_BUF_SIZE), lwip_p2p_pool_buf, "lwip_p2p");
+        assert(err == OS_OK);
+    }
+
     dw1000_lwip_p2p_set_frames(inst, nnodes, node_addr, payload_info);
 
     inst->lwip->lwip_p2p->parent = inst;
@@ -117,6 +122,14 @@ dw1000_lwip_p2p_init(dw1000_dev_instance_t * inst, uint16_t nnodes,
 
     dw1000_lwip_p2p_set_callbacks(inst, lwip_p2p_complete_cb, tx_complete_cb, rx_complete_cb, rx_timeout_cb, rx_error_cb);
     dw1000_lwip_p2p_set_postprocess(inst, &lwip_p2p_postprocess);
+    raw_recv(inst->lwip->pcb, dw1000_lwip_p2p_recv, inst);
+#if MYNEWT_VAL(LWIPSLOT_ENABLED)
+    if (!inst->lwip->lwip_p2p->status.initialized) {
+        assert(inst->tdma);
+        lwipslot_init(&inst->lwip->lwip_p2p->lwipslot, inst, inst->tdma);
+        lwipslot_assign(&inst->lwip->lwip_p2p->lwipslot, MYNEWT_VAL(LWIPSLOT_SLOT));
+    }
+#endif
     inst->lwip->lwip_p2p->status.initialized = 1;
     return inst->lwip->lwip_p2p;
 }
@@ -128,7 +141,15 @@ dw1000_lwip_p2p_send(dw1000_dev_instance_t * inst, uint8_t idx){
     ip_addr_t *ipaddr =inst->lwip->lwip_p2p->payload_info[idx]->ip_addr;
     char * payload_p2p = (char *)inst->lwip->lwip_p2p->payload_info[idx]->output_payload.payload_ptr;
 
+#if MYNEWT_VAL(LWIPSLOT_ENABLED)
+    /* Queued by reference, sent in the next data slot. Leave the payload alone until its slot has passed */
+    if (lwipslot_pending(&inst->lwip->lwip_p2p->lwipslot))
+        return;
+    lwipslot_send(&inst->lwip->lwip_p2p->lwipslot, inst->lwip->lwip_p2p->payload_info[idx]->node_addr,
+                    ipaddr, payload_p2p, payload_size);
+#else
     dw1000_lwip_send(inst, payload_size, payload_p2p, ipaddr);
+#endif
 }
 
 inline void
@@ -145,10 +166,66 @@ void
 dw1000_lwip_p2p_free(dw1000_lwip_p2p_instance_t * inst){
 
     assert(inst);
-    if (inst->status.selfmalloc)
-        free(inst);
-    else
-        inst->status.initialized = 0;
+    struct pbuf * p;
+    /* No more pbufs may be queued once the queue is drained */
+    raw_recv(inst->parent->lwip->pcb, NULL, NULL);
+    while ((p = dw1000_lwip_p2p_rx_get(inst->parent)) != NULL)
+        pbuf_free(p);
+    inst->status.initialized = 0;
+}
+
+void *
+dw1000_lwip_p2p_payload_alloc(dw1000_dev_instance_t * inst){
+
+    return os_memblock_get(&inst->lwip->lwip_p2p->pool);
+}
+
+void
+dw1000_lwip_p2p_payload_free(dw1000_dev_instance_t * inst, void * buf){
+
+    os_error_t err = os_memblock_put(&inst->lwip->lwip_p2p->pool, buf);
+    assert(err == OS_OK);
+}
+
+uint8_t
+dw1000_lwip_p2p_recv(void *arg, struct raw_pcb *pcb, struct pbuf *p, const ip_addr_t *addr){
+
+    LWIP_UNUSED_ARG(pcb);
+    LWIP_UNUSED_ARG(addr);
+    dw1000_dev_instance_t * inst = (dw1000_dev_instance_t *)arg;
+    dw1000_lwip_p2p_instance_t * lwip_p2p = inst->lwip->lwip_p2p;
+
+    if (pbuf_header(p, -PBUF_IP_HLEN) != 0)
+        return 0;
+
+    /* The pbuf is queued as is, the postprocess reads the payload in place */
+    os_sr_t sr;
+    OS_ENTER_CRITICAL(sr);
+    if ((uint16_t)(lwip_p2p->rx_head - lwip_p2p->rx_tail) == MYNEWT_VAL(LWIP_P2P_RXQ_LEN)) {
+        OS_EXIT_CRITICAL(sr);
+        pbuf_header(p, PBUF_IP_HLEN);
+        lwip_p2p->status.rx_overrun = 1;
+        return 0;
+    }
+    lwip_p2p->rx_pbuf[lwip_p2p->rx_head++ % MYNEWT_VAL(LWIP_P2P_RXQ_LEN)] = p;
+    OS_EXIT_CRITICAL(sr);
+
+    inst->lwip->ext_complete_cb(inst);
+    return 1; /* eat the packet */
+}
+
+struct pbuf *
+dw1000_lwip_p2p_rx_get(dw1000_dev_instance_t * inst){
+
+    dw1000_lwip_p2p_instance_t * lwip_p2p = inst->lwip->lwip_p2p;
+    struct pbuf * p = NULL;
+
+    os_sr_t sr;
+    OS_ENTER_CRITICAL(sr);
+    if (lwip_p2p->rx_tail != lwip_p2p->rx_head)
+        p = lwip_p2p->rx_pbuf[lwip_p2p->rx_tail++ % MYNEWT_VAL(LWIP_P2P_RXQ_LEN)];
+    OS_EXIT_CRITICAL(sr);
+    return p;
 }
 
 void 
@@ -188,11 +265,9 @@ dw1000_lwip_p2p_stop(dw1000_dev_instance_t * inst){
 static void 
 rx_complete_cb(dw1000_dev_instance_t * inst){
 
-
-    uint32_t payload_size = inst->lwip->lwip_p2p->payload_info[0]->input_payload.payload_size;
-    
-    memcpy(inst->lwip->lwip_p2p->payload_info[0]->input_payload.payload_ptr, inst->lwip->payload_ptr, payload_size);
-    inst->lwip->ext_complete_cb(inst);
+    /* Payload is delivered by reference through dw1000_lwip_p2p_recv,
+     * which posts the postprocess once the pbuf is queued.
+     */
 }
 
 static void 
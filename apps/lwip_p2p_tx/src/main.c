@@ -38,7 +38,10 @@
 #include <dw1000/dw1000_rng.h>
 #include <dw1000/dw1000_ftypes.h>
 
-#if MYNEWT_VAL(DW1000_CLOCK_CALIBRATION)
+#if MYNEWT_VAL(LWIPSLOT_ENABLED)
+#include <ccp/dw1000_ccp.h>
+#include <tdma/dw1000_tdma.h>
+#elif MYNEWT_VAL(DW1000_CLOCK_CALIBRATION)
 #include <dw1000/dw1000_ccp.h>
 #endif
 
@@ -52,6 +55,7 @@
 struct dw1000_lwip_p2p_instance_t *lwip_p2p;
 
 #define FRAME_LEN   MYNEWT_VAL(PAYLOAD_STRING_LEN)
+_Static_assert(FRAME_LEN <= MYNEWT_VAL(LWIP_P2P_BUF_SIZE), "PAYLOAD_STRING_LEN exceeds LWIP_P2P_BUF_SIZE");
 #define RX_STATUS false
 
 ip_addr_t ip6_tgt_addr[LWIP_IPV6_NUM_ADDRESSES];
@@ -101,7 +105,12 @@ int main(int argc, char **argv){
 
     dw1000_mac_init(inst, NULL);
  
-#if MYNEWT_VAL(DW1000_CLOCK_CALIBRATION)
+#if MYNEWT_VAL(LWIPSLOT_ENABLED)
+    /* Follow the ranging network's clock master, data goes out in LWIPSLOT_SLOT */
+    dw1000_ccp_init(inst, 2, MYNEWT_VAL(UUID_CCP_MASTER));
+    dw1000_ccp_start(inst, CCP_ROLE_SLAVE);
+    tdma_init(inst, MYNEWT_VAL(TDMA_PERIOD), MYNEWT_VAL(TDMA_NSLOTS));
+#elif MYNEWT_VAL(DW1000_CLOCK_CALIBRATION)
     dw1000_ccp_init(inst, 2, MYNEWT_VAL(UUID_CCP_MASTER));
 #endif
 
@@ -121,18 +130,13 @@ int main(int argc, char **argv){
     IP_ADDR6(payload_info[0].ip_addr, MYNEWT_VAL(TGT_IP6_ADDR_1), MYNEWT_VAL(TGT_IP6_ADDR_2), 
                             MYNEWT_VAL(TGT_IP6_ADDR_3), MYNEWT_VAL(TGT_IP6_ADDR_4));
 
-    payload_info[0].output_payload.payload_ptr = (void *)malloc(sizeof(char) * FRAME_LEN);
-    payload_info[0].input_payload.payload_ptr = (void *)malloc(sizeof(char) * FRAME_LEN);
+    dw1000_lwip_p2p_init(inst, nnodes, node_addr, payload_info);
 
-    assert(payload_info[0].input_payload.payload_ptr != NULL);
+    payload_info[0].output_payload.payload_ptr = dw1000_lwip_p2p_payload_alloc(inst);
     assert(payload_info[0].output_payload.payload_ptr != NULL);
-
     payload_info[0].output_payload.payload_size = sizeof(char) * FRAME_LEN;
-    payload_info[0].input_payload.payload_size = sizeof(char) * FRAME_LEN;
-
 
     lwip_p2p_prep_tx_frame(inst, node_addr);
-    dw1000_lwip_p2p_init(inst, nnodes, node_addr, payload_info);
 
     dw1000_lwip_p2p_start(inst);
 #endif
@@ -156,5 +160,5 @@ int main(int argc, char **argv){
 void lwip_p2p_prep_tx_frame(dw1000_dev_instance_t *inst, dw1000_lwip_p2p_node_address_t node_addr[]){
 
     payload_info[0].node_addr = node_addr[0].node_addr;
-    payload_info[0].output_payload.payload_ptr = "Hello!";
+    strncpy((char *)payload_info[0].output_payload.payload_ptr, "Hello!", FRAME_LEN);
 }
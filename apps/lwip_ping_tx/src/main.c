@@ -43,6 +43,13 @@
 #include <lwip/ethip6.h>
 #include <netif/lowpan6.h>
 
+#if MYNEWT_VAL(LWIPSLOT_ENABLED)
+#include <ccp/dw1000_ccp.h>
+#include <tdma/dw1000_tdma.h>
+#include <lwipslot/dw1000_lwipslot.h>
+static lwipslot_instance_t g_lwipslot;
+#endif
+
 #define PING_ID	0xDDEE
 #define RX_STATUS false
 
@@ -91,13 +98,22 @@ static void timer_ev_cb(struct os_event *ev) {
 
     os_callout_reset(&blinky_callout, OS_TICKS_PER_SEC/SAMPLE_FREQ);
 
+#if MYNEWT_VAL(LWIPSLOT_ENABLED)
+	/* The payload is queued by reference, leave it alone until its slot has passed */
+	if (lwipslot_pending(&g_lwipslot))
+		return;
+#endif
 	struct ping_payload *ping_pl = (struct ping_payload*)payload;
 	ping_pl->src_addr = MYNEWT_VAL(SHORT_ADDRESS);
 	ping_pl->dst_addr = 0x4321;
 	ping_pl->ping_id = PING_ID;
 	ping_pl->seq_no  = seq_no++;
 
+#if MYNEWT_VAL(LWIPSLOT_ENABLED)
+	lwipslot_send(&g_lwipslot, inst->lwip->dst_addr, ip6_tgt_addr, payload, payload_size);
+#else
 	dw1000_lwip_send(inst, payload_size, payload, ip6_tgt_addr);
+#endif
 
 	printf("\n\tSeq # - %d\n\n", seq_no);
 
@@ -155,6 +171,14 @@ int main(int argc, char **argv){
 
     inst->lwip->dst_addr = 0x4321;
 
+#if MYNEWT_VAL(LWIPSLOT_ENABLED)
+    dw1000_ccp_init(inst, 2, MYNEWT_VAL(UUID_CCP_MASTER));
+    dw1000_ccp_start(inst, CCP_ROLE_SLAVE);
+    tdma_instance_t * tdma = tdma_init(inst, MYNEWT_VAL(TDMA_PERIOD), MYNEWT_VAL(TDMA_NSLOTS));
+    lwipslot_init(&g_lwipslot, inst, tdma);
+    lwipslot_assign(&g_lwipslot, MYNEWT_VAL(LWIPSLOT_SLOT));
+#endif
+
     IP_ADDR6(ip6_tgt_addr, MYNEWT_VAL(TGT_IP6_ADDR_1), MYNEWT_VAL(TGT_IP6_ADDR_2), 
                             MYNEWT_VAL(TGT_IP6_ADDR_3), MYNEWT_VAL(TGT_IP6_ADDR_4));
 
@@ -0,0 +1,52 @@
+function bias = bias_fit(csvfiles, truth, algorithm, channel, prf64)
+% BIAS_FIT  Fit a lib/rngbias table from replayed sessions with known distances.
+%   csvfiles  cell array of capture_replay REPLAY_DUMP outputs
+%   truth     [src_address dst_address distance_m] rows, either order of the pair
+%   algorithm replay algorithm column to fit against, e.g. 'twr_double'
+%   The bias is modelled piecewise linear on the lib/rngbias grid (-95dBm to
+%   -61dBm, 2dB steps) and solved in least squares with a small smoothness
+%   penalty. The table is printed as a rngbias_default_tables[] entry.
+
+if (nargin < 3) algorithm = 'twr_double'; end
+if (nargin < 4) channel = 5; end
+if (nargin < 5) prf64 = 1; end
+
+rssi_grid = -95:2:-61;
+npoints = numel(rssi_grid);
+rssi = []; err = [];
+
+for f=1:numel(csvfiles)
+    t = readtable(csvfiles{f});
+    src = hex2dec(strrep(t.src_address,'0x',''));
+    dst = hex2dec(strrep(t.dst_address,'0x',''));
+    for k=1:size(truth,1)
+        sel = ((src == truth(k,1) & dst == truth(k,2)) | (src == truth(k,2) & dst == truth(k,1))) & ~isnan(t.rssi);
+        rssi = [rssi; t.rssi(sel)];
+        err = [err; t.(algorithm)(sel) - truth(k,3)];
+    end
+end
+
+% Reject gross outliers (NLOS, missed first path) before fitting
+keep = abs(err - median(err)) < 5 * 1.4826 * mad(err, 1);
+rssi = rssi(keep); err = err(keep);
+
+% Hat function basis of the linear interpolation done on target
+x = min(max((rssi - rssi_grid(1)) / 2, 0), npoints - 1);
+i0 = min(floor(x), npoints - 2);
+w = x - i0;
+A = sparse([1:numel(x), 1:numel(x)], [i0 + 1; i0 + 2], [1 - w; w], numel(x), npoints);
+D = diff(speye(npoints), 2);
+lambda = 0.1 * numel(x) / npoints;
+bias = (A' * A + lambda * (D' * D)) \ (A' * err);
+
+hits = full(sum(A > 0, 1));
+fprintf('rms before %.1fmm, after %.1fmm, %d exchanges\n', 1000 * rms(err), 1000 * rms(err - A * bias), numel(err));
+fprintf('points without samples: %s\n', mat2str(rssi_grid(hits == 0)));
+fprintf('    {.channel = %d, .prf64 = %d, .bias_mm = {', channel, prf64);
+fprintf('%d, ', round(1000 * bias(1:end-1)));
+fprintf('%d}},\n', round(1000 * bias(end)));
+
+figure;
+plot(rssi, 1000 * err, '.', rssi_grid, 1000 * bias, '-o');
+xlabel('rssi (dBm)'); ylabel('range error (mm)'); grid on;
+title(sprintf('%s channel %d', algorithm, channel), 'Interpreter', 'none');
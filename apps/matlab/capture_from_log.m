@@ -0,0 +1,33 @@
+function capture_from_log(logfile, filename)
+% CAPTURE_FROM_LOG  Rebuild capture files from the {"capture":"..."} console
+%   lines emitted by apps built with CAPTURE_ENABLED=1. The apps close the
+%   capture every CAPTURE_SESSION_NRECORDS records and start a new one; each
+%   file header starts a new file, the n-th one after the first is written to
+%   filename with _n appended to its name.
+
+[path, name, ext] = fileparts(filename);
+fin = fopen(logfile, 'r');
+fout = -1;
+nfiles = 0;
+line = fgetl(fin);
+while ischar(line)
+    k = strfind(line, '{"capture":"');
+    if (~isempty(k))
+        chunk = line(k+12:end);
+        chunk = chunk(1:find(chunk == '"', 1) - 1);
+        data = matlab.net.base64decode(chunk);
+        if (numel(data) == 16 && typecast(uint8(data(1:4)),'uint32') == hex2dec('50435744'))
+            if (fout ~= -1) fclose(fout); end
+            if (nfiles == 0)
+                fout = fopen(filename, 'w');
+            else
+                fout = fopen(fullfile(path, sprintf('%s_%d%s', name, nfiles, ext)), 'w');
+            end
+            nfiles = nfiles + 1;
+        end
+        if (fout ~= -1) fwrite(fout, data, 'uint8'); end
+    end
+    line = fgetl(fin);
+end
+fclose(fin);
+if (fout ~= -1) fclose(fout); end
@@ -0,0 +1,75 @@
+function cap = capture_read(filename, t0, t1)
+% CAPTURE_READ  Read records of a lib/capture file with utime in [t0, t1] usec.
+%   The file is memory mapped; only the time index and the blocks covering
+%   the requested range are touched. Omit t0/t1 to read the whole capture.
+
+if (nargin < 2) t0 = 0; end
+if (nargin < 3) t1 = Inf; end
+
+names = {'utime','request','response','reception','transmission','src','dst','code','rssi','fp_idx','cir'};
+types = {'uint32','uint32','uint32','uint32','uint32','uint16','uint16','uint16','int16','uint16','int16'};
+widths = [4 4 4 4 4 2 2 2 2 2 4];
+
+m = memmapfile(filename, 'Format', 'uint8');
+len = numel(m.Data);
+header = m.Data(1:16);
+assert(typecast(header(1:4),'uint32') == hex2dec('50435744'), 'not a capture file');
+ncir = double(typecast(header(7:8),'uint16'));
+columns = double(typecast(header(9:12),'uint32'));
+widths(11) = 4 * ncir;
+
+% Time index from the trailer, or a walk of the block headers for a truncated stream
+% The index is only used while it holds one entry per block (stride 1)
+trailer = m.Data(len-23:len);
+index_offset = double(typecast(trailer(9:12),'uint32'));
+nentries = double(typecast(trailer(17:20),'uint32'));
+stride = double(typecast(trailer(21:24),'uint32'));
+if (typecast(trailer(1:4),'uint32') == hex2dec('58435744') && stride == 1 && index_offset + 24 * nentries + 24 == len)
+    index = memmapfile(filename, 'Offset', index_offset, 'Repeat', nentries, 'Format', ...
+        {'uint64',[1 1],'utime_first'; 'uint64',[1 1],'utime_last'; 'uint32',[1 1],'offset'; 'uint32',[1 1],'nrecords'});
+    utime_last = double([index.Data.utime_last]);
+    offsets = double([index.Data.offset]);
+else
+    utime_last = []; offsets = [];
+    offset = 16;
+    while (offset + 28 <= len && typecast(m.Data(offset+1:offset+4)','uint32') == hex2dec('42435744'))
+        offsets(end+1) = offset;
+        utime_last(end+1) = double(typecast(m.Data(offset+17:offset+24)','uint64'));
+        offset = offset + double(typecast(m.Data(offset+5:offset+8)','uint32'));
+    end
+end
+
+for c=1:numel(names) cap.(names{c}) = []; end
+cap.time = [];
+
+first = find(utime_last >= t0, 1);
+for b = first:numel(offsets)
+    offset = offsets(b);
+    utime_first = double(typecast(m.Data(offset+9:offset+16)','uint64'));
+    if (utime_first > t1) break; end
+    n = double(typecast(m.Data(offset+25:offset+26)','uint16'));
+    ptr = offset + 28;
+    block = struct();
+    for c=1:numel(names)
+        if (bitand(columns, 2^(c-1)))
+            bytes = m.Data(ptr+1:ptr+widths(c)*n)';
+            block.(names{c}) = double(typecast(bytes, types{c}));
+            ptr = ptr + widths(c)*n;
+        end
+    end
+    hi = utime_first - mod(utime_first, 2^32);
+    time = hi + block.utime + 2^32 * (block.utime < mod(utime_first, 2^32));
+    sel = (time >= t0) & (time <= t1);
+    cap.time = [cap.time, time(sel)];
+    for c=1:numel(names)
+        if (~isfield(block, names{c})) continue; end
+        if (strcmp(names{c}, 'cir'))
+            iq = reshape(block.cir, 2, ncir, n);
+            cir = squeeze(complex(iq(1,:,:), iq(2,:,:))).';
+            cap.cir = [cap.cir; reshape(cir(sel,:), [], ncir)];
+        else
+            cap.(names{c}) = [cap.(names{c}), block.(names{c})(sel)];
+        end
+    end
+end
+if (isfield(cap, 'rssi')) cap.rssi = cap.rssi / 256; end
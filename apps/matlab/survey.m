@@ -0,0 +1,87 @@
+function [addresses, xyz] = survey(logfiles, height)
+% SURVEY  Solve the anchor geometry from twr_node_nranges survey rows.
+%   logfiles  cell array of console logs of the nodes run with SURVEY_ENABLED
+%   height    common anchor height in m, the survey is solved in the plane
+%   Pairwise ranges are symmetrised (mean of both directions, weighted by
+%   the exchange counts), a classical MDS gives the initial layout and a
+%   Gauss-Newton refinement minimises the range residuals. The frame is
+%   fixed with the first anchor at the origin, the second on +x and the
+%   third at +y. The anchors are printed as lib/anchors config commands.
+
+if (nargin < 2) height = 0; end
+
+rows = [];
+for f=1:numel(logfiles)
+    logtext = fileread(logfiles{f});
+    tok = regexp(logtext, '"survey": \{"src": (\d+),"dst": (\d+),"range": (-?\d+),"n": (\d+)\}', 'tokens');
+    for k=1:numel(tok)
+        rows = [rows; cellfun(@str2double, tok{k})];
+    end
+end
+
+addresses = unique([rows(:,1); rows(:,2)]);
+n = numel(addresses);
+R = zeros(n); W = zeros(n);
+for k=1:size(rows,1)
+    i = find(addresses == rows(k,1)); j = find(addresses == rows(k,2));
+    R(i,j) = R(i,j) + rows(k,4) * rows(k,3) / 1000;
+    R(j,i) = R(j,i) + rows(k,4) * rows(k,3) / 1000;
+    W(i,j) = W(i,j) + rows(k,4);
+    W(j,i) = W(j,i) + rows(k,4);
+end
+known = W > 0;
+R(known) = R(known) ./ W(known);
+fprintf('%d anchors, %d of %d pairs ranged\n', n, nnz(triu(known, 1)), n * (n - 1) / 2);
+
+% Classical MDS, unranged pairs filled with the shortest path through ranged ones
+D = R; D(~known) = inf; D(logical(eye(n))) = 0;
+for k=1:n
+    D = min(D, D(:,k) + D(k,:));
+end
+J = eye(n) - ones(n) / n;
+B = -J * (D .^ 2) * J / 2;
+[V, L] = eig((B + B') / 2);
+[l, order] = sort(diag(L), 'descend');
+p = V(:, order(1:2)) * diag(sqrt(max(l(1:2), 0)));
+
+% Gauss-Newton on the ranged pairs, anchor 1 pinned to remove the translation
+[ii, jj] = find(triu(known, 1));
+for it=1:50
+    d = p(ii,:) - p(jj,:);
+    r = sqrt(sum(d .^ 2, 2));
+    res = R(sub2ind([n n], ii, jj)) - r;
+    u = d ./ r;
+    A = zeros(numel(ii), 2 * n);
+    for k=1:numel(ii)
+        A(k, 2 * ii(k) - 1:2 * ii(k)) = u(k,:);
+        A(k, 2 * jj(k) - 1:2 * jj(k)) = -u(k,:);
+    end
+    free = 3:2 * n;
+    step = zeros(2 * n, 1);
+    step(free) = pinv(A(:, free)) * res;
+    p = p + reshape(step, 2, n)';
+    if (norm(step) < 1e-5) break; end
+end
+d = p(ii,:) - p(jj,:);
+res = R(sub2ind([n n], ii, jj)) - sqrt(sum(d .^ 2, 2));
+fprintf('rms residual %.1fmm, worst %.1fmm, %d iterations\n', 1000 * rms(res), 1000 * max(abs(res)), it);
+
+% Anchor 1 at the origin, anchor 2 on +x, anchor 3 at +y
+p = p - p(1,:);
+a = atan2(p(2,2), p(2,1));
+p = p * [cos(a) -sin(a); sin(a) cos(a)];
+if (n > 2 && p(3,2) < 0) p(:,2) = -p(:,2); end
+xyz = [p, height * ones(n, 1)];
+
+% lib/anchors config entries, to paste into the tag shell
+for k=1:n
+    fprintf('config anchor/0x%04X %d,%d,%d\n', addresses(k), ...
+        round(1000 * xyz(k,1)), round(1000 * xyz(k,2)), round(1000 * xyz(k,3)));
+end
+fprintf('config save\n');
+
+figure;
+plot(xyz(:,1), xyz(:,2), 'o');
+text(xyz(:,1), xyz(:,2), arrayfun(@(a) sprintf(' 0x%04X', a), addresses, 'UniformOutput', false));
+xlabel('x (m)'); ylabel('y (m)'); axis equal; grid on;
+title('anchor survey');
@@ -42,6 +42,10 @@
 #include <pan/dw1000_provision.h>
 #include <pan/dw1000_pan.h>
 #endif
+#if MYNEWT_VAL(DISCOVERY_ENABLED)
+#include <discovery/dw1000_discovery.h>
+static discovery_instance_t g_discovery;
+#endif
 
 #define NUM_FRAMES 2
 #define NUM_NODES 32
@@ -114,7 +118,11 @@ int main(int argc, char **argv){
 
     printf("\nNODE:%d_______Address:0x%04X\n",inst->slot_id,inst->my_short_address);
 
+#if MYNEWT_VAL(DISCOVERY_ENABLED)
+    discovery_init(&g_discovery, inst);
+#else
     dw1000_provision_init(inst,config);
+#endif
     dw1000_set_rx_timeout(inst, 0);
     dw1000_start_rx(inst);
     init_timer(inst);
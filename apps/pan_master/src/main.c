@@ -38,6 +38,10 @@
 #include <dw1000/dw1000_rng.h>
 #include <dw1000/dw1000_ftypes.h>
 #include <pan/dw1000_pan.h>
+#include "pan_db.h"
+#if MYNEWT_VAL(PANJOIN_ENABLED)
+#include <panjoin/dw1000_panjoin.h>
+#endif
 
 #if MYNEWT_VAL(DW1000_CCP_ENABLED)
 #include <dw1000/dw1000_ccp.h>
@@ -67,15 +71,68 @@ static twr_frame_t twr[] = {
 };
 
 #if 1
-#define PAN_SIZE 16
-static uint16_t g_device_idx = 0;
-typedef struct _pan_db {
-    uint64_t UUID;
-    uint32_t short_address;
-    uint8_t slot_id;
-}pan_db_t;
+static pan_db_t g_pan_db;
+
+#if MYNEWT_VAL(PANJOIN_ENABLED)
+static panjoin_load_t g_panjoin_load;
+static struct os_callout g_beacon_callout;
+static uint32_t g_contention_end;       // cputime at the end of the current contention period
+#if MYNEWT_VAL(PANJOIN_BATCH)
+static panjoin_batch_frame_t g_batch;
+static struct os_callout g_batch_callout;
+
+static void
+batch_cb(struct os_event * ev){
+    dw1000_dev_instance_t * inst = (dw1000_dev_instance_t *)ev->ev_arg;
+
+    if (g_batch.nentries == 0)
+        return;
+    printf("{\"utime\":%lu,\"panjoin\": {\"batch\": %d}}\n",
+        os_cputime_ticks_to_usecs(os_cputime_get32()),
+        g_batch.nentries
+    );
+    panjoin_batch_send(inst, &g_batch);
+}
+#endif
+
+static void
+beacon_cb(struct os_event * ev){
+    dw1000_dev_instance_t * inst = (dw1000_dev_instance_t *)ev->ev_arg;
+    uint16_t nsuccess = g_panjoin_load.nsuccess;
+    uint16_t ncollision = g_panjoin_load.ncollision;
+    uint16_t load = panjoin_load_period(&g_panjoin_load);
+
+    if (nsuccess || ncollision)
+        printf("{\"utime\":%lu,\"panjoin\": {\"nsuccess\": %d,\"ncollision\": %d,\"load\": %d}}\n",
+            os_cputime_ticks_to_usecs(os_cputime_get32()),
+            nsuccess,
+            ncollision,
+            load
+        );
+    g_contention_end = os_cputime_get32() + os_cputime_usecs_to_ticks(
+        (MYNEWT_VAL(PANJOIN_NSLOTS) + 1) * MYNEWT_VAL(PANJOIN_SLOT_USEC));
+    panjoin_beacon_send(inst, load);
+    os_callout_reset(&g_beacon_callout, OS_TICKS_PER_SEC * MYNEWT_VAL(PANJOIN_PERIOD_MS) / 1000);
+#if MYNEWT_VAL(PANJOIN_BATCH)
+    // Assignments of the period go out together once it closes
+    os_callout_reset(&g_batch_callout, (uint64_t) OS_TICKS_PER_SEC
+        * (MYNEWT_VAL(PANJOIN_NSLOTS) + 1) * MYNEWT_VAL(PANJOIN_SLOT_USEC) / 1000000 + 1);
+#endif
+}
+
+static inline bool
+contention_period(void){
+    return (int32_t)(g_contention_end - os_cputime_get32()) > 0;
+}
 
-pan_db_t g_pan_db[PAN_SIZE];
+static bool
+rx_error_cb(dw1000_dev_instance_t * inst){
+    // A corrupted frame inside the contention period is taken as a collision of requests
+    if (contention_period())
+        panjoin_load_collision(&g_panjoin_load);
+    return false;
+}
+#endif
 
 static void 
 pan_master(struct os_event * ev){
@@ -85,6 +142,11 @@ pan_master(struct os_event * ev){
     dw1000_pan_instance_t * pan = inst->pan; 
     pan_frame_t * frame = pan->frames[(pan->idx)%pan->nframes]; 
 
+#if MYNEWT_VAL(PANJOIN_ENABLED)
+    // Requests of devices without panjoin arrive at any time, only the contention slots feed the estimate
+    if (contention_period())
+        panjoin_load_success(&g_panjoin_load);
+#endif
     //PAN Request frame
     printf("{\"utime\":%lu,\"UUID\":\"%llX\",\"seq_num\": %d}\n", 
         os_cputime_ticks_to_usecs(os_cputime_get32()),
@@ -92,33 +154,26 @@ pan_master(struct os_event * ev){
         frame->seq_num
     );
 
-    uint8_t i = 0;
-    for (i = 0; i < g_device_idx; i++){
-        if (g_pan_db[i%PAN_SIZE].UUID == frame->long_address) {
-             // Retransmit  
-            frame->pan_id = inst->PANID; 
-            frame->short_address = g_pan_db[i].short_address; 
-            frame->slot_id = g_pan_db[i].slot_id;
-            break;
-        }
-    }
-    if (i == g_device_idx){
+    pan_db_entry_t * entry = pan_db_find(&g_pan_db, frame->long_address);
+    if (entry == NULL){
         // Assign new IDs
-        g_pan_db[g_device_idx%PAN_SIZE].UUID = frame->long_address;
-        g_pan_db[g_device_idx%PAN_SIZE].slot_id = frame->slot_id = (g_device_idx + 1)%PAN_SIZE;
-        g_pan_db[g_device_idx%PAN_SIZE].short_address = frame->short_address = 0xDEC0 + g_device_idx + 1;
-        frame->pan_id = inst->PANID;
+        entry = pan_db_insert(&g_pan_db, frame->long_address);
+        if (entry == NULL){
+            // Refused rather than reassigning an address in use, the device retries
+            printf("{\"utime\":%lu,\"Warning\": \"PANIDs over subscribed\",\"nentries\":%d}\n", 
+                os_cputime_ticks_to_usecs(os_cputime_get32()),
+                g_pan_db.nentries
+            );
+            dw1000_set_rx_timeout(inst, 0);
+            dw1000_start_rx(inst);
+            return;
+        }
         frame->seq_num++;
-
-        g_device_idx++;
-    }
-    if(g_device_idx > PAN_SIZE)
-    {
-        printf("{\"utime\":%lu,\"Warning\": \"PANIDs over subscribed\",{\"g_device_idx\":%d}\n", 
-            os_cputime_ticks_to_usecs(os_cputime_get32()),
-            g_device_idx
-        );  
     }
+    // Retransmit of a known device gets its stored IDs back
+    frame->pan_id = inst->PANID; 
+    frame->short_address = entry->short_address; 
+    frame->slot_id = entry->slot_id;
 
     printf("{\"utime\":%lu,\"UUID\":\"%llX\",\"ID\":\"%X\",\"PANID\":\"%X\",\"SLOTID\":%d}\n", 
         os_cputime_ticks_to_usecs(os_cputime_get32()),
@@ -128,6 +183,16 @@ pan_master(struct os_event * ev){
         frame->slot_id
     );
 
+#if MYNEWT_VAL(PANJOIN_ENABLED) && MYNEWT_VAL(PANJOIN_BATCH)
+    if (panjoin_batch_add(&g_batch, frame->long_address, entry->short_address, entry->slot_id) == MYNEWT_VAL(PANJOIN_BATCH_NENTRIES)){
+        os_callout_stop(&g_batch_callout);
+        batch_cb(&g_batch_callout.c_ev);
+    }else{
+        dw1000_set_rx_timeout(inst, 0);
+        dw1000_start_rx(inst);
+    }
+    return;
+#endif
     dw1000_write_tx(inst, frame->array, 0, sizeof(pan_frame_resp_t));
     dw1000_write_tx_fctrl(inst, sizeof(pan_frame_resp_t), 0, true); 
     dw1000_set_wait4resp(inst, true);    
@@ -158,8 +223,26 @@ int main(int argc, char **argv){
     dw1000_ccp_init(inst, 2, inst->my_long_address);
     dw1000_ccp_start(inst);
 #endif
+    rc = pan_db_init(&g_pan_db);
+    printf("{\"utime\":%lu,\"pan_db\": {\"rc\": %d,\"nentries\": %d}}\n",
+        os_cputime_ticks_to_usecs(os_cputime_get32()),
+        rc,
+        g_pan_db.nentries
+    );
     dw1000_pan_init(inst, &pan_config);  
     dw1000_pan_set_postprocess(inst, pan_master);
+#if MYNEWT_VAL(PANJOIN_ENABLED)
+    dw1000_extension_callbacks_t cbs = {
+        .id = MYNEWT_VAL(PAN_MASTER_EXTENSION_ID),
+        .rx_error_cb = rx_error_cb
+    };
+    dw1000_add_extension_callbacks(inst, cbs);
+    os_callout_init(&g_beacon_callout, os_eventq_dflt_get(), beacon_cb, inst);
+#if MYNEWT_VAL(PANJOIN_BATCH)
+    os_callout_init(&g_batch_callout, os_eventq_dflt_get(), batch_cb, inst);
+#endif
+    os_callout_reset(&g_beacon_callout, OS_TICKS_PER_SEC * MYNEWT_VAL(PANJOIN_PERIOD_MS) / 1000);
+#endif
     dw1000_set_rx_timeout(inst, 0);
     dw1000_start_rx(inst);  
 
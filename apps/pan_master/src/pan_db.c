@@ -0,0 +1,199 @@
+/*
+ * Copyright 2018, Decawave Limited, All Rights Reserved
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <assert.h>
+#include <os/os.h>
+#include "syscfg/syscfg.h"
+#if MYNEWT_VAL(PAN_DB_FCB)
+#include <sysflash/sysflash.h>
+#endif
+
+#include "pan_db.h"
+
+#define PAN_DB_SIZE MYNEWT_VAL(PAN_DB_SIZE)
+#define PAN_DB_MAX (PAN_DB_SIZE - PAN_DB_SIZE / 8)     // Load factor bound on the probe length
+#define PAN_DB_BATCH MYNEWT_VAL(PAN_DB_BATCH)
+#define PAN_DB_MAGIC 0x42444150UL                       // "PADB"
+#define PAN_DB_VERSION 1
+_Static_assert((PAN_DB_SIZE & (PAN_DB_SIZE - 1)) == 0, "PAN_DB_SIZE must be a power of 2");
+
+static pan_db_entry_t *
+pan_db_lookup(pan_db_t * db, uint64_t UUID, bool insert){
+    if (UUID == 0)
+        return NULL;
+
+    uint32_t key = (uint32_t)(UUID ^ (UUID >> 32));
+    uint32_t h = (key * 2654435761UL) >> 16;
+
+    for (uint32_t i = 0; i < PAN_DB_SIZE; i++){
+        pan_db_entry_t * entry = &db->entries[(h + i) & (PAN_DB_SIZE - 1)];
+        if (entry->UUID == UUID)
+            return entry;
+        if (entry->UUID == 0){
+            if (!insert)
+                return NULL;
+            entry->UUID = UUID;
+            db->nentries++;
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+#if MYNEWT_VAL(PAN_DB_FCB)
+static int
+pan_db_load_cb(struct fcb_entry * loc, void * arg){
+    pan_db_t * db = (pan_db_t *) arg;
+    pan_db_entry_t buf[PAN_DB_BATCH];
+    uint16_t n = loc->fe_data_len / sizeof(pan_db_entry_t);
+
+    // Records hold whole batches, read back in chunks in case PAN_DB_BATCH shrank since
+    for (uint16_t i = 0; i < n; ){
+        uint16_t m = (n - i < PAN_DB_BATCH) ? n - i : PAN_DB_BATCH;
+        if (flash_area_read(loc->fe_area, loc->fe_data_off + i * sizeof(pan_db_entry_t), buf, m * sizeof(pan_db_entry_t)))
+            return 0;
+        for (uint16_t j = 0; j < m; j++){
+            if (buf[j].UUID == 0 || db->nentries >= PAN_DB_MAX)
+                continue;
+            pan_db_entry_t * entry = pan_db_lookup(db, buf[j].UUID, true);
+            entry->short_address = buf[j].short_address;
+            entry->slot_id = buf[j].slot_id;
+        }
+        i += m;
+    }
+    return 0;
+}
+
+static void
+pan_db_callout_cb(struct os_event * ev){
+    pan_db_flush((pan_db_t *) ev->ev_arg);
+}
+#endif
+
+int
+pan_db_init(pan_db_t * db){
+    assert(db);
+
+    memset(db, 0, sizeof(pan_db_t));
+#if MYNEWT_VAL(PAN_DB_FCB)
+    os_callout_init(&db->callout, os_eventq_dflt_get(), pan_db_callout_cb, db);
+
+    int cnt;
+    int rc = flash_area_to_sectors(MYNEWT_VAL(PAN_DB_FLASH_AREA), &cnt, NULL);
+    if (rc)
+        return rc;
+    if (cnt > MYNEWT_VAL(PAN_DB_NSECTORS))
+        return FCB_ERR_ARGS;
+    flash_area_to_sectors(MYNEWT_VAL(PAN_DB_FLASH_AREA), &cnt, db->sectors);
+
+    // Assignments are never released, no scratch sector is needed for rotation
+    db->fcb.f_magic = PAN_DB_MAGIC;
+    db->fcb.f_version = PAN_DB_VERSION;
+    db->fcb.f_sector_cnt = cnt;
+    db->fcb.f_scratch_cnt = 0;
+    db->fcb.f_sectors = db->sectors;
+
+    rc = fcb_init(&db->fcb);
+#if MYNEWT_VAL(PAN_DB_FLASH_OWNED)
+    if (rc){
+        // Corrupt content of an area reserved for the database, start over on a blank area
+        for (int i = 0; i < cnt; i++)
+            flash_area_erase(&db->sectors[i], 0, db->sectors[i].fa_size);
+        rc = fcb_init(&db->fcb);
+    }
+#endif
+    // The area may belong to another package, it is never erased here
+    if (rc)
+        return rc;
+    db->online = true;
+
+    uint32_t size = 0;
+    for (int i = 0; i < cnt; i++)
+        size += db->sectors[i].fa_size;
+    if (size < PAN_DB_MAX * (sizeof(pan_db_entry_t) + 1))
+        printf("{\"utime\":%lu,\"Warning\": \"pan_db flash area holds fewer entries than PAN_DB_SIZE\"}\n",
+            os_cputime_ticks_to_usecs(os_cputime_get32()));
+
+    return fcb_walk(&db->fcb, NULL, pan_db_load_cb, db);
+#else
+    return 0;
+#endif
+}
+
+pan_db_entry_t *
+pan_db_find(pan_db_t * db, uint64_t UUID){
+    return pan_db_lookup(db, UUID, false);
+}
+
+pan_db_entry_t *
+pan_db_insert(pan_db_t * db, uint64_t UUID){
+    if (db->nentries >= PAN_DB_MAX)
+        return NULL;
+    pan_db_entry_t * entry = pan_db_lookup(db, UUID, true);
+    if (entry == NULL)
+        return NULL;
+    entry->short_address = 0xDEC0 + db->nentries;
+    entry->slot_id = db->nentries % MYNEWT_VAL(PAN_DB_NSLOTS);
+
+#if MYNEWT_VAL(PAN_DB_FCB)
+    if (!db->online)
+        return entry;
+    if (db->npending == PAN_DB_BATCH)
+        pan_db_flush(db);           // Retry of a failed write
+    if (db->npending == PAN_DB_BATCH){
+        db->nerrors++;              // Kept in RAM only
+        return entry;
+    }
+    db->pending[db->npending++] = *entry;
+    if (db->npending == PAN_DB_BATCH)
+        pan_db_flush(db);
+    else if (db->npending == 1)
+        os_callout_reset(&db->callout, OS_TICKS_PER_SEC * MYNEWT_VAL(PAN_DB_FLUSH_MS) / 1000);
+#endif
+    return entry;
+}
+
+int
+pan_db_flush(pan_db_t * db){
+#if MYNEWT_VAL(PAN_DB_FCB)
+    struct fcb_entry loc;
+
+    if (!db->online || db->npending == 0)
+        return 0;
+    os_callout_stop(&db->callout);
+
+    uint16_t len = db->npending * sizeof(pan_db_entry_t);
+    int rc = fcb_append(&db->fcb, len, &loc);
+    if (rc == 0)
+        rc = flash_area_write(loc.fe_area, loc.fe_data_off, db->pending, len);
+    if (rc == 0)
+        rc = fcb_append_finish(&db->fcb, &loc);
+    if (rc){
+        db->nerrors++;
+        return rc;
+    }
+    db->nwrites++;
+    db->npending = 0;
+#endif
+    return 0;
+}
@@ -0,0 +1,105 @@
+/**
+ * Copyright 2018, Decawave Limited, All Rights Reserved
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _PAN_DB_H_
+#define _PAN_DB_H_
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <os/os.h>
+#include "syscfg/syscfg.h"
+#if MYNEWT_VAL(PAN_DB_FCB)
+#include <fcb/fcb.h>
+#include <flash_map/flash_map.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * PAN address database of the master. Assignments are held in an open
+ * addressed table keyed by the device UUID, a lookup is O(1) up to the
+ * PAN_DB_SIZE * 7/8 devices accepted. With PAN_DB_FCB new assignments are
+ * appended to an FCB log in batches of up to PAN_DB_BATCH entries and replayed
+ * into the table at boot, so a master reboot keeps every address it handed out. An address is
+ * never reassigned; once the table is full new devices are refused.
+ */
+
+typedef struct _pan_db_entry_t{
+    uint64_t UUID;                  // 0 marks a free entry
+    uint16_t short_address;
+    uint16_t slot_id;
+}__attribute__((__packed__)) pan_db_entry_t;
+
+typedef struct _pan_db_t{
+    uint16_t nentries;
+    uint16_t npending;              // Entries waiting for the next flash write
+    uint32_t nwrites;               // FCB records written
+    uint32_t nerrors;               // Failed flash writes, the entries stay pending
+    bool online;                    // FCB log usable, otherwise the table is kept in RAM only
+    struct os_callout callout;
+#if MYNEWT_VAL(PAN_DB_FCB)
+    struct fcb fcb;
+    struct flash_area sectors[MYNEWT_VAL(PAN_DB_NSECTORS)];
+#endif
+    pan_db_entry_t pending[MYNEWT_VAL(PAN_DB_BATCH)];
+    pan_db_entry_t entries[MYNEWT_VAL(PAN_DB_SIZE)];
+}pan_db_t;
+
+/**
+ * [pan_db_init description]
+ * Initialise the table and replay the assignments stored in flash.
+ * @param  db [Database]
+ * @return    [0 on success, an FCB error code if the flash log is unusable, the table then starts empty and stays in RAM]
+ */
+int pan_db_init(pan_db_t * db);
+
+/**
+ * [pan_db_find description]
+ * @param  db   [Database]
+ * @param  UUID [Device UUID]
+ * @return      [Entry, NULL if the device has no address]
+ */
+pan_db_entry_t * pan_db_find(pan_db_t * db, uint64_t UUID);
+
+/**
+ * [pan_db_insert description]
+ * Assign the next short address and slot to a device and queue the assignment for flash.
+ * @param  db   [Database]
+ * @param  UUID [Device UUID, not yet in the database]
+ * @return      [Entry, NULL if the database is full]
+ */
+pan_db_entry_t * pan_db_insert(pan_db_t * db, uint64_t UUID);
+
+/**
+ * [pan_db_flush description]
+ * Write the pending assignments as one FCB record.
+ * @param  db [Database]
+ * @return    [0 on success]
+ */
+int pan_db_flush(pan_db_t * db);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* _PAN_DB_H_ */
@@ -0,0 +1,180 @@
+/**
+ * Copyright (C) 2017-2018, Decawave Limited, All Rights Reserved
+ * 
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ * 
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <assert.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "sysinit/sysinit.h"
+#include "os/os.h"
+#include "bsp/bsp.h"
+#ifdef ARCH_sim
+#include "mcu/mcu_sim.h"
+#else
+#error "panjoin_sim is a host tool, build it for the native bsp"
+#endif
+
+#include <panjoin_backoff/dw1000_panjoin_backoff.h>
+
+/*
+ * Slotted model of the join: one beacon every PANJOIN_PERIOD_MS followed by
+ * PANJOIN_NSLOTS contention slots. A slot with a single request is a join,
+ * two or more are a collision the master detects, capture effect and lost
+ * beacons are not modelled.
+ */
+
+typedef enum _sim_policy_t{
+    SIM_FIXED = 0,                  // Retry every period in a random slot, no backoff
+    SIM_BACKOFF,                    // Binary exponential backoff, no load advertised
+    SIM_PANJOIN,                    // Backoff on the load advertised by the master
+    SIM_NPOLICIES
+}sim_policy_t;
+
+static const char * sim_policy_name[SIM_NPOLICIES] = {"fixed", "backoff", "panjoin"};
+static const uint16_t sim_ntags[] = {10, 100, 500};
+
+typedef struct _sim_tag_t{
+    panjoin_backoff_t backoff;
+    uint32_t boot_ms;
+    uint32_t join_ms;
+    bool joined;
+    bool pending;
+}sim_tag_t;
+
+typedef struct _sim_result_t{
+    uint32_t t_all_ms;              // Last tag joined, boot of the first at 0
+    double t_mean_ms;               // Mean boot to join
+    uint32_t nrequests;
+    uint32_t ncollisions;
+    bool complete;
+}sim_result_t;
+
+static uint32_t
+sim_hash(uint32_t x){
+    x = (x ^ 61) ^ (x >> 16);
+    x *= 9;
+    x ^= x >> 4;
+    x *= 0x27d4eb2d;
+    return x ^ (x >> 15);
+}
+
+static void
+sim_run(sim_policy_t policy, uint16_t ntags, uint32_t seed, sim_result_t * result){
+    sim_tag_t * tags = (sim_tag_t *) calloc(ntags, sizeof(sim_tag_t));
+    uint16_t count[MYNEWT_VAL(PANJOIN_NSLOTS)];
+    uint16_t owner[MYNEWT_VAL(PANJOIN_NSLOTS)];
+    int16_t * slot = (int16_t *) calloc(ntags, sizeof(int16_t));
+    panjoin_load_t master = {0};
+    uint16_t load = 0;
+    uint16_t njoined = 0;
+    uint32_t period;
+    assert(tags && slot);
+
+    memset(result, 0, sizeof(sim_result_t));
+    for (uint16_t i = 0; i < ntags; i++){
+        panjoin_backoff_init(&tags[i].backoff, sim_hash(seed * 65599 + i + 1));
+        tags[i].boot_ms = MYNEWT_VAL(PANJOIN_SIM_BOOT_MS) ? sim_hash(~(seed * 65599 + i)) % MYNEWT_VAL(PANJOIN_SIM_BOOT_MS) : 0;
+    }
+
+    for (period = 0; period < MYNEWT_VAL(PANJOIN_SIM_MAX_PERIODS) && njoined < ntags; period++){
+        uint32_t beacon_ms = period * MYNEWT_VAL(PANJOIN_PERIOD_MS);
+        memset(count, 0, sizeof(count));
+
+        for (uint16_t i = 0; i < ntags; i++){
+            sim_tag_t * tag = &tags[i];
+            slot[i] = -1;
+            if (tag->joined || tag->boot_ms > beacon_ms)
+                continue;
+            // Same order as the beacon handler of lib/panjoin
+            if (policy == SIM_PANJOIN)
+                panjoin_backoff_load(&tag->backoff, load);
+            if (tag->pending){
+                tag->pending = false;
+                panjoin_backoff_fail(&tag->backoff);
+            }
+            if (policy == SIM_FIXED)
+                slot[i] = sim_hash(seed * 65599 + i + 1 + period * 2654435761UL) % MYNEWT_VAL(PANJOIN_NSLOTS);
+            else
+                slot[i] = panjoin_backoff_slot(&tag->backoff, MYNEWT_VAL(PANJOIN_NSLOTS));
+            if (slot[i] >= 0){
+                tag->pending = true;
+                owner[slot[i]] = i;
+                count[slot[i]]++;
+                result->nrequests++;
+            }
+        }
+        for (uint16_t s = 0; s < MYNEWT_VAL(PANJOIN_NSLOTS); s++){
+            if (count[s] == 1){
+                sim_tag_t * tag = &tags[owner[s]];
+                tag->joined = true;
+                tag->pending = false;
+                tag->join_ms = beacon_ms + (s + 1) * MYNEWT_VAL(PANJOIN_SLOT_USEC) / 1000;
+                panjoin_load_success(&master);
+                njoined++;
+            }else if (count[s] > 1){
+                panjoin_load_collision(&master);
+                result->ncollisions++;
+            }
+        }
+        load = panjoin_load_period(&master);
+    }
+
+    result->complete = njoined == ntags;
+    for (uint16_t i = 0; i < ntags; i++){
+        if (!tags[i].joined)
+            continue;
+        if (tags[i].join_ms > result->t_all_ms)
+            result->t_all_ms = tags[i].join_ms;
+        result->t_mean_ms += (double)(tags[i].join_ms - tags[i].boot_ms) / njoined;
+    }
+    free(slot);
+    free(tags);
+}
+
+int main(int argc, char **argv){
+
+    sysinit();
+
+    for (uint16_t n = 0; n < sizeof(sim_ntags)/sizeof(sim_ntags[0]); n++){
+        for (uint16_t p = 0; p < SIM_NPOLICIES; p++){
+            double t_all = 0, t_mean = 0, nrequests = 0, ncollisions = 0;
+            uint32_t t_worst = 0;
+            uint16_t nincomplete = 0;
+
+            for (uint16_t r = 0; r < MYNEWT_VAL(PANJOIN_SIM_NRUNS); r++){
+                sim_result_t result;
+                sim_run((sim_policy_t) p, sim_ntags[n], r + 1, &result);
+                t_all += (double) result.t_all_ms / MYNEWT_VAL(PANJOIN_SIM_NRUNS);
+                t_mean += result.t_mean_ms / MYNEWT_VAL(PANJOIN_SIM_NRUNS);
+                nrequests += (double) result.nrequests / MYNEWT_VAL(PANJOIN_SIM_NRUNS);
+                ncollisions += (double) result.ncollisions / MYNEWT_VAL(PANJOIN_SIM_NRUNS);
+                if (result.t_all_ms > t_worst)
+                    t_worst = result.t_all_ms;
+                nincomplete += !result.complete;
+            }
+            printf("{\"panjoin_sim\": {\"ntags\": %d,\"policy\": \"%s\",\"t_all_ms\": %.0f,\"t_worst_ms\": %lu,"
+                    "\"t_mean_ms\": %.0f,\"requests_per_tag\": %.2f,\"collisions\": %.0f,\"incomplete\": %d}}\n",
+                    sim_ntags[n], sim_policy_name[p], t_all, (unsigned long) t_worst,
+                    t_mean, nrequests / sim_ntags[n], ncollisions, nincomplete);
+        }
+    }
+    return 0;
+}
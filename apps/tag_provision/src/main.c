@@ -45,6 +45,9 @@
 #include <pan/dw1000_provision.h>
 #include <pan/dw1000_pan.h>
 #endif
+#if MYNEWT_VAL(DISCOVERY_ENABLED)
+#include <discovery/dw1000_discovery.h>
+#endif
 
 #define NUM_NODES 32 
 #define NUM_FRAMES 2
@@ -67,6 +70,7 @@ static twr_frame_t twr[] = {
     }
 };
 
+#if !MYNEWT_VAL(DISCOVERY_ENABLED)
 static void provision_postprocess(struct os_event * ev){
     assert(ev != NULL);
     assert(ev->ev_arg != NULL);
@@ -87,6 +91,35 @@ static void provision_postprocess(struct os_event * ev){
     }
     dw1000_provision_start(inst);
 }
+#endif
+
+#if MYNEWT_VAL(DISCOVERY_ENABLED)
+static discovery_instance_t g_discovery;
+static struct os_callout discovery_callout;
+static bool discovery_reported;
+
+static void
+discovery_timer_cb(struct os_event * ev){
+    discovery_start(&g_discovery);
+}
+
+static void
+discovery_postprocess(struct os_event * ev){
+    assert(ev != NULL);
+    assert(ev->ev_arg != NULL);
+    discovery_instance_t * discovery = (discovery_instance_t *)ev->ev_arg;
+    discovery_table_t * table = &discovery->table;
+
+    // The table persists across rounds, print it once it settles
+    if (discovery->status.complete && !discovery_reported){
+        for(int i=0; i < table->nnodes; i++)
+            printf("Provisioned with Node : %x \n",table->addr[i]);
+        printf("Provision Completed \n");
+    }
+    discovery_reported = discovery->status.complete;
+    os_callout_reset(&discovery_callout, OS_TICKS_PER_SEC * MYNEWT_VAL(PROVISION_PERIOD) / 1000);
+}
+#endif
 
 int main(int argc, char **argv){
     int rc;
@@ -120,9 +153,16 @@ int main(int argc, char **argv){
 
     printf("\nTAG:%d_______Address:0x%04X\n",inst->slot_id,inst->my_short_address);
     
+#if MYNEWT_VAL(DISCOVERY_ENABLED)
+    discovery_init(&g_discovery, inst);
+    discovery_set_postprocess(&g_discovery, discovery_postprocess);
+    os_callout_init(&discovery_callout, os_eventq_dflt_get(), discovery_timer_cb, NULL);
+    discovery_start(&g_discovery);
+#else
     dw1000_provision_init(inst,config);
     dw1000_provision_set_postprocess(inst, &provision_postprocess);
     dw1000_provision_start(inst);
+#endif
     
     while (1) {
         os_eventq_run(os_eventq_dflt_get());
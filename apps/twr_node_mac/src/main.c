@@ -37,6 +37,7 @@
 #include <dw1000/dw1000_mac.h>
 #include <dw1000/dw1000_rng.h>
 #include <dw1000/dw1000_ftypes.h>
+#include <rssi/dw1000_rssi.h>
 
 #if MYNEWT_VAL(DW1000_CCP_ENABLED)
 #include <dw1000/dw1000_ccp.h>
@@ -123,7 +124,7 @@ static void timer_ev_cb(struct os_event *ev) {
     if (frame->code == DWT_SS_TWR_FINAL) {
             uint32_t time_of_flight = (uint32_t) dw1000_rng_twr_to_tof(rng);
             float range = dw1000_rng_tof_to_meters(dw1000_rng_twr_to_tof(rng));
-            float rssi = dw1000_get_rssi(inst);
+            int16_t rssi = dw1000_rssi_q8(inst);
             print_frame("trw=", frame);
             printf("{\"utime\": %lu,\"tof\": %lu,\"range\": %lu,\"res_req\": %lX,"
                    " \"rec_tra\": %lX, \"rssi\": %d}\n",
@@ -132,14 +133,14 @@ static void timer_ev_cb(struct os_event *ev) {
                     (uint32_t)(range * 1000),
                    (frame->response_timestamp - frame->request_timestamp),
                    (frame->transmission_timestamp - frame->reception_timestamp),
-                   (int)(rssi)
+                   rssi / 256
             );
     }
 
     if (frame->code == DWT_DS_TWR_FINAL || frame->code == DWT_DS_TWR_EXT_FINAL) {
             uint32_t time_of_flight = (uint32_t) dw1000_rng_twr_to_tof(rng);
             float range = dw1000_rng_tof_to_meters(dw1000_rng_twr_to_tof(rng));
-            float rssi = dw1000_get_rssi(inst);
+            int16_t rssi = dw1000_rssi_q8(inst);
             print_frame("1st=", previous_frame);
             print_frame("2nd=", frame);
             printf("{\"utime\": %lu,\"tof\": %lu,\"range\": %lu,\"res_req\": %lX,"
@@ -149,7 +150,7 @@ static void timer_ev_cb(struct os_event *ev) {
                     (uint32_t)(range * 1000), 
                    (frame->response_timestamp - frame->request_timestamp),
                    (frame->transmission_timestamp - frame->reception_timestamp),
-                    (int)(rssi)
+                    rssi / 256
                 );
             frame->code = DWT_DS_TWR_END;
     }
@@ -20,7 +20,9 @@
  */
 #include <stdio.h>
 #include <string.h>
+#include <stddef.h>
 #include <assert.h>
+#include "sysinit/sysinit.h"
 #include <os/os.h>
 #include <hal/hal_spi.h>
 #include <hal/hal_gpio.h>
@@ -36,6 +38,7 @@
 
 #if MYNEWT_VAL(N_RANGES_NPLUS_TWO_MSGS)
 #include <dw1000_nranges.h>
+#include <dispatch/dw1000_dispatch.h>
 
 static bool nranges_rx_complete_cb(dw1000_dev_instance_t * inst);
 static bool nranges_rx_error_cb(dw1000_dev_instance_t * inst);
@@ -44,6 +47,56 @@ static bool nranges_tx_complete_cb(dw1000_dev_instance_t* inst);
 static bool nranges_tx_error_cb(dw1000_dev_instance_t * inst);
 static dw1000_nranges_instance_t * nranges_instance;
 
+#if MYNEWT_VAL(N_RANGES_DBLBUFFER)
+/*
+ * Double buffered receive for the initiator. The N responses of a round arrive
+ * tx_holdoff_delay apart; with DIS_DRXB cleared the IC receives the next one into
+ * the second buffer while the host reads the current one, and RXAUTR re-enables
+ * the receiver after each frame. The host hands a buffer back with HRBPT.
+ * Enabled for the duration of a round only, other extensions expect a single buffer.
+ */
+static bool nranges_dblbuffer;
+
+static void
+nranges_set_dblbuffer(dw1000_dev_instance_t * inst, bool enable){
+    nranges_dblbuffer = enable;
+    uint32_t sys_cfg = (uint32_t) dw1000_read_reg(inst, SYS_CFG_ID, 0, sizeof(uint32_t));
+    if (enable)
+        sys_cfg = (sys_cfg & ~SYS_CFG_DIS_DRXB) | SYS_CFG_RXAUTR;
+    else
+        sys_cfg = (sys_cfg | SYS_CFG_DIS_DRXB) & ~SYS_CFG_RXAUTR;
+    dw1000_write_reg(inst, SYS_CFG_ID, 0, sys_cfg, sizeof(uint32_t));
+#if MYNEWT_VAL(N_RANGES_SPIQ)
+    // RXAUTR is in the SYS_CFG byte the queue rewrites with RXWTOE
+    spiq_sync_sys_cfg(&nranges_instance->spiq, sys_cfg);
+#endif
+}
+
+static inline void
+nranges_release_rxbuf(dw1000_dev_instance_t * inst){
+    dw1000_write_reg(inst, SYS_CTRL_ID, SYS_CTRL_HRBT_OFFSET, 1, sizeof(uint8_t));
+}
+
+static void
+nranges_sync_rxbufptrs(dw1000_dev_instance_t * inst){
+    // ICRBP and HSRBP are bits 7 and 6 of the top status byte
+    uint8_t status = (uint8_t) dw1000_read_reg(inst, SYS_STATUS_ID, 3, sizeof(uint8_t));
+    if (((status >> 7) ^ (status >> 6)) & 1)
+        nranges_release_rxbuf(inst);
+}
+#endif
+
+/*
+ * Fetch the TX and RX stamps with one transaction per register file and derive the
+ * low 32-bit views, in place of separate rxtime, txtime_lo and rxtime_lo reads.
+ */
+void
+dw1000_nranges_read_timestamps(dw1000_dev_instance_t * inst, dw1000_nranges_timestamps_t * timestamps){
+    timestamps->tx = dw1000_read_reg(inst, TX_TIME_ID, TX_TIME_TX_STAMP_OFFSET, TX_TIME_TX_STAMP_LEN) & 0x0FFFFFFFFFFULL;
+    timestamps->rx = dw1000_read_reg(inst, RX_TIME_ID, RX_TIME_RX_STAMP_OFFSET, RX_TIME_RX_STAMP_LEN) & 0x0FFFFFFFFFFULL;
+    timestamps->tx_lo = (uint32_t) timestamps->tx;
+    timestamps->rx_lo = (uint32_t) timestamps->rx;
+}
 
 dw1000_nranges_instance_t *
 dw1000_nranges_init(dw1000_dev_instance_t * inst,  dw1000_nranges_instance_t * nranges){
@@ -63,10 +116,48 @@ dw1000_nranges_init(dw1000_dev_instance_t * inst,  dw1000_nranges_instance_t * n
     nranges_cbs.rx_error_cb = nranges_rx_error_cb;
     nranges_cbs.tx_error_cb = nranges_tx_error_cb;
     dw1000_nranges_set_ext_callbacks(inst, nranges_cbs);
+#if MYNEWT_VAL(N_RANGES_HOLDOFF_CAL)
+    holdoff_init(&nranges->holdoff, inst, inst->rng->config);
+    holdoff_start(&nranges->holdoff);
+#endif
+#if MYNEWT_VAL(N_RANGES_SPIQ)
+    // The driver transfers are blocking, nothing else is installed on the bus
+    spiq_init(&nranges->spiq, inst, NULL, NULL);
+#endif
+#if MYNEWT_VAL(N_RANGES_PREARM)
+    if (!nranges->initiator)
+        dw1000_nranges_prearm(inst);
+#endif
 
     return nranges;
 }
 
+/*
+ * Stage the static part of the T1 response (fctrl, PANID, src_address, code) and
+ * TX_FCTRL while the responder is idle, so that on receipt of a request only the
+ * seq_num, the timestamps and, when the initiator changes, dst_address are written
+ * ahead of the delayed start. Every nranges path that rewrites the tx buffer or
+ * TX_FCTRL clears the staging and the module re-arms after its own final; other
+ * transmissions on a responder, or an address change, must be followed by a call
+ * to this function.
+ */
+void
+dw1000_nranges_prearm(dw1000_dev_instance_t * inst){
+    assert(nranges_instance);
+    dw1000_nranges_instance_t * nranges = nranges_instance;
+    twr_frame_t frame;
+
+    memset(&frame, 0, sizeof(twr_frame_t));
+    frame.fctrl = FCNTL_IEEE_N_RANGES_16;
+    frame.PANID = inst->PANID;
+    frame.src_address = inst->my_short_address;
+    frame.code = DWT_DS_TWR_NRNG_T1;
+    dw1000_write_tx(inst, frame.array, 0, sizeof(ieee_rng_response_frame_t));
+    dw1000_write_tx_fctrl(inst, sizeof(ieee_rng_response_frame_t), 0, true);
+    nranges->prearmed = 1;
+    nranges->prearmed_dst = frame.dst_address;
+}
+
 dw1000_dev_status_t
 dw1000_nranges_request(dw1000_dev_instance_t * inst, uint16_t dst_address, dw1000_nranges_modes_t code){
 
@@ -84,6 +175,11 @@ dw1000_nranges_request(dw1000_dev_instance_t * inst, uint16_t dst_address, dw100
     frame->code = code;
     frame->src_address = inst->my_short_address;
     frame->dst_address = dst_address;
+#if MYNEWT_VAL(N_RANGES_DBLBUFFER)
+    nranges_sync_rxbufptrs(inst);
+    nranges_set_dblbuffer(inst, true);
+#endif
+    nranges->prearmed = 0;
     dw1000_write_tx(inst, frame->array, 0, sizeof(ieee_rng_request_frame_t));
     dw1000_write_tx_fctrl(inst, sizeof(ieee_rng_request_frame_t), 0, true);
     dw1000_set_wait4resp(inst, true);
@@ -103,6 +199,11 @@ dw1000_nranges_request(dw1000_dev_instance_t * inst, uint16_t dst_address, dw100
         os_sem_release(&nranges->sem);
     }
     err = os_sem_pend(&nranges->sem, OS_TIMEOUT_NEVER); // Wait for completion of transactions
+#if MYNEWT_VAL(N_RANGES_DBLBUFFER)
+    dw1000_phy_forcetrxoff(inst);
+    nranges_set_dblbuffer(inst, false);
+    nranges_sync_rxbufptrs(inst);
+#endif
     os_sem_release(&nranges->sem);
    return inst->status;
 }
@@ -110,9 +211,6 @@ dw1000_nranges_request(dw1000_dev_instance_t * inst, uint16_t dst_address, dw100
 
 static bool
 nranges_rx_timeout_cb(dw1000_dev_instance_t * inst){
-    if(inst->fctrl != FCNTL_IEEE_N_RANGES_16){
-        return false;
-    }
     assert(nranges_instance);
     dw1000_nranges_instance_t * nranges = nranges_instance;
     dw1000_rng_instance_t * rng = inst->rng;
@@ -121,6 +219,11 @@ nranges_rx_timeout_cb(dw1000_dev_instance_t * inst){
 
     if(nranges->initiator)// only if the device is an initiator
     {
+#if MYNEWT_VAL(N_RANGES_DBLBUFFER)
+        // The receiver is off, hand back a buffer still held by the host before rx or the final restarts it
+        if (nranges_dblbuffer)
+            nranges_sync_rxbufptrs(inst);
+#endif
         nranges->timeout_count++;
         if(nranges->resp_count == 0 && nranges->timeout_count == nranges->nnodes)
         {
@@ -157,9 +260,6 @@ nranges_rx_timeout_cb(dw1000_dev_instance_t * inst){
 static bool
 nranges_rx_error_cb(dw1000_dev_instance_t * inst){
     /* Place holder */
-    if(inst->fctrl != FCNTL_IEEE_N_RANGES_16){
-        return false;
-    }
     assert(nranges_instance);
     dw1000_nranges_instance_t * nranges = nranges_instance;
     os_error_t err = os_sem_release(&nranges->sem);
@@ -170,41 +270,73 @@ nranges_rx_error_cb(dw1000_dev_instance_t * inst){
 static bool
 nranges_tx_complete_cb(dw1000_dev_instance_t * inst){
     /* Place holder */
-   if(inst->fctrl != FCNTL_IEEE_N_RANGES_16){
-        return false;
-    }
     if(DWT_DS_TWR_NRNG_FINAL){
         if (inst->rng_complete_cb) {
             inst->rng_complete_cb(inst);
         }
     }
+#if MYNEWT_VAL(N_RANGES_PREARM)
+    assert(nranges_instance);
+    if (!nranges_instance->initiator && !nranges_instance->prearmed)
+        dw1000_nranges_prearm(inst);
+#endif
     return true;
 }
 
 static bool
 nranges_tx_error_cb(dw1000_dev_instance_t * inst){
     /* Place holder */
-    if(inst->fctrl != FCNTL_IEEE_N_RANGES_16){
-        return false;
-    }
     return true;
 }
 
+/*
+ * Delayed response transmission, reported to the holdoff runtime watch.
+ */
+static inline dw1000_dev_status_t
+nranges_start_tx(dw1000_dev_instance_t * inst){
+    dw1000_dev_status_t status = dw1000_start_tx(inst);
+#if MYNEWT_VAL(N_RANGES_HOLDOFF_CAL)
+    holdoff_tx(&nranges_instance->holdoff, status.start_tx_error);
+#endif
+    return status;
+}
+
+#if MYNEWT_VAL(N_RANGES_SPIQ)
+/*
+ * Completion of a queued response, SPI interrupt context.
+ */
+static void
+nranges_spiq_complete_cb(spiq_instance_t * spiq, void * arg){
+    dw1000_nranges_instance_t * nranges = (dw1000_nranges_instance_t *) arg;
+#if MYNEWT_VAL(N_RANGES_HOLDOFF_CAL)
+    if (nranges->holdoff_queued && !spiq->status.spi_error)
+        holdoff_sample_systime(&nranges->holdoff, nranges->holdoff_rx_timestamp, nranges->holdoff_systime);
+    nranges->holdoff_queued = 0;
+    holdoff_tx(&nranges->holdoff, spiq->status.start_tx_error);
+#endif
+    if (spiq->status.start_tx_error)
+        os_sem_release(&nranges->sem);
+}
+#endif
+
 static bool
 nranges_rx_complete_cb(dw1000_dev_instance_t * inst){
     /* Place holder */
-     if(inst->fctrl != FCNTL_IEEE_N_RANGES_16){
-        return false;
-    }
     assert(nranges_instance);
     dw1000_nranges_instance_t * nranges = nranges_instance;
     uint16_t code, dst_address;
     dw1000_rng_config_t * config = inst->rng->config;
     dw1000_dev_control_t control = inst->control_rx_context;
-    dw1000_read_rx(inst, (uint8_t *) &code, offsetof(ieee_rng_request_frame_t,code), sizeof(uint16_t));
+    code = dispatch_rx_code(inst);
     dw1000_read_rx(inst, (uint8_t *) &dst_address, offsetof(ieee_rng_request_frame_t,dst_address), sizeof(uint16_t));
 
     if (dst_address != inst->my_short_address && dst_address != BROADCAST_ADDRESS){
+#if MYNEWT_VAL(N_RANGES_DBLBUFFER)
+        if (nranges_dblbuffer){
+            nranges_release_rxbuf(inst);
+            return true;
+        }
+#endif
         inst->control = inst->control_rx_context;
         dw1000_restart_rx(inst, control);
         return true;
@@ -236,14 +368,73 @@ nranges_rx_complete_cb(dw1000_dev_instance_t * inst){
                         frame->src_address = inst->my_short_address;
                         frame->code = DWT_DS_TWR_NRNG_T1;
 
-                        dw1000_write_tx(inst, frame->array, 0, sizeof(ieee_rng_response_frame_t));
-                        dw1000_write_tx_fctrl(inst, sizeof(ieee_rng_response_frame_t), 0, true);
+#if MYNEWT_VAL(N_RANGES_SPIQ)
+                        spiq_instance_t * spiq = &nranges->spiq;
+                        spiq_begin(spiq);
+#if MYNEWT_VAL(N_RANGES_PREARM)
+                        if (nranges->prearmed){
+                            // fctrl, PANID, src_address and code are staged, dst_address only changes with the initiator
+                            uint16_t offset = offsetof(ieee_rng_response_frame_t, seq_num);
+                            spiq_write_tx(spiq, frame->array + offset, offset, sizeof(frame->seq_num));
+                            if (frame->dst_address != nranges->prearmed_dst){
+                                offset = offsetof(ieee_rng_response_frame_t, dst_address);
+                                spiq_write_tx(spiq, frame->array + offset, offset, sizeof(frame->dst_address));
+                            }
+                            offset = offsetof(ieee_rng_response_frame_t, reception_timestamp);
+                            spiq_write_tx(spiq, frame->array + offset, offset, sizeof(ieee_rng_response_frame_t) - offset);
+                        }else
+#endif
+                        {
+                            spiq_write_tx(spiq, frame->array, 0, sizeof(ieee_rng_response_frame_t));
+                            spiq_write_tx_fctrl(spiq, sizeof(ieee_rng_response_frame_t), 0, true);
+                            nranges->prearmed = 1;
+                        }
+                        nranges->prearmed_dst = frame->dst_address;
                         dw1000_set_wait4resp(inst, true);
+                        spiq_set_delay_start(spiq, response_tx_delay);
+#if MYNEWT_VAL(N_RANGES_HOLDOFF_CAL)
+                        // The turnaround ends once DX_TIME is on the bus, sample the system time right behind it
+                        nranges->holdoff_queued = nranges->holdoff.status.measuring;
+                        if (nranges->holdoff_queued){
+                            nranges->holdoff_rx_timestamp = request_timestamp;
+                            nranges->holdoff_systime = 0;
+                            spiq_read(spiq, SYS_TIME_ID, 0, (uint8_t *) &nranges->holdoff_systime, SYS_TIME_LEN);
+                        }
+#endif
+                        spiq_set_rx_timeout(spiq, config->rx_timeout_period);
+                        spiq_start_tx(spiq);
+                        spiq_submit(spiq, nranges_spiq_complete_cb, nranges);
+                        break;
+#else
+#if MYNEWT_VAL(N_RANGES_PREARM)
+                        if (nranges->prearmed){
+                            // fctrl, PANID, src_address and code are staged, dst_address only changes with the initiator
+                            uint16_t offset = offsetof(ieee_rng_response_frame_t, seq_num);
+                            dw1000_write_tx(inst, frame->array + offset, offset, sizeof(frame->seq_num));
+                            if (frame->dst_address != nranges->prearmed_dst){
+                                offset = offsetof(ieee_rng_response_frame_t, dst_address);
+                                dw1000_write_tx(inst, frame->array + offset, offset, sizeof(frame->dst_address));
+                            }
+                            offset = offsetof(ieee_rng_response_frame_t, reception_timestamp);
+                            dw1000_write_tx(inst, frame->array + offset, offset, sizeof(ieee_rng_response_frame_t) - offset);
+                        }else
+#endif
+                        {
+                            dw1000_write_tx(inst, frame->array, 0, sizeof(ieee_rng_response_frame_t));
+                            dw1000_write_tx_fctrl(inst, sizeof(ieee_rng_response_frame_t), 0, true);
+                            nranges->prearmed = 1;
+                        }
+                        nranges->prearmed_dst = frame->dst_address;
+                        dw1000_set_wait4resp(inst, true);
+#if MYNEWT_VAL(N_RANGES_HOLDOFF_CAL)
+                        holdoff_sample(&nranges->holdoff, request_timestamp);
+#endif
                         dw1000_set_delay_start(inst, response_tx_delay);
                         dw1000_set_rx_timeout(inst, config->rx_timeout_period);
-                        if (dw1000_start_tx(inst).start_tx_error)
+                        if (nranges_start_tx(inst).start_tx_error)
                             os_sem_release(&nranges->sem);
                         break;
+#endif
                     }
                 case DWT_DS_TWR_NRNG_T1:
                     {
@@ -260,8 +451,10 @@ nranges_rx_complete_cb(dw1000_dev_instance_t * inst){
                         else
                             break;
 
-                        frame->request_timestamp = next_frame->request_timestamp = dw1000_read_txtime_lo(inst);    // This corresponds to when the original request was actually sent
-                        frame->response_timestamp = next_frame->response_timestamp = dw1000_read_rxtime_lo(inst);  // This corresponds to the response just received
+                        dw1000_nranges_timestamps_t timestamps;
+                        dw1000_nranges_read_timestamps(inst, &timestamps);
+                        frame->request_timestamp = next_frame->request_timestamp = timestamps.tx_lo;    // This corresponds to when the original request was actually sent
+                        frame->response_timestamp = next_frame->response_timestamp = timestamps.rx_lo;  // This corresponds to the response just received
 
                         uint8_t seq_num = frame->seq_num;
                         frame->dst_address = frame->src_address;
@@ -275,7 +468,7 @@ nranges_rx_complete_cb(dw1000_dev_instance_t * inst){
                         frame->seq_num = seq_num + 1;
                         frame->code = DWT_DS_TWR_NRNG_T2;
 
-                        uint64_t request_timestamp = dw1000_read_rxtime(inst);
+                        uint64_t request_timestamp = timestamps.rx;
                         uint64_t response_tx_delay = request_timestamp + ((uint64_t)config->tx_holdoff_delay << 16);
                         uint64_t response_timestamp = (response_tx_delay & 0xFFFFFFFE00UL) + inst->tx_antenna_delay;
 
@@ -287,19 +480,31 @@ nranges_rx_complete_cb(dw1000_dev_instance_t * inst){
                         if(nranges->resp_count + nranges->timeout_count < nnodes)
                         {
                             dw1000_set_rx_timeout(inst, config->rx_timeout_period);
+#if MYNEWT_VAL(N_RANGES_DBLBUFFER)
+                            nranges_release_rxbuf(inst);
+#else
                             dw1000_start_rx(inst);
+#endif
                         }
                         else if(nranges->resp_count + nranges->timeout_count == nnodes)
                         {
+#if MYNEWT_VAL(N_RANGES_DBLBUFFER)
+                            dw1000_phy_forcetrxoff(inst);
+                            nranges_sync_rxbufptrs(inst);
+#endif
+                            nranges->prearmed = 0;
                             dw1000_write_tx(inst, frame->array, 0, sizeof(twr_frame_final_t));
                             dw1000_write_tx_fctrl(inst, sizeof(twr_frame_final_t), 0, true);
                             dw1000_set_wait4resp(inst, true);
+#if MYNEWT_VAL(N_RANGES_HOLDOFF_CAL)
+                            holdoff_sample(&nranges->holdoff, request_timestamp);
+#endif
                             dw1000_set_delay_start(inst, response_tx_delay);
                             dw1000_set_rx_timeout(inst, config->rx_timeout_period);
                             nranges->resp_count = 0;
                             nranges->timeout_count = 0;
                             nranges->t1_final_flag = 0;
-                            if (dw1000_start_tx(inst).start_tx_error)
+                            if (nranges_start_tx(inst).start_tx_error)
                                 os_sem_release(&nranges->sem);
                         }
                         break;
@@ -321,18 +526,24 @@ nranges_rx_complete_cb(dw1000_dev_instance_t * inst){
                         previous_frame->request_timestamp = frame->request_timestamp;
                         previous_frame->response_timestamp = frame->response_timestamp;
 
-                        uint64_t request_timestamp = dw1000_read_rxtime(inst);
+                        dw1000_nranges_timestamps_t timestamps;
+                        dw1000_nranges_read_timestamps(inst, &timestamps);
+                        uint64_t request_timestamp = timestamps.rx;
                         uint64_t response_tx_delay = request_timestamp + (((uint64_t)config->tx_holdoff_delay << 16) * (uint64_t)inst->slot_id);
 
-                        frame->request_timestamp = dw1000_read_txtime_lo(inst); // This corresponds to when the original request was actually sent
-                        frame->response_timestamp = dw1000_read_rxtime_lo(inst);  // This corresponds to the response just received
+                        frame->request_timestamp = timestamps.tx_lo; // This corresponds to when the original request was actually sent
+                        frame->response_timestamp = timestamps.rx_lo;  // This corresponds to the response just received
                         frame->dst_address = frame->src_address;
                         frame->src_address = inst->my_short_address;
                         frame->code = DWT_DS_TWR_NRNG_FINAL;
+                        nranges->prearmed = 0;
                         dw1000_write_tx(inst, frame->array, 0, sizeof(twr_frame_final_t));
                         dw1000_write_tx_fctrl(inst, sizeof(twr_frame_final_t), 0, true);
+#if MYNEWT_VAL(N_RANGES_HOLDOFF_CAL)
+                        holdoff_sample(&nranges->holdoff, request_timestamp);
+#endif
                         dw1000_set_delay_start(inst, response_tx_delay);
-                        if (dw1000_start_tx(inst).start_tx_error)
+                        if (nranges_start_tx(inst).start_tx_error)
                             os_sem_release(&nranges->sem);
                         break;
                     }
@@ -358,7 +569,11 @@ nranges_rx_complete_cb(dw1000_dev_instance_t * inst){
                         {
                             rng->idx++;
                             dw1000_set_rx_timeout(inst, config->rx_timeout_period);
+#if MYNEWT_VAL(N_RANGES_DBLBUFFER)
+                            nranges_release_rxbuf(inst);
+#else
                             dw1000_start_rx(inst);
+#endif
                         }
                         else if(nranges->resp_count + nranges->timeout_count == nnodes)
                         {
@@ -395,13 +610,17 @@ nranges_rx_complete_cb(dw1000_dev_instance_t * inst){
                         frame->dst_address = frame->src_address;
                         frame->src_address = inst->my_short_address;
                         frame->code = DWT_DS_TWR_NRNG_EXT_T1;
+                        nranges->prearmed = 0;
 
                         dw1000_write_tx(inst, frame->array, 0, sizeof(ieee_rng_response_frame_t));
                         dw1000_write_tx_fctrl(inst, sizeof(ieee_rng_response_frame_t), 0, true);
                         dw1000_set_wait4resp(inst, true);
+#if MYNEWT_VAL(N_RANGES_HOLDOFF_CAL)
+                        holdoff_sample(&nranges->holdoff, request_timestamp);
+#endif
                         dw1000_set_delay_start(inst, response_tx_delay);
                         dw1000_set_rx_timeout(inst, config->rx_timeout_period);
-                        if (dw1000_start_tx(inst).start_tx_error)
+                        if (nranges_start_tx(inst).start_tx_error)
                             os_sem_release(&nranges->sem);
                         break;
                     }
@@ -420,8 +639,10 @@ nranges_rx_complete_cb(dw1000_dev_instance_t * inst){
                         else
                             break;
 
-                        frame->request_timestamp = next_frame->request_timestamp = dw1000_read_txtime_lo(inst);    // This corresponds to when the original request was actually sent
-                        frame->response_timestamp = next_frame->response_timestamp = dw1000_read_rxtime_lo(inst);  // This corresponds to the response just received
+                        dw1000_nranges_timestamps_t timestamps;
+                        dw1000_nranges_read_timestamps(inst, &timestamps);
+                        frame->request_timestamp = next_frame->request_timestamp = timestamps.tx_lo;    // This corresponds to when the original request was actually sent
+                        frame->response_timestamp = next_frame->response_timestamp = timestamps.rx_lo;  // This corresponds to the response just received
 
                         uint8_t seq_num = frame->seq_num;
                         frame->dst_address = frame->src_address;
@@ -435,7 +656,7 @@ nranges_rx_complete_cb(dw1000_dev_instance_t * inst){
                         frame->seq_num = seq_num + 1;
                         frame->code = DWT_DS_TWR_NRNG_EXT_T2;
 
-                        uint64_t request_timestamp = dw1000_read_rxtime(inst);
+                        uint64_t request_timestamp = timestamps.rx;
                         uint64_t response_tx_delay = request_timestamp + ((uint64_t)config->tx_holdoff_delay << 16);
                         uint64_t response_timestamp = (response_tx_delay & 0xFFFFFFFE00UL) + inst->tx_antenna_delay;
 
@@ -447,20 +668,32 @@ nranges_rx_complete_cb(dw1000_dev_instance_t * inst){
                         if(nranges->resp_count + nranges->timeout_count < nnodes)
                         {
                             dw1000_set_rx_timeout(inst, config->rx_timeout_period);
+#if MYNEWT_VAL(N_RANGES_DBLBUFFER)
+                            nranges_release_rxbuf(inst);
+#else
                             dw1000_start_rx(inst);
+#endif
                         }
                         else if(nranges->resp_count + nranges->timeout_count == nnodes)
                         {
+#if MYNEWT_VAL(N_RANGES_DBLBUFFER)
+                            dw1000_phy_forcetrxoff(inst);
+                            nranges_sync_rxbufptrs(inst);
+#endif
+                            nranges->prearmed = 0;
                             dw1000_write_tx(inst, frame->array, 0, sizeof(twr_frame_final_t));
                             dw1000_write_tx_fctrl(inst, sizeof(twr_frame_final_t), 0, true);
                             dw1000_set_wait4resp(inst, true);
+#if MYNEWT_VAL(N_RANGES_HOLDOFF_CAL)
+                            holdoff_sample(&nranges->holdoff, request_timestamp);
+#endif
                             dw1000_set_delay_start(inst, response_tx_delay);
                             dw1000_set_rx_timeout(inst, config->rx_timeout_period);
                             nranges->resp_count = 0;
                             nranges->timeout_count = 0;
                             nranges->t1_final_flag = 0;
 
-                            if (dw1000_start_tx(inst).start_tx_error)
+                            if (nranges_start_tx(inst).start_tx_error)
                                 os_sem_release(&nranges->sem);
                         }
                         break;
@@ -483,20 +716,26 @@ nranges_rx_complete_cb(dw1000_dev_instance_t * inst){
                         previous_frame->request_timestamp = frame->request_timestamp;
                         previous_frame->response_timestamp = frame->response_timestamp;
 
-                        uint64_t request_timestamp = dw1000_read_rxtime(inst);
+                        dw1000_nranges_timestamps_t timestamps;
+                        dw1000_nranges_read_timestamps(inst, &timestamps);
+                        uint64_t request_timestamp = timestamps.rx;
                         uint64_t response_tx_delay = request_timestamp + (((uint64_t)config->tx_holdoff_delay << 16) * (uint64_t)inst->slot_id);
 
-                        frame->request_timestamp = dw1000_read_txtime_lo(inst); // This corresponds to when the original request was actually sent
-                        frame->response_timestamp = dw1000_read_rxtime_lo(inst);  // This corresponds to the response just received
+                        frame->request_timestamp = timestamps.tx_lo; // This corresponds to when the original request was actually sent
+                        frame->response_timestamp = timestamps.rx_lo;  // This corresponds to the response just received
                         frame->dst_address = frame->src_address;
                         frame->src_address = inst->my_short_address;
                         frame->code = DWT_DS_TWR_NRNG_EXT_FINAL;
+                        nranges->prearmed = 0;
                         if (inst->rng_tx_final_cb != NULL)
                            inst->rng_tx_final_cb(inst);
                         dw1000_write_tx(inst, frame->array, 0, sizeof(twr_frame_t));
                         dw1000_write_tx_fctrl(inst, sizeof(twr_frame_t), 0, true);
+#if MYNEWT_VAL(N_RANGES_HOLDOFF_CAL)
+                        holdoff_sample(&nranges->holdoff, request_timestamp);
+#endif
                         dw1000_set_delay_start(inst, response_tx_delay);
-                        if (dw1000_start_tx(inst).start_tx_error)
+                        if (nranges_start_tx(inst).start_tx_error)
                             os_sem_release(&nranges->sem);
                         break;
                     }
@@ -523,7 +762,11 @@ nranges_rx_complete_cb(dw1000_dev_instance_t * inst){
                         {
                             rng->idx++;
                             dw1000_set_rx_timeout(inst, config->rx_timeout_period);
+#if MYNEWT_VAL(N_RANGES_DBLBUFFER)
+                            nranges_release_rxbuf(inst);
+#else
                             dw1000_start_rx(inst);
+#endif
                         }
                         else if(nranges->resp_count + nranges->timeout_count == nnodes)
                         {
@@ -543,9 +786,8 @@ nranges_rx_complete_cb(dw1000_dev_instance_t * inst){
 
 void dw1000_nranges_set_ext_callbacks(dw1000_dev_instance_t * inst, dw1000_extension_callbacks_t nranges_cbs){
     assert(inst);
-    //nranges_cbs.id = (dw1000_extension_id_t)DW1000_N_RANGES;
-    nranges_cbs.id = DW1000_N_RANGES;
-    dw1000_add_extension_callbacks(inst, nranges_cbs);
+    int rc = dispatch_register(inst, FCNTL_IEEE_N_RANGES_16, DWT_DS_TWR_NRNG, DWT_DS_TWR_NRNG_EXT_END, &nranges_cbs);
+    SYSINIT_PANIC_ASSERT(rc == 0);
 }
 
 void send_final_msg(dw1000_dev_instance_t * inst , twr_frame_t * frame)
@@ -558,6 +800,7 @@ void send_final_msg(dw1000_dev_instance_t * inst , twr_frame_t * frame)
     frame->src_address = inst->my_short_address;
     frame->seq_num = (frame-1)->seq_num;
     frame->code = (frame-1)->code;
+    nranges->prearmed = 0;
     dw1000_write_tx(inst, frame->array, 0, sizeof(twr_frame_final_t));
     dw1000_write_tx_fctrl(inst, sizeof(twr_frame_final_t), 0, true);
     dw1000_set_wait4resp(inst, true);
@@ -570,29 +813,4 @@ void send_final_msg(dw1000_dev_instance_t * inst , twr_frame_t * frame)
         os_sem_release(&nranges->sem);
 }
 
-float
-dw1000_nranges_twr_to_tof_frames(twr_frame_t *first_frame, twr_frame_t *final_frame){
-    float ToF = 0;
-    uint64_t T1R, T1r, T2R, T2r;
-    int64_t nom,denom;
-
-    assert(first_frame != NULL);
-    assert(final_frame != NULL);
-
-    switch(final_frame->code){
-        case DWT_DS_TWR_NRNG ... DWT_DS_TWR_NRNG_END:
-        case DWT_DS_TWR_NRNG_EXT ... DWT_DS_TWR_NRNG_EXT_END:
-            T1R = (first_frame->response_timestamp - first_frame->request_timestamp);
-            T1r = (first_frame->transmission_timestamp  - first_frame->reception_timestamp);
-            T2R = (final_frame->response_timestamp - final_frame->request_timestamp);
-            T2r = (final_frame->transmission_timestamp - final_frame->reception_timestamp);
-            nom = T1R * T2R  - T1r * T2r;
-            denom = T1R + T2R  + T1r + T2r;
-            ToF = (float) (nom) / denom;
-            break;
-        default: break;
-    }
-    return ToF;
-}
-
 #endif //MYNEWT_VAL(N_RANGES_NPLUS_TWO_MSGS)
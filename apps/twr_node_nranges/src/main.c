@@ -20,6 +20,7 @@
  */
 
 #include <assert.h>
+#include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
 #include "sysinit/sysinit.h"
@@ -37,6 +38,7 @@
 #include "dw1000/dw1000_mac.h"
 #include "dw1000/dw1000_rng.h"
 #include "dw1000/dw1000_ftypes.h"
+#include <rssi/dw1000_rssi.h>
 
 #if MYNEWT_VAL(DW1000_LWIP)
 #include <dw1000/dw1000_lwip.h>
@@ -65,7 +67,14 @@ static dw1000_pan_config_t pan_config = {
 };
 #endif
 
-static twr_frame_t twr[] = {
+#if MYNEWT_VAL(SURVEY_ENABLED)
+// Initiating a round needs a frame pair per responder
+#define N_FRAMES MYNEWT_VAL(SURVEY_NNODES)*2
+#else
+#define N_FRAMES 2
+#endif
+
+static twr_frame_t twr[N_FRAMES] = {
     [0] = {
         .fctrl = FCNTL_IEEE_N_RANGES_16,                // frame control (0x8841 to indicate a data frame using 16-bit addressing).
         .PANID = 0xDECA,                // PAN ID (0xDECA)
@@ -78,6 +87,94 @@ static twr_frame_t twr[] = {
     }
 };
 
+#if MYNEWT_VAL(SURVEY_ENABLED)
+/*
+ * Survey mode: every node in turn initiates nranges to all others and keeps
+ * the mean range to each, the responder role is unchanged in between. There
+ * is no shared time base here, turns are taken at randomised intervals. The
+ * initiator expects the SURVEY_NNODES - 1 other nodes and waits at most
+ * SURVEY_RX_TIMEOUT for each, long enough to skip its own empty slot, so a
+ * round lost to a collision only costs its samples. Once SURVEY_ROUNDS rounds
+ * are done each node prints its row of the pairwise range matrix:
+ *
+ * {"utime": 12345678,"survey": {"src": 4660,"dst": 17185,"range": 5012,"n": 97}}
+ *
+ * apps/matlab/survey.m solves the anchor geometry from the rows of all nodes.
+ */
+typedef struct _survey_peer_t{
+    uint16_t address;
+    uint16_t n;
+    int64_t sum;                    // mm
+}survey_peer_t;
+
+static struct os_callout survey_callout;
+static survey_peer_t survey_peers[MYNEWT_VAL(SURVEY_NNODES)];
+static uint16_t survey_round;
+
+static void
+survey_add(uint16_t address, int32_t range_mm){
+    for (uint16_t i = 0; i < MYNEWT_VAL(SURVEY_NNODES); i++){
+        survey_peer_t * peer = &survey_peers[i];
+        if (peer->n == 0 || peer->address == address){
+            peer->address = address;
+            peer->n++;
+            peer->sum += range_mm;
+            return;
+        }
+    }
+}
+
+static void
+survey_print(dw1000_dev_instance_t * inst){
+    for (uint16_t i = 0; i < MYNEWT_VAL(SURVEY_NNODES) && survey_peers[i].n; i++)
+        printf("{\"utime\": %lu,\"survey\": {\"src\": %u,\"dst\": %u,\"range\": %ld,\"n\": %u}}\n",
+                os_cputime_ticks_to_usecs(os_cputime_get32()), inst->my_short_address, survey_peers[i].address,
+                (int32_t)(survey_peers[i].sum / survey_peers[i].n), survey_peers[i].n);
+}
+
+static void
+survey_ev_cb(struct os_event * ev){
+    dw1000_dev_instance_t * inst = (dw1000_dev_instance_t *)ev->ev_arg;
+    dw1000_rng_instance_t * rng = inst->rng;
+    dw1000_nranges_instance_t * nranges = &nranges_instance;
+    uint16_t nnodes = nranges->nnodes;
+
+    dw1000_phy_forcetrxoff(inst);
+    nranges->initiator = 1;
+    nranges->t1_final_flag = 1;
+    rng->idx = 0xffff;
+    rng_config.rx_timeout_period = MYNEWT_VAL(SURVEY_RX_TIMEOUT);
+    dw1000_nranges_request(inst, 0xffff, DWT_DS_TWR_NRNG);
+    rng_config.rx_timeout_period = 0;
+
+    twr_frame_t * frame = rng->frames[(rng->idx)%rng->nframes];
+    if (frame->code == DWT_DS_TWR_NRNG_FINAL || frame->code == DWT_DS_TWR_NRNG_EXT_FINAL) {
+        twr_frame_t * first_frame = rng->frames[0];
+        for (uint16_t i = 0; i < nranges->resp_count; i++){
+            float range = dw1000_rng_tof_to_meters(dw1000_nranges_twr_to_tof_frames(first_frame+i, first_frame+i+nnodes));
+            survey_add((first_frame+i)->src_address, (int32_t)(range * 1000));
+            (first_frame+i+nnodes)->code = DWT_DS_TWR_NRNG_END;
+            (first_frame+i)->code = DWT_DS_TWR_NRNG_END;
+        }
+    }
+    rng->idx = 0xffff;
+    nranges->resp_count = 0;
+    nranges->timeout_count = 0;
+    nranges->initiator = 0;
+#if MYNEWT_VAL(N_RANGES_PREARM)
+    // The request overwrote the staged response
+    dw1000_nranges_prearm(inst);
+#endif
+    dw1000_set_rx_timeout(inst, 0);
+    dw1000_start_rx(inst);
+
+    if (++survey_round < MYNEWT_VAL(SURVEY_ROUNDS))
+        os_callout_reset(&survey_callout, (OS_TICKS_PER_SEC * (MYNEWT_VAL(SURVEY_PERIOD_MS) / 2 + rand() % MYNEWT_VAL(SURVEY_PERIOD_MS))) / 1000);
+    else
+        survey_print(inst);
+}
+#endif
+
 void print_frame(const char * name, twr_frame_t *twr ){
     printf("%s{\n\tfctrl:0x%04X,\n", name, twr->fctrl);
     printf("\tseq_num:0x%02X,\n", twr->seq_num);
@@ -92,6 +189,11 @@ void print_frame(const char * name, twr_frame_t *twr ){
 }
 
 static void complete_cb(struct _dw1000_dev_instance_t *inst) {
+#if MYNEWT_VAL(SURVEY_ENABLED)
+    // Survey rounds are read out and rx restarted by survey_ev_cb
+    if (nranges_instance.initiator)
+        return;
+#endif
     hal_gpio_toggle(LED_BLINK_PIN);
     dw1000_rng_instance_t * rng = inst->rng;
 
@@ -119,7 +221,7 @@ static void complete_cb(struct _dw1000_dev_instance_t *inst) {
         previous_frame = previous_frame;
         uint32_t time_of_flight = (uint32_t) dw1000_rng_twr_to_tof(rng);
         float range = dw1000_rng_tof_to_meters(dw1000_rng_twr_to_tof(rng));
-        float rssi = dw1000_get_rssi(inst);
+        int16_t rssi = dw1000_rssi_q8(inst);
         //print_frame("1st=", previous_frame);
         //print_frame("2nd=", frame);
         frame->code = DWT_DS_TWR_END;
@@ -130,7 +232,7 @@ static void complete_cb(struct _dw1000_dev_instance_t *inst) {
             (uint32_t)(range * 1000),
             (frame->response_timestamp - frame->request_timestamp),
             (frame->transmission_timestamp - frame->reception_timestamp),
-            (int)(rssi)
+            rssi / 256
         );
         dw1000_set_rx_timeout(inst, 0);
         dw1000_start_rx(inst);
@@ -173,6 +275,10 @@ int main(int argc, char **argv){
     dw1000_nranges_instance_t * nranges = &nranges_instance;
     memset(nranges,0,sizeof(dw1000_nranges_instance_t));
     nranges->initiator = 0;
+#if MYNEWT_VAL(SURVEY_ENABLED)
+    // Responders, the initiator's own slot stays empty
+    nranges->nnodes = MYNEWT_VAL(SURVEY_NNODES) - 1;
+#endif
     dw1000_nranges_init(inst, nranges);
 #endif
     printf("device_id=%lX\n",inst->device_id);
@@ -186,6 +292,16 @@ int main(int argc, char **argv){
 
     dw1000_set_rx_timeout(inst, 0);
     dw1000_start_rx(inst);
+#if MYNEWT_VAL(SURVEY_ENABLED)
+    for (uint16_t i = 2; i < N_FRAMES; i++){
+        twr[i].fctrl = twr[0].fctrl;
+        twr[i].PANID = twr[0].PANID;
+        twr[i].code = twr[0].code;
+    }
+    srand(inst->my_short_address);
+    os_callout_init(&survey_callout, os_eventq_dflt_get(), survey_ev_cb, inst);
+    os_callout_reset(&survey_callout, OS_TICKS_PER_SEC + (OS_TICKS_PER_SEC * (rand() % MYNEWT_VAL(SURVEY_PERIOD_MS))) / 1000);
+#endif
 
     while (1) {
         os_eventq_run(os_eventq_dflt_get());
@@ -37,6 +37,7 @@
 #include "dw1000/dw1000_mac.h"
 #include "dw1000/dw1000_rng.h"
 #include "dw1000/dw1000_ftypes.h"
+#include <rssi/dw1000_rssi.h>
 
 #if MYNEWT_VAL(DW1000_LWIP)
 #include <dw1000/dw1000_lwip.h>
@@ -119,7 +120,7 @@ static void complete_cb(struct _dw1000_dev_instance_t *inst) {
         previous_frame = previous_frame;
         uint32_t time_of_flight = (uint32_t) dw1000_rng_twr_to_tof(rng);
         float range = dw1000_rng_tof_to_meters(dw1000_rng_twr_to_tof(rng));
-        float rssi = dw1000_get_rssi(inst);
+        int16_t rssi = dw1000_rssi_q8(inst);
         //print_frame("1st=", previous_frame);
         //print_frame("2nd=", frame);
         frame->code = DWT_DS_TWR_END;
@@ -130,7 +131,7 @@ static void complete_cb(struct _dw1000_dev_instance_t *inst) {
             (uint32_t)(range * 1000),
             (frame->response_timestamp - frame->request_timestamp),
             (frame->transmission_timestamp - frame->reception_timestamp),
-            (int)(rssi)
+            rssi / 256
         );
         dw1000_set_rx_timeout(inst, 0);
         dw1000_start_rx(inst);
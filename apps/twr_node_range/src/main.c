@@ -38,6 +38,10 @@
 #include <dw1000/dw1000_mac.h>
 #include <dw1000/dw1000_rng.h>
 #include <dw1000/dw1000_ftypes.h>
+#include <rssi/dw1000_rssi.h>
+#if MYNEWT_VAL(RNGBIAS_ENABLED)
+#include <rngbias/dw1000_rngbias.h>
+#endif
 #include <json_encode.h>
 
 #if MYNEWT_VAL(DW1000_CCP_ENABLED)
@@ -49,9 +53,32 @@
 #if MYNEWT_VAL(DW1000_PAN)
 #include <dw1000/dw1000_pan.h>
 #endif
+#if MYNEWT_VAL(PANCACHE_ENABLED)
+#include <pancache/dw1000_pancache.h>
+static pancache_instance_t g_pancache;
+#endif
+#if MYNEWT_VAL(PANJOIN_ENABLED)
+#include <panjoin/dw1000_panjoin.h>
+static panjoin_instance_t g_panjoin;
+#if MYNEWT_VAL(PANCACHE_ENABLED)
+static void
+pancache_start_cb(pancache_instance_t * cache){
+    panjoin_start(&g_panjoin);
+}
+#endif
+#endif
 #if MYNEWT_VAL(DW1000_RANGE)
 #include <dw1000/dw1000_range.h>
 #endif
+#if MYNEWT_VAL(RNGFILTER_ENABLED)
+#include <rngfilter/dw1000_rngfilter.h>
+#endif
+#if MYNEWT_VAL(LINKSTATS_ENABLED)
+#include <linkstats/dw1000_linkstats.h>
+#endif
+#if MYNEWT_VAL(CAPTURE_ENABLED)
+#include <capture/dw1000_capture.h>
+#endif
 
 
 static twr_frame_t twr[] = {
@@ -119,6 +146,10 @@ static twr_frame_t twr_rev[] = {
     }                                                                                                                   
 };
 
+#if MYNEWT_VAL(RNGBIAS_ENABLED)
+static rngbias_instance_t g_rngbias;
+#endif
+
 static dw1000_rng_config_t rng_config = {
     .tx_holdoff_delay = 0x0800,         // Send Time delay in usec.
     .rx_timeout_period = 0xA000         // Receive response timeout in usec
@@ -139,6 +170,42 @@ static uint32_t cntr = 0;
 #endif
 
 
+#if MYNEWT_VAL(RNGFILTER_ENABLED)
+static rngfilter_instance_t g_rngfilter;
+#endif
+
+#if MYNEWT_VAL(LINKSTATS_ENABLED)
+static linkstats_instance_t g_linkstats;
+#endif
+
+#if MYNEWT_VAL(CAPTURE_ENABLED)
+static capture_instance_t g_capture;
+static capture_index_entry_t g_capture_index[MYNEWT_VAL(CAPTURE_INDEX_SIZE)];
+
+static void
+capture_frame(dw1000_dev_instance_t * inst, twr_frame_t * frame, int16_t rssi, cir_t * cir){
+    capture_record_t record = {
+        .utime = os_cputime_ticks_to_usecs(os_cputime_get32()),
+        .src_address = frame->src_address,
+        .dst_address = frame->dst_address,
+        .code = frame->code,
+        .request_timestamp = frame->request_timestamp,
+        .response_timestamp = frame->response_timestamp,
+        .reception_timestamp = frame->reception_timestamp,
+        .transmission_timestamp = frame->transmission_timestamp,
+        .rssi = rssi,
+        .fp_idx = inst->rxdiag.fp_idx,
+        .cir = (cir == NULL) ? NULL : (const int16_t *) cir->array
+    };
+    capture_append(&g_capture, &record);
+#if MYNEWT_VAL(CAPTURE_SESSION_NRECORDS)
+    // Close the session to get the index and trailer out, the next file follows on the console
+    if (g_capture.nrecords >= MYNEWT_VAL(CAPTURE_SESSION_NRECORDS))
+        capture_rotate(&g_capture);
+#endif
+}
+#endif
+
 void print_frame(const char * name, twr_frame_t *twr ){
     printf("%s{\n\tfctrl:0x%04X,\n", name, twr->fctrl);
     printf("\tseq_num:0x%02X,\n", twr->seq_num);
@@ -175,6 +242,9 @@ static void range_postprocess(struct os_event * ev){
                     time_of_flight,
                     *(uint32_t *)&range
                 );
+#if MYNEWT_VAL(CAPTURE_ENABLED)
+            capture_frame(inst, frame, dw1000_rssi_q8(inst), NULL);
+#endif
             frame->code = DWT_SS_TWR_END;
         }
         if(range->pp_idx_list[i] == 0)
@@ -186,11 +256,18 @@ static void range_postprocess(struct os_event * ev){
                 json_rng_encode(previous_frame, 2);
                 uint32_t time_of_flight = (uint32_t) dw1000_rng_twr_to_tof(previous_frame, frame);
                 dist = dw1000_rng_tof_to_meters(dw1000_rng_twr_to_tof(previous_frame, frame));
+#if MYNEWT_VAL(RNGBIAS_ENABLED)
+                dist = rngbias_correct(&g_rngbias, dist, dw1000_rssi_q8(inst));
+#endif
                 cir_t cir;
                 cir.fp_idx = dw1000_read_reg(inst, RX_TIME_ID, RX_TIME_FP_INDEX_OFFSET, sizeof(uint16_t));
                 cir.fp_idx = roundf(((float) (cir.fp_idx >> 6) + 0.5f)) - 2;
                 dw1000_read_accdata(inst, (uint8_t *)&cir,  cir.fp_idx * sizeof(cir_complex_t), CIR_SIZE * sizeof(cir_complex_t) + 1);
                 json_cir_encode(&cir, "cir", CIR_SIZE);
+#if MYNEWT_VAL(CAPTURE_ENABLED)
+                capture_frame(inst, previous_frame, dw1000_rssi_q8(inst), NULL);
+                capture_frame(inst, frame, dw1000_rssi_q8(inst), &cir);
+#endif
 
                 if(inst->config.rxdiag_enable)
                 json_rxdiag_encode(&inst->rxdiag, "rxdiag");
@@ -222,7 +299,20 @@ static void range_postprocess(struct os_event * ev){
         if (frame->code == DWT_SS_TWR_FINAL) {
             time_of_flight = (uint32_t) dw1000_rng_twr_to_tof(frame, frame);
             dist = dw1000_rng_tof_to_meters(dw1000_rng_twr_to_tof(frame, frame));
-            float rssi = dw1000_get_rssi(inst);
+            int16_t rssi = dw1000_rssi_q8(inst);
+#if MYNEWT_VAL(RNGBIAS_ENABLED)
+            dist = rngbias_correct(&g_rngbias, dist, rssi);
+#endif
+#if MYNEWT_VAL(LINKSTATS_ENABLED)
+            linkstats_update(&g_linkstats, frame->src_address, frame->dst_address, (int32_t)(dist * 1000));
+#endif
+#if MYNEWT_VAL(RNGFILTER_ENABLED)
+            rngfilter_output_t filtered;
+            rngfilter_update(&g_rngfilter, frame->src_address, frame->dst_address,
+                    os_cputime_ticks_to_usecs(os_cputime_get32()), (int32_t)(dist * 1000), &filtered);
+            dist = filtered.range_mm / 1000.0f;
+#endif
+#if !MYNEWT_VAL(LINKSTATS_ENABLED) || MYNEWT_VAL(LINKSTATS_RAW)
             printf("\tseq_num:0x%02X,\n", frame->seq_num);
             printf("\tPANID:0x%04X,\n", frame->PANID);
             printf("\tdst_address:0x%04X,\n", frame->dst_address);
@@ -234,8 +324,18 @@ static void range_postprocess(struct os_event * ev){
                     (uint32_t)(dist * 1000),
                     (frame->response_timestamp - frame->request_timestamp),
                     (frame->transmission_timestamp - frame->reception_timestamp),
-                    (int)(rssi)
+                    rssi / 256
                   );
+#endif
+#if MYNEWT_VAL(RNGFILTER_ENABLED)
+            // Reported with or without the raw output, linkstats only summarises the unfiltered ranges
+            printf("{\"utime\": %lu,\"src_address\": %u,\"dst_address\": %u,\"range\": %ld,\"rate\": %ld}\n",
+                    os_cputime_ticks_to_usecs(os_cputime_get32()),
+                    frame->src_address, frame->dst_address, filtered.range_mm, filtered.rate_mms);
+#endif
+#if MYNEWT_VAL(CAPTURE_ENABLED)
+            capture_frame(inst, frame, rssi, NULL);
+#endif
             frame->code = DWT_SS_TWR_END;
         }
 
@@ -247,7 +347,20 @@ static void range_postprocess(struct os_event * ev){
         if ((frame->code == DWT_DS_TWR_FINAL && previous_frame->code == DWT_DS_TWR_T1) || frame->code == DWT_DS_TWR_EXT_FINAL) {
             time_of_flight = (uint32_t) dw1000_rng_twr_to_tof(previous_frame, frame);
             dist = dw1000_rng_tof_to_meters(dw1000_rng_twr_to_tof(previous_frame, frame));
-            float rssi = dw1000_get_rssi(inst);
+            int16_t rssi = dw1000_rssi_q8(inst);
+#if MYNEWT_VAL(RNGBIAS_ENABLED)
+            dist = rngbias_correct(&g_rngbias, dist, rssi);
+#endif
+#if MYNEWT_VAL(LINKSTATS_ENABLED)
+            linkstats_update(&g_linkstats, frame->src_address, frame->dst_address, (int32_t)(dist * 1000));
+#endif
+#if MYNEWT_VAL(RNGFILTER_ENABLED)
+            rngfilter_output_t filtered;
+            rngfilter_update(&g_rngfilter, frame->src_address, frame->dst_address,
+                    os_cputime_ticks_to_usecs(os_cputime_get32()), (int32_t)(dist * 1000), &filtered);
+            dist = filtered.range_mm / 1000.0f;
+#endif
+#if !MYNEWT_VAL(LINKSTATS_ENABLED) || MYNEWT_VAL(LINKSTATS_RAW)
             printf("\tseq_num:0x%02X,\n", frame->seq_num);
             printf("\tPANID:0x%04X,\n", frame->PANID);
             printf("\tdst_address:0x%04X,\n", frame->dst_address);
@@ -260,12 +373,26 @@ static void range_postprocess(struct os_event * ev){
                     (uint32_t)(dist * 1000),
                     (frame->response_timestamp - frame->request_timestamp),
                     (frame->transmission_timestamp - frame->reception_timestamp),
-                    (int)(rssi)
+                    rssi / 256
                   );
+#endif
+#if MYNEWT_VAL(RNGFILTER_ENABLED)
+            // Reported with or without the raw output, linkstats only summarises the unfiltered ranges
+            printf("{\"utime\": %lu,\"src_address\": %u,\"dst_address\": %u,\"range\": %ld,\"rate\": %ld}\n",
+                    os_cputime_ticks_to_usecs(os_cputime_get32()),
+                    frame->src_address, frame->dst_address, filtered.range_mm, filtered.rate_mms);
+#endif
+#if MYNEWT_VAL(CAPTURE_ENABLED)
+            capture_frame(inst, previous_frame, rssi, NULL);
+            capture_frame(inst, frame, rssi, NULL);
+#endif
             frame->code = DWT_DS_TWR_END;
             previous_frame->code = DWT_DS_TWR_END;
         }
     }
+#if MYNEWT_VAL(LINKSTATS_ENABLED)
+    linkstats_round(&g_linkstats);
+#endif
     //Dynamically increase the number of nodes, frames        
     if(cntr++ == 100){
         dw1000_range_stop(inst);
@@ -297,18 +424,52 @@ int main(int argc, char **argv){
 
     dw1000_mac_init(inst, NULL);
     dw1000_rng_init(inst, &rng_config, sizeof(twr)/sizeof(twr_frame_t));
+#if MYNEWT_VAL(RNGBIAS_ENABLED)
+    rngbias_init(&g_rngbias, inst->config.channel, inst->config.prf == DWT_PRF_64M);
+#endif
+#if MYNEWT_VAL(RNGFILTER_ENABLED)
+    rngfilter_init(&g_rngfilter);
+#endif
+#if MYNEWT_VAL(LINKSTATS_ENABLED)
+    linkstats_init(&g_linkstats);
+#endif
     dw1000_rng_set_frames(inst, twr, sizeof(twr)/sizeof(twr_frame_t));
 #if MYNEWT_VAL(DW1000_CCP_ENABLED)
     dw1000_ccp_init(inst, 2, MYNEWT_VAL(UUID_CCP_MASTER));
 #endif
 #if MYNEWT_VAL(DW1000_PAN)
     dw1000_pan_init(inst, &pan_config);
+#if MYNEWT_VAL(PANCACHE_ENABLED)
+    pancache_init(&g_pancache, inst);
+#if MYNEWT_VAL(PANJOIN_ENABLED)
+    panjoin_init(&g_panjoin, inst);
+    pancache_set_start(&g_pancache, pancache_start_cb);
+#endif
+    pancache_join(&g_pancache);
+#else
+#if MYNEWT_VAL(PANJOIN_ENABLED)
+    panjoin_init(&g_panjoin, inst);
+    panjoin_start(&g_panjoin);
+#else
     dw1000_pan_start(inst, DWT_NONBLOCKING);
+#endif
     while(inst->pan->status.valid != true){
         os_eventq_run(os_eventq_dflt_get());
         os_cputime_delay_usecs(5000);
     }
 #endif
+#endif
+#if MYNEWT_VAL(CAPTURE_ENABLED)
+    capture_config_t capture_config = {
+        .columns = CAPTURE_COL_TWR | CAPTURE_COL(CAPTURE_COL_RSSI) | CAPTURE_COL(CAPTURE_COL_FP_IDX),
+        .block_nrecords = MYNEWT_VAL(CAPTURE_BLOCK_NRECORDS)
+    };
+#if MYNEWT_VAL(DW1000_RANGE_NODE_JSON) && MYNEWT_VAL(CAPTURE_CIR_SIZE) > 0
+    capture_config.columns |= CAPTURE_COL(CAPTURE_COL_CIR);
+    capture_config.ncir = (MYNEWT_VAL(CAPTURE_CIR_SIZE) < CIR_SIZE) ? MYNEWT_VAL(CAPTURE_CIR_SIZE) : CIR_SIZE;
+#endif
+    capture_init(&g_capture, &capture_config, g_capture_index, MYNEWT_VAL(CAPTURE_INDEX_SIZE), capture_console_sink, NULL);
+#endif
 #if MYNEWT_VAL(DW1000_RANGE)
     dw1000_range_init(inst, 2, node_addr);
     dw1000_range_set_postprocess(inst, &range_postprocess);
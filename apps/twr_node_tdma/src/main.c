@@ -39,6 +39,11 @@
 #include <dw1000/dw1000_mac.h>
 #include <dw1000/dw1000_rng.h>
 #include <dw1000/dw1000_ftypes.h>
+#include <rssi/dw1000_rssi.h>
+#if MYNEWT_VAL(RNGBIAS_ENABLED)
+#include <rngbias/dw1000_rngbias.h>
+#endif
+#include <dispatch/dw1000_dispatch.h>
 #include <tdma/dw1000_tdma.h>
 #include <ccp/dw1000_ccp.h>
 
@@ -48,11 +53,28 @@
 #if MYNEWT_VAL(DW1000_PAN)
 #include <dw1000/dw1000_pan.h>
 #endif
+#if MYNEWT_VAL(PANCACHE_ENABLED)
+#include <pancache/dw1000_pancache.h>
+static pancache_instance_t g_pancache;
+#endif
+#if MYNEWT_VAL(PANJOIN_ENABLED)
+#include <panjoin/dw1000_panjoin.h>
+static panjoin_instance_t g_panjoin;
+#if MYNEWT_VAL(PANCACHE_ENABLED)
+static void
+pancache_start_cb(pancache_instance_t * cache){
+    panjoin_start(&g_panjoin);
+}
+#endif
+#endif
 #if MYNEWT_VAL(TIMESCALE)
 #include <timescale/timescale.h> 
 #endif
 #include <clkcal/clkcal.h>  
 #include "json_encode.h"
+#if MYNEWT_VAL(CAPTURE_ENABLED)
+#include <capture/dw1000_capture.h>
+#endif
 
 #define DIAGMSG(s,u) printf(s,u)
 #ifndef DIAGMSG
@@ -65,6 +87,10 @@
 
 static uint16_t g_slot[MYNEWT_VAL(TDMA_NSLOTS)] = {0};
 
+#if MYNEWT_VAL(RNGBIAS_ENABLED)
+static rngbias_instance_t g_rngbias;
+#endif
+
 static dw1000_rng_config_t rng_config = {
     .tx_holdoff_delay = 0x0300,    // Send Time delay in usec.
     .rx_timeout_period = 0x1       // Receive response timeout in usec
@@ -103,6 +129,33 @@ static twr_frame_t twr[] = {
 
 cir_t g_cir;
 
+#if MYNEWT_VAL(CAPTURE_ENABLED)
+static capture_instance_t g_capture;
+static capture_index_entry_t g_capture_index[MYNEWT_VAL(CAPTURE_INDEX_SIZE)];
+
+static void
+capture_frame(dw1000_dev_instance_t * inst, twr_frame_t * frame, uint32_t utime, int16_t rssi){
+    capture_record_t record = {
+        .utime = utime,
+        .src_address = frame->src_address,
+        .dst_address = frame->dst_address,
+        .code = frame->code,
+        .request_timestamp = frame->request_timestamp,
+        .response_timestamp = frame->response_timestamp,
+        .reception_timestamp = frame->reception_timestamp,
+        .transmission_timestamp = frame->transmission_timestamp,
+        .rssi = rssi,
+        .fp_idx = inst->rxdiag.fp_idx
+    };
+    capture_append(&g_capture, &record);
+#if MYNEWT_VAL(CAPTURE_SESSION_NRECORDS)
+    // Close the session to get the index and trailer out, the next file follows on the console
+    if (g_capture.nrecords >= MYNEWT_VAL(CAPTURE_SESSION_NRECORDS))
+        capture_rotate(&g_capture);
+#endif
+}
+#endif
+
 
 static void slot_ev_cb(struct os_event *ev)
 {
@@ -117,18 +170,29 @@ static void slot_ev_cb(struct os_event *ev)
     if (frame->code == DWT_DS_TWR_FINAL || frame->code == DWT_DS_TWR_EXT_FINAL) {
         float time_of_flight = dw1000_rng_twr_to_tof(rng);
         uint32_t utime =os_cputime_ticks_to_usecs(os_cputime_get32()); 
-        float rssi = dw1000_get_rssi(inst);
+        int16_t rssi = dw1000_rssi_q8(inst);
+        float rssi_dbm = rssi / 256.0f;
+#if MYNEWT_VAL(RNGBIAS_ENABLED)
+        float range = rngbias_correct(&g_rngbias, frame->spherical.range, rssi);
+#else
+        float range = frame->spherical.range;
+#endif
 
         printf("{\"utime\": %lu,\"tof\": %lu,\"range\": %lu,\"azimuth\": %lu,\"res_tra\":\"%lX\","
                     " \"rec_tra\":\"%lX\",\"rssi\":%lu}\n",
                 utime,
                 *(uint32_t *)(&time_of_flight), 
-                *(uint32_t *)(&frame->spherical.range),
+                *(uint32_t *)(&range),
                 *(uint32_t *)(&frame->spherical.azimuth),
                 (frame->response_timestamp - frame->request_timestamp),
                 (frame->transmission_timestamp - frame->reception_timestamp),
-                *(uint32_t *)(&rssi)
+                *(uint32_t *)(&rssi_dbm)
         );
+#if MYNEWT_VAL(CAPTURE_ENABLED)
+        // Both frames of the exchange are kept, the replay pairs them back by address
+        capture_frame(inst, rng->frames[(rng->idx-1)%rng->nframes], utime, rssi);
+        capture_frame(inst, frame, utime, rssi);
+#endif
         //json_cir_encode(&g_cir, utime, "cir", CIR_SIZE);
         frame->code = DWT_DS_TWR_END;
     }    
@@ -145,6 +209,9 @@ static void slot_ev_cb(struct os_event *ev)
                 (frame->response_timestamp - frame->request_timestamp),
                 (frame->transmission_timestamp - frame->reception_timestamp)
         );
+#if MYNEWT_VAL(CAPTURE_ENABLED)
+        capture_frame(inst, frame, utime, dw1000_rssi_q8(inst));
+#endif
         frame->code = DWT_SS_TWR_END;
     }
 }
@@ -170,9 +237,6 @@ static struct os_callout slot_callout;
 
 static bool
 rx_complete_cb(struct _dw1000_dev_instance_t * inst){
-    if(inst->fctrl != FCNTL_IEEE_RANGE_16){
-        return false;
-    }
     os_callout_init(&slot_callout, os_eventq_dflt_get(), slot_ev_cb, inst);
     os_eventq_put(os_eventq_dflt_get(), &slot_callout.c_ev);
     return true;
@@ -257,14 +321,31 @@ int main(int argc, char **argv){
     dw1000_set_panid(inst,inst->PANID);
     dw1000_mac_init(inst, NULL);
     dw1000_rng_init(inst, &rng_config, sizeof(twr)/sizeof(twr_frame_t));
+#if MYNEWT_VAL(RNGBIAS_ENABLED)
+    rngbias_init(&g_rngbias, inst->config.channel, inst->config.prf == DWT_PRF_64M);
+#endif
     dw1000_rng_set_frames(inst, twr, sizeof(twr)/sizeof(twr_frame_t));
 
 #if MYNEWT_VAL(DW1000_PAN)
         dw1000_pan_init(inst, &pan_config);   
+#if MYNEWT_VAL(PANCACHE_ENABLED)
+        pancache_init(&g_pancache, inst);
+#if MYNEWT_VAL(PANJOIN_ENABLED)
+        panjoin_init(&g_panjoin, inst);
+        pancache_set_start(&g_pancache, pancache_start_cb);
+#endif
+        pancache_join(&g_pancache);
+#else
+#if MYNEWT_VAL(PANJOIN_ENABLED)
+        panjoin_init(&g_panjoin, inst);
+        panjoin_start(&g_panjoin);
+#else
         dw1000_pan_start(inst, DWT_NONBLOCKING); 
+#endif
         while(inst->pan->status.valid != true){ 
             os_eventq_run(os_eventq_dflt_get());
         }  
+#endif
 #endif
     printf("device_id = 0x%lX\n",inst->device_id);
     printf("PANID = 0x%X\n",inst->PANID);
@@ -276,14 +357,25 @@ int main(int argc, char **argv){
     printf("holdoff = %ld usec\n",rng_config.tx_holdoff_delay);
 
 
+    dw1000_extension_callbacks_t rx_cbs = {
+        .rx_complete_cb = rx_complete_cb
+    };
+    rc = dispatch_register(inst, FCNTL_IEEE_RANGE_16, DISPATCH_CODE_ANY_LO, DISPATCH_CODE_ANY_HI, &rx_cbs);
+    SYSINIT_PANIC_ASSERT(rc == 0);
     dw1000_extension_callbacks_t cbs = {
         .id = DW1000_RANGE,
-        .rx_complete_cb = rx_complete_cb,
         .rx_timeout_cb = rx_timeout_cb
     };
-
     dw1000_add_extension_callbacks(inst, cbs);
 
+#if MYNEWT_VAL(CAPTURE_ENABLED)
+    capture_config_t capture_config = {
+        .columns = CAPTURE_COL_TWR | CAPTURE_COL(CAPTURE_COL_RSSI) | CAPTURE_COL(CAPTURE_COL_FP_IDX),
+        .block_nrecords = MYNEWT_VAL(CAPTURE_BLOCK_NRECORDS)
+    };
+    capture_init(&g_capture, &capture_config, g_capture_index, MYNEWT_VAL(CAPTURE_INDEX_SIZE), capture_console_sink, NULL);
+#endif
+
 #if MYNEWT_VAL(DW1000_CCP_ENABLED)
     dw1000_ccp_init(inst, 2, MYNEWT_VAL(UUID_CCP_MASTER));
     dw1000_ccp_start(inst, CCP_ROLE_MASTER);
@@ -293,8 +385,12 @@ int main(int argc, char **argv){
         g_slot[i] = i;
 
     tdma_instance_t * tdma = tdma_init(inst, MYNEWT_VAL(TDMA_PERIOD), MYNEWT_VAL(TDMA_NSLOTS)); 
-    for (uint16_t i = 1; i < sizeof(g_slot)/sizeof(uint16_t); i++)
+    for (uint16_t i = 1; i < sizeof(g_slot)/sizeof(uint16_t); i++){
+        // Data slots of the lwip apps stay free
+        if (i < 64 && (MYNEWT_VAL(TDMA_DATA_SLOTS) & (1ULL << i)))
+            continue;
         tdma_assign_slot(tdma, slot_timer_cb,  g_slot[i], &g_slot[i]);
+    }
 
     while (1) {
         os_eventq_run(os_eventq_dflt_get());
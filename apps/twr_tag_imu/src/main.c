@@ -22,6 +22,7 @@
 #include <assert.h>
 #include <string.h>
 #include <stdio.h>
+#include <math.h>
 #include "sysinit/sysinit.h"
 #include "os/os.h"
 #include "bsp/bsp.h"
@@ -46,9 +47,44 @@
 
 #define IMU_READ_RATE (OS_TICKS_PER_SEC/10)
 
+#if MYNEWT_VAL(IMU_PRINT)
+#define imu_printf console_printf
+#else
+// Arguments stay referenced so the sample variables do not trip unused warnings
+#define imu_printf(...) do { if (0) console_printf(__VA_ARGS__); } while (0)
+#endif
+
 #if MYNEWT_VAL(DW1000_LWIP)
 #include <dw1000/dw1000_lwip.h>
 #endif
+#if MYNEWT_VAL(RATECTL_ENABLED)
+#include <ratectl/dw1000_ratectl.h>
+static ratectl_instance_t g_ratectl;
+static bool g_rx_hold;                  // Receiver left off for the rest of a slow period
+#endif
+#if MYNEWT_VAL(IMU_FIFO_ENABLED)
+#include <imufifo/dw1000_imufifo.h>
+static imufifo_instance_t g_imufifo;
+#endif
+#if MYNEWT_VAL(UWBTIME_ENABLED)
+#include <uwbtime/dw1000_uwbtime.h>
+static uwbtime_instance_t g_uwbtime;
+#endif
+#if MYNEWT_VAL(FUSION_ENABLED)
+#include <fusion/dw1000_fusion.h>
+#include <anchors/dw1000_anchors.h>
+static fusion_instance_t g_fusion;
+static fusion_imu_t g_imu;
+static float g_mag[3];
+static bool g_mag_valid;
+// Anchor positions are loaded from config, see lib/anchors
+static anchors_instance_t g_anchors;
+
+static int
+fusion_anchor_cb(void * arg, uint16_t address, int32_t x, int32_t y, int32_t z){
+    return fusion_anchor_set((fusion_instance_t *) arg, address, x, y, z);
+}
+#endif
 
 static dw1000_rng_config_t rng_config = {
     .tx_holdoff_delay = 0x0380,          // Send Time delay in usec.
@@ -86,6 +122,22 @@ void print_frame(const char * name, twr_frame_t twr){
 static struct os_callout twr_callout;
 static struct os_callout sensor_callout;
 
+/*
+ * Re-arm the receiver after a range. A stationary tag stays off air for
+ * RATECTL_STILL_DIVISOR timer periods, the polls of the node in between go
+ * unanswered.
+ */
+static void rx_restart(dw1000_dev_instance_t * inst){
+#if MYNEWT_VAL(RATECTL_ENABLED)
+    if (ratectl_divisor(&g_ratectl) > 1){
+        g_rx_hold = true;
+        return;
+    }
+#endif
+    dw1000_set_rx_timeout(inst, 0);
+    dw1000_start_rx(inst);
+}
+
 /*
  * Event callback function for timer events. 
 */
@@ -98,6 +150,17 @@ static void twr_timer_ev_cb(struct os_event *ev) {
     
     assert(inst->rng->nframes > 0);
 
+#if MYNEWT_VAL(RATECTL_ENABLED)
+    ratectl_update(&g_ratectl, os_cputime_ticks_to_usecs(os_cputime_get32()));
+    if (g_rx_hold){
+        g_rx_hold = false;
+        dw1000_set_rx_timeout(inst, 0);
+        dw1000_start_rx(inst);
+        os_callout_reset(&twr_callout, OS_TICKS_PER_SEC/100);
+        return;
+    }
+#endif
+
 #if 0
     if (dw1000_rng_request(inst, 0x1234, DWT_DS_TWR).rx_error)
         printf("twr_timer_ev_cb:rng_request failed [status.mac_error]\n");
@@ -123,6 +186,13 @@ static void twr_timer_ev_cb(struct os_event *ev) {
    else if (twr[0].code == DWT_SS_TWR_FINAL) {
         uint32_t time_of_flight = (uint32_t) dw1000_rng_twr_to_tof(rng);
         float range = dw1000_rng_tof_to_meters(dw1000_rng_twr_to_tof(rng));
+#if MYNEWT_VAL(FUSION_ENABLED)
+        fusion_range(&g_fusion, (twr[0].src_address == inst->my_short_address) ? twr[0].dst_address : twr[0].src_address, range);
+#endif
+#if MYNEWT_VAL(RATECTL_ENABLED)
+        ratectl_range(&g_ratectl, os_cputime_ticks_to_usecs(os_cputime_get32()),
+                (twr[0].src_address == inst->my_short_address) ? twr[0].dst_address : twr[0].src_address, (int32_t)(range * 1000));
+#endif
         print_frame("trw=", twr[0]);
         twr[0].code = DWT_SS_TWR_END;
         printf("{\"utime\": %lu,\"tof\": %lu,\"range\": %lu,\"res_req\": %lX, \"rec_tra\": %lX}\n", 
@@ -132,13 +202,19 @@ static void twr_timer_ev_cb(struct os_event *ev) {
             (twr->response_timestamp - twr->request_timestamp), 
             (twr->transmission_timestamp - twr->reception_timestamp)
         );         
-        dw1000_set_rx_timeout(inst, 0);
-        dw1000_start_rx(inst); 
+        rx_restart(inst);
     }
 
     else if (twr[1].code == DWT_DS_TWR_FINAL || twr[1].code == DWT_DS_TWR_EXT_FINAL) {
         uint32_t time_of_flight = (uint32_t) dw1000_rng_twr_to_tof(rng);
         float range = dw1000_rng_tof_to_meters(dw1000_rng_twr_to_tof(rng));
+#if MYNEWT_VAL(FUSION_ENABLED)
+        fusion_range(&g_fusion, (twr[1].src_address == inst->my_short_address) ? twr[1].dst_address : twr[1].src_address, range);
+#endif
+#if MYNEWT_VAL(RATECTL_ENABLED)
+        ratectl_range(&g_ratectl, os_cputime_ticks_to_usecs(os_cputime_get32()),
+                (twr[1].src_address == inst->my_short_address) ? twr[1].dst_address : twr[1].src_address, (int32_t)(range * 1000));
+#endif
         print_frame("1st=", twr[0]);
         print_frame("2nd=", twr[1]);
         twr[1].code = DWT_DS_TWR_END;
@@ -150,10 +226,14 @@ static void twr_timer_ev_cb(struct os_event *ev) {
             (twr->transmission_timestamp - twr->reception_timestamp)
         );
 
-        dw1000_set_rx_timeout(inst, 0);
-        dw1000_start_rx(inst); 
+        rx_restart(inst);
     }
 
+#if MYNEWT_VAL(RATECTL_ENABLED)
+    if (g_rx_hold)
+        os_callout_reset(&twr_callout, OS_TICKS_PER_SEC/100 * ratectl_divisor(&g_ratectl));
+    else
+#endif
     os_callout_reset(&twr_callout, OS_TICKS_PER_SEC/100);
 }
 
@@ -169,71 +249,151 @@ int sensor_data_cb(struct sensor* sensor, void *arg, void *data, sensor_type_t t
         type == SENSOR_TYPE_LINEAR_ACCEL  ||
         type == SENSOR_TYPE_GRAVITY) {
 
-        console_printf("accel (m/s^2) ");
+        imu_printf("accel (m/s^2) ");
 
         sad = (struct sensor_accel_data *) data;
+#if MYNEWT_VAL(FUSION_ENABLED)
+        g_imu.accel[0] = sad->sad_x_is_valid ? sad->sad_x : 0;
+        g_imu.accel[1] = sad->sad_y_is_valid ? sad->sad_y : 0;
+        g_imu.accel[2] = sad->sad_z_is_valid ? sad->sad_z : 0;
+#endif
+#if MYNEWT_VAL(RATECTL_ENABLED)
+        if (sad->sad_x_is_valid && sad->sad_y_is_valid && sad->sad_z_is_valid)
+            ratectl_accel(&g_ratectl, os_cputime_ticks_to_usecs(os_cputime_get32()), (float[3]){sad->sad_x, sad->sad_y, sad->sad_z});
+#endif
         if (sad->sad_x_is_valid) {
-            console_printf("x = %s ", sensor_ftostr(sad->sad_x, tmpstr, 13));
+            imu_printf("x = %s ", sensor_ftostr(sad->sad_x, tmpstr, 13));
         }
         if (sad->sad_y_is_valid) {
-            console_printf("y = %s ", sensor_ftostr(sad->sad_y, tmpstr, 13));
+            imu_printf("y = %s ", sensor_ftostr(sad->sad_y, tmpstr, 13));
         }
         if (sad->sad_z_is_valid) {
-            console_printf("z = %s", sensor_ftostr(sad->sad_z, tmpstr, 13));
+            imu_printf("z = %s", sensor_ftostr(sad->sad_z, tmpstr, 13));
         }
-        console_printf("\n");
+        imu_printf("\n");
     }
 
     if (type == SENSOR_TYPE_MAGNETIC_FIELD) {
         smd = (struct sensor_mag_data *) data;
-        console_printf("compass (uT)  ");
+#if MYNEWT_VAL(FUSION_ENABLED)
+        g_mag[0] = smd->smd_x;
+        g_mag[1] = smd->smd_y;
+        g_mag[2] = smd->smd_z;
+        g_mag_valid = smd->smd_x_is_valid && smd->smd_y_is_valid;
+#endif
+        imu_printf("compass (uT)  ");
         if (smd->smd_x_is_valid) {
-            console_printf("x = %s ", sensor_ftostr(smd->smd_x, tmpstr, 13));
+            imu_printf("x = %s ", sensor_ftostr(smd->smd_x, tmpstr, 13));
         }
         if (smd->smd_y_is_valid) {
-            console_printf("y = %s ", sensor_ftostr(smd->smd_y, tmpstr, 13));
+            imu_printf("y = %s ", sensor_ftostr(smd->smd_y, tmpstr, 13));
         }
         if (smd->smd_z_is_valid) {
-            console_printf("z = %s ", sensor_ftostr(smd->smd_z, tmpstr, 13));
+            imu_printf("z = %s ", sensor_ftostr(smd->smd_z, tmpstr, 13));
         }
-        console_printf("\n");
+        imu_printf("\n");
     }
 
     if (type == SENSOR_TYPE_GYROSCOPE) {
         sgd = (struct sensor_gyro_data *) data;
-        console_printf("gyro (deg/s)  ");
+#if MYNEWT_VAL(FUSION_ENABLED)
+        g_imu.gyro[0] = sgd->sgd_x_is_valid ? sgd->sgd_x : 0;
+        g_imu.gyro[1] = sgd->sgd_y_is_valid ? sgd->sgd_y : 0;
+        g_imu.gyro[2] = sgd->sgd_z_is_valid ? sgd->sgd_z : 0;
+#endif
+#if MYNEWT_VAL(RATECTL_ENABLED)
+        if (sgd->sgd_x_is_valid && sgd->sgd_y_is_valid && sgd->sgd_z_is_valid)
+            ratectl_gyro(&g_ratectl, os_cputime_ticks_to_usecs(os_cputime_get32()), (float[3]){sgd->sgd_x, sgd->sgd_y, sgd->sgd_z});
+#endif
+        imu_printf("gyro (deg/s)  ");
         
         if (sgd->sgd_x_is_valid) {
-            console_printf("x = %s ", sensor_ftostr(sgd->sgd_x, tmpstr, 13));
+            imu_printf("x = %s ", sensor_ftostr(sgd->sgd_x, tmpstr, 13));
         }
         if (sgd->sgd_y_is_valid) {
-            console_printf("y = %s ", sensor_ftostr(sgd->sgd_y, tmpstr, 13));
+            imu_printf("y = %s ", sensor_ftostr(sgd->sgd_y, tmpstr, 13));
         }
         if (sgd->sgd_z_is_valid) {
-            console_printf("z = %s ", sensor_ftostr(sgd->sgd_z, tmpstr, 13));
+            imu_printf("z = %s ", sensor_ftostr(sgd->sgd_z, tmpstr, 13));
         }
-        console_printf("\n");
+        imu_printf("\n");
     }
     
     if (type == SENSOR_TYPE_PRESSURE) {
         spd = (struct sensor_press_data *) data;
         if (spd->spd_press_is_valid) {
-            console_printf("pressure = %s Pa",
+            imu_printf("pressure = %s Pa",
                            sensor_ftostr(spd->spd_press, tmpstr, 13));
         }
-        console_printf("\n");
+        imu_printf("\n");
     }
     return (0);
 }
 
+#if MYNEWT_VAL(FUSION_ENABLED)
+static void fusion_print(void){
+    printf("{\"utime\": %lu,\"fusion\": {\"x\": %ld,\"y\": %ld,\"vx\": %ld,\"vy\": %ld,\"heading\": %ld}}\n",
+            os_cputime_ticks_to_usecs(os_cputime_get32()),
+            (int32_t)(g_fusion.state[FUSION_X] * 1000), (int32_t)(g_fusion.state[FUSION_Y] * 1000),
+            (int32_t)(g_fusion.state[FUSION_VX] * 1000), (int32_t)(g_fusion.state[FUSION_VY] * 1000),
+            (int32_t)(g_fusion.state[FUSION_PSI] * 180000 / M_PI));
+}
+#endif
+
+#if MYNEWT_VAL(IMU_FIFO_ENABLED)
+#if MYNEWT_VAL(UWBTIME_ENABLED)
+static uint64_t imufifo_uwbtime(void * arg, uint32_t cputime){
+    return uwbtime_from_cputime((uwbtime_instance_t *) arg, cputime);
+}
+#endif
+
+/*
+ * Batch consumer, samples are spaced by the batch period back from the newest.
+ */
+static void imufifo_batch_cb(imufifo_instance_t * imu, const imufifo_batch_t * batch, void * arg){
+    uint32_t utime = os_cputime_ticks_to_usecs(batch->cputime) - (batch->nsamples - 1) * batch->period;
+
+    imu_printf("{\"utime\": %lu,\"imu_batch\": {\"n\": %u,\"period\": %lu,\"uwbtime\": \"0x%lX%08lX\"}}\n",
+            utime, batch->nsamples, batch->period, (uint32_t)(batch->timestamp >> 32), (uint32_t)batch->timestamp);
+    for (uint16_t i = 0; i < batch->nsamples; i++, utime += batch->period){
+        const imufifo_sample_t * sample = &batch->samples[i];
+#if MYNEWT_VAL(FUSION_ENABLED) || MYNEWT_VAL(RATECTL_ENABLED)
+        float accel[3], gyro[3];
+        for (uint8_t j = 0; j < 3; j++){
+            accel[j] = sample->accel[j] * imu->accel_scale;
+            gyro[j] = sample->gyro[j] * imu->gyro_scale;
+        }
+#endif
+#if MYNEWT_VAL(RATECTL_ENABLED)
+        ratectl_accel(&g_ratectl, utime, accel);
+        ratectl_gyro(&g_ratectl, utime, gyro);
+#endif
+#if MYNEWT_VAL(FUSION_ENABLED)
+        fusion_imu_t fimu;
+        memcpy(fimu.accel, accel, sizeof(accel));
+        memcpy(fimu.gyro, gyro, sizeof(gyro));
+        fusion_predict(&g_fusion, utime, &fimu);
+#endif
+        imu_printf("{\"utime\": %lu,\"accel\": [%d,%d,%d],\"gyro\": [%d,%d,%d]}\n", utime,
+                sample->accel[0], sample->accel[1], sample->accel[2], sample->gyro[0], sample->gyro[1], sample->gyro[2]);
+    }
+#if MYNEWT_VAL(FUSION_ENABLED)
+    fusion_print();
+#endif
+}
+#endif
+
 /*
  * Event callback function for timer events. 
 */
 static void sensor_timer_ev_cb(struct os_event *ev) {
     int rc;
     struct sensor *s;
-    sensor_type_t sensor_types[] = {SENSOR_TYPE_ACCELEROMETER,
+    sensor_type_t sensor_types[] = {
+#if !MYNEWT_VAL(IMU_FIFO_ENABLED)
+                                    SENSOR_TYPE_ACCELEROMETER,
                                     SENSOR_TYPE_GYROSCOPE,
+#endif
                                     SENSOR_TYPE_MAGNETIC_FIELD,
                                     SENSOR_TYPE_PRESSURE,
                                     SENSOR_TYPE_NONE};
@@ -255,7 +415,19 @@ static void sensor_timer_ev_cb(struct os_event *ev) {
 
         i++;
     }
-    
+
+#if MYNEWT_VAL(FUSION_ENABLED)
+#if MYNEWT_VAL(IMU_FIFO_ENABLED)
+    // Prediction runs on the FIFO batches, only the heading is corrected here
+    if (g_mag_valid)
+        fusion_heading(&g_fusion, g_mag);
+#else
+    fusion_predict(&g_fusion, os_cputime_ticks_to_usecs(os_cputime_get32()), &g_imu);
+    if (g_mag_valid)
+        fusion_heading(&g_fusion, g_mag);
+    fusion_print();
+#endif
+#endif
     os_callout_reset(&sensor_callout, IMU_READ_RATE);
 }
 
@@ -288,7 +460,32 @@ int main(int argc, char **argv){
     dw1000_mac_init(inst, NULL);
     dw1000_rng_init(inst, &rng_config, sizeof(twr)/sizeof(twr_frame_t));
     dw1000_rng_set_frames(inst, twr, sizeof(twr)/sizeof(twr_frame_t));
-
+#if MYNEWT_VAL(RATECTL_ENABLED)
+    ratectl_init(&g_ratectl);
+#endif
+#if MYNEWT_VAL(FUSION_ENABLED)
+    anchors_init(&g_anchors);
+    // The filter starts from the centroid of the anchors it is initialised with
+    fusion_anchor_t anchors[MYNEWT_VAL(ANCHORS_N)];
+    for (uint16_t i = 0; i < g_anchors.nanchors; i++)
+        anchors[i] = (fusion_anchor_t){.address = g_anchors.anchors[i].address,
+                .x = g_anchors.anchors[i].x, .y = g_anchors.anchors[i].y, .z = g_anchors.anchors[i].z};
+    fusion_init(&g_fusion, anchors, g_anchors.nanchors);
+    anchors_set_cb(&g_anchors, fusion_anchor_cb, &g_fusion);
+#endif
+#if MYNEWT_VAL(UWBTIME_ENABLED)
+    uwbtime_init(&g_uwbtime, inst);
+    uwbtime_start(&g_uwbtime);
+#endif
+#if MYNEWT_VAL(IMU_FIFO_ENABLED)
+    if (imufifo_init(&g_imufifo, imufifo_batch_cb, NULL) == 0){
+#if MYNEWT_VAL(UWBTIME_ENABLED)
+        imufifo_set_clock(&g_imufifo, imufifo_uwbtime, &g_uwbtime);
+#endif
+        imufifo_start(&g_imufifo);
+    }else
+        printf("imufifo_init failed\n");
+#endif
 
     printf("device_id=%lX\n",inst->device_id);
     printf("PANID=%X\n",inst->PANID);
@@ -37,6 +37,7 @@
 #include "dw1000/dw1000_mac.h"
 #include "dw1000/dw1000_rng.h"
 #include "dw1000/dw1000_ftypes.h"
+#include <rssi/dw1000_rssi.h>
 
 #if MYNEWT_VAL(DW1000_LWIP)
 #include <dw1000/dw1000_lwip.h>
@@ -47,6 +48,20 @@
 #if MYNEWT_VAL(DW1000_PAN)
 #include <dw1000/dw1000_pan.h>
 #endif
+#if MYNEWT_VAL(PANCACHE_ENABLED)
+#include <pancache/dw1000_pancache.h>
+static pancache_instance_t g_pancache;
+#endif
+#if MYNEWT_VAL(PANJOIN_ENABLED)
+#include <panjoin/dw1000_panjoin.h>
+static panjoin_instance_t g_panjoin;
+#if MYNEWT_VAL(PANCACHE_ENABLED)
+static void
+pancache_start_cb(pancache_instance_t * cache){
+    panjoin_start(&g_panjoin);
+}
+#endif
+#endif
 
 static dw1000_rng_config_t rng_config = {
     .tx_holdoff_delay = 0x0600,         // Send Time delay in usec.
@@ -124,7 +139,7 @@ static void timer_ev_cb(struct os_event *ev) {
     else if (frame->code == DWT_SS_TWR_FINAL) {
         uint32_t time_of_flight = (uint32_t) dw1000_rng_twr_to_tof(rng);
         float range = dw1000_rng_tof_to_meters(dw1000_rng_twr_to_tof(rng));
-        float rssi = dw1000_get_rssi(inst);
+        int16_t rssi = dw1000_rssi_q8(inst);
         print_frame("trw=", frame);
         frame->code = DWT_SS_TWR_END;
         printf("{\"utime\": %lu,\"tof\": %lu,\"range\": %lu,\"res_req\": %lX,"
@@ -134,7 +149,7 @@ static void timer_ev_cb(struct os_event *ev) {
             (uint32_t)(range * 1000), 
             (frame->response_timestamp - frame->request_timestamp),
             (frame->transmission_timestamp - frame->reception_timestamp),
-            (int)(rssi)
+            rssi / 256
         );         
         dw1000_set_rx_timeout(inst, 0);
         dw1000_start_rx(inst); 
@@ -143,7 +158,7 @@ static void timer_ev_cb(struct os_event *ev) {
     else if (frame->code == DWT_DS_TWR_FINAL || frame->code == DWT_DS_TWR_EXT_FINAL) {
         uint32_t time_of_flight = (uint32_t) dw1000_rng_twr_to_tof(rng);
         float range = dw1000_rng_tof_to_meters(dw1000_rng_twr_to_tof(rng));
-        float rssi = dw1000_get_rssi(inst);
+        int16_t rssi = dw1000_rssi_q8(inst);
         print_frame("1st=", previous_frame);
         print_frame("2nd=", frame);
         frame->code = DWT_DS_TWR_END;
@@ -154,7 +169,7 @@ static void timer_ev_cb(struct os_event *ev) {
             (uint32_t)(range * 1000), 
             (frame->response_timestamp - frame->request_timestamp),
             (frame->transmission_timestamp - frame->reception_timestamp),
-            (int)(rssi)
+            rssi / 256
         );
         dw1000_set_rx_timeout(inst, 0);
         dw1000_start_rx(inst); 
@@ -190,11 +205,25 @@ int main(int argc, char **argv){
 #endif
 #if MYNEWT_VAL(DW1000_PAN)
     dw1000_pan_init(inst, &pan_config); 
+#if MYNEWT_VAL(PANCACHE_ENABLED)
+    pancache_init(&g_pancache, inst);
+#if MYNEWT_VAL(PANJOIN_ENABLED)
+    panjoin_init(&g_panjoin, inst);
+    pancache_set_start(&g_pancache, pancache_start_cb);
+#endif
+    pancache_join(&g_pancache);
+#else
+#if MYNEWT_VAL(PANJOIN_ENABLED)
+    panjoin_init(&g_panjoin, inst);
+    panjoin_start(&g_panjoin);
+#else
     dw1000_pan_start(inst, DWT_NONBLOCKING); // Don't block on the eventq_dflt
+#endif
     while(inst->pan->status.valid != true){ 
         os_eventq_run(os_eventq_dflt_get());
         os_cputime_delay_usecs(5000);
     } 
+#endif
      dw1000_softreset(inst);
      dw1000_phy_init(inst, NULL);
      dw1000_set_panid(inst,inst->PANID);
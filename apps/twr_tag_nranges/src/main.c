@@ -51,6 +51,31 @@
 #include <dw1000_nranges.h>
 dw1000_nranges_instance_t nranges_instance;
 #endif
+#if MYNEWT_VAL(CAPTURE_ENABLED)
+#include <capture/dw1000_capture.h>
+static capture_instance_t g_capture;
+static capture_index_entry_t g_capture_index[MYNEWT_VAL(CAPTURE_INDEX_SIZE)];
+
+static void
+capture_frame(twr_frame_t * frame, uint32_t utime){
+    capture_record_t record = {
+        .utime = utime,
+        .src_address = frame->src_address,
+        .dst_address = frame->dst_address,
+        .code = frame->code,
+        .request_timestamp = frame->request_timestamp,
+        .response_timestamp = frame->response_timestamp,
+        .reception_timestamp = frame->reception_timestamp,
+        .transmission_timestamp = frame->transmission_timestamp
+    };
+    capture_append(&g_capture, &record);
+#if MYNEWT_VAL(CAPTURE_SESSION_NRECORDS)
+    // Close the session to get the index and trailer out, the next file follows on the console
+    if (g_capture.nrecords >= MYNEWT_VAL(CAPTURE_SESSION_NRECORDS))
+        capture_rotate(&g_capture);
+#endif
+}
+#endif
 
 
 static dw1000_rng_config_t rng_config = {
@@ -147,6 +172,12 @@ static void timer_ev_cb(struct os_event *ev) {
         int i;
         for(i = 0 ; i < nranges->resp_count ; i++)
         {
+#if MYNEWT_VAL(CAPTURE_ENABLED)
+            // Both frames of the exchange are kept, the replay pairs them back by src_address
+            uint32_t utime = os_cputime_ticks_to_usecs(os_cputime_get32());
+            capture_frame(previous_frame+i, utime);
+            capture_frame(previous_frame+i+nnodes, utime);
+#endif
             float range = dw1000_rng_tof_to_meters(dw1000_nranges_twr_to_tof_frames(previous_frame+i, previous_frame+i+nnodes));
             printf("   src_address = 0x%X\n   dst_address = 0x%X\n",(previous_frame+i)->src_address,(previous_frame+i)->dst_address);
             printf("         range========= %lu\n",(uint32_t)(range*1000));
@@ -201,6 +232,13 @@ int main(int argc, char **argv){
     nranges->nnodes= MYNEWT_VAL(N_NODES);
     dw1000_nranges_init(inst, nranges);
     printf("number of nodes  ===== %u \n",nranges->nnodes);
+#endif
+#if MYNEWT_VAL(CAPTURE_ENABLED)
+    capture_config_t capture_config = {
+        .columns = CAPTURE_COL_TWR,
+        .block_nrecords = MYNEWT_VAL(CAPTURE_BLOCK_NRECORDS)
+    };
+    capture_init(&g_capture, &capture_config, g_capture_index, MYNEWT_VAL(CAPTURE_INDEX_SIZE), capture_console_sink, NULL);
 #endif
     printf("device_id = 0x%lX\n",inst->device_id);
     printf("PANID = 0x%X\n",inst->PANID);
@@ -34,37 +34,56 @@ extern "C" {
 #include <dw1000/dw1000_dev.h>
 #include <dw1000/dw1000_ftypes.h>
 #include <dw1000/dw1000_rng.h>
+#include <nrngtof/dw1000_nrngtof.h>
+#include "syscfg/syscfg.h"
+#if MYNEWT_VAL(N_RANGES_HOLDOFF_CAL)
+#include <holdoff/dw1000_holdoff.h>
+#endif
+#if MYNEWT_VAL(N_RANGES_SPIQ)
+#include <spiq/dw1000_spiq.h>
+#endif
 
 #define FCNTL_IEEE_N_RANGES_16 0x88C1
 
-typedef enum _dw1000_nranges_modes_t{
-    DWT_DS_TWR_NRNG = 17,
-    DWT_DS_TWR_NRNG_T1,
-    DWT_DS_TWR_NRNG_T2,
-    DWT_DS_TWR_NRNG_FINAL,
-    DWT_DS_TWR_NRNG_END,
-    DWT_DS_TWR_NRNG_EXT,
-    DWT_DS_TWR_NRNG_EXT_T1,
-    DWT_DS_TWR_NRNG_EXT_T2,
-    DWT_DS_TWR_NRNG_EXT_FINAL,
-    DWT_DS_TWR_NRNG_EXT_END
-}dw1000_nranges_modes_t;
-
 typedef struct _dw1000_nranges_instance_t{
     uint16_t nnodes;
     uint16_t resp_count;
     uint16_t timeout_count;
     uint16_t t1_final_flag;
     uint16_t initiator:1;
+    uint16_t prearmed:1;                // T1 response staged in the tx buffer
+    uint16_t prearmed_dst;              // dst_address of the staged T1 response
     struct os_sem sem;
+#if MYNEWT_VAL(N_RANGES_HOLDOFF_CAL)
+    holdoff_instance_t holdoff;
+#endif
+#if MYNEWT_VAL(N_RANGES_SPIQ)
+    spiq_instance_t spiq;
+#if MYNEWT_VAL(N_RANGES_HOLDOFF_CAL)
+    uint16_t holdoff_queued:1;          // SYS_TIME read staged behind DX_TIME
+    uint64_t holdoff_rx_timestamp;      // Request answered by the queued response
+    uint64_t holdoff_systime;           // SYS_TIME read back by the queue, 5 bytes little endian
+#endif
+#endif
 }dw1000_nranges_instance_t;
 
+/*
+ * TX and RX timestamps of the current exchange, full 40-bit and low 32-bit views.
+ */
+typedef struct _dw1000_nranges_timestamps_t{
+    uint64_t tx;
+    uint64_t rx;
+    uint32_t tx_lo;
+    uint32_t rx_lo;
+}dw1000_nranges_timestamps_t;
+
 dw1000_nranges_instance_t * dw1000_nranges_init(dw1000_dev_instance_t * inst,  dw1000_nranges_instance_t * nranges);
 dw1000_dev_status_t dw1000_nranges_request_delay_start(dw1000_dev_instance_t * inst, uint16_t dst_address, uint64_t delay, dw1000_rng_modes_t code);
 dw1000_dev_status_t dw1000_nranges_request(dw1000_dev_instance_t * inst, uint16_t dst_address, dw1000_nranges_modes_t code);
 void dw1000_nranges_set_ext_callbacks(dw1000_dev_instance_t * inst, dw1000_extension_callbacks_t nranges_cbs);
+void dw1000_nranges_prearm(dw1000_dev_instance_t * inst);
+void dw1000_nranges_read_timestamps(dw1000_dev_instance_t * inst, dw1000_nranges_timestamps_t * timestamps);
 void send_final_msg(dw1000_dev_instance_t * inst, twr_frame_t * frame);
-float dw1000_nranges_twr_to_tof_frames(twr_frame_t *first_frame, twr_frame_t *final_frame);
 
 #ifdef __cplusplus
 }
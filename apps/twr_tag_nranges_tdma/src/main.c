@@ -37,6 +37,7 @@
 #include <dw1000/dw1000_mac.h>
 #include <dw1000/dw1000_rng.h>
 #include <dw1000/dw1000_ftypes.h>
+#include <dispatch/dw1000_dispatch.h>
 
 #if MYNEWT_VAL(DW1000_CCP_ENABLED)
 #include <dw1000/dw1000_ccp.h>
@@ -54,6 +55,63 @@
 #include <dw1000_nranges.h>
 dw1000_nranges_instance_t nranges_instance;
 #endif
+#if MYNEWT_VAL(UWBTIME_ENABLED)
+#include <uwbtime/dw1000_uwbtime.h>
+#endif
+#if MYNEWT_VAL(RATECTL_ENABLED)
+#include <ratectl/dw1000_ratectl.h>
+static ratectl_instance_t g_ratectl;
+#endif
+#if MYNEWT_VAL(MLAT_ENABLED)
+#include <mlat/dw1000_mlat.h>
+#include <anchors/dw1000_anchors.h>
+static mlat_instance_t g_mlat;
+// Anchor positions are loaded from config, see lib/anchors
+static anchors_instance_t g_anchors;
+
+static int
+mlat_anchor_cb(void * arg, uint16_t address, int32_t x, int32_t y, int32_t z){
+    return mlat_anchor_set((mlat_instance_t *) arg, address, x, y, z);
+}
+#endif
+#if MYNEWT_VAL(RNGFILTER_ENABLED)
+#include <rngfilter/dw1000_rngfilter.h>
+static rngfilter_instance_t g_rngfilter;
+#endif
+#if MYNEWT_VAL(LINKSTATS_ENABLED)
+#include <linkstats/dw1000_linkstats.h>
+static linkstats_instance_t g_linkstats;
+#endif
+#if MYNEWT_VAL(CAPTURE_ENABLED)
+#include <capture/dw1000_capture.h>
+static capture_instance_t g_capture;
+static capture_index_entry_t g_capture_index[MYNEWT_VAL(CAPTURE_INDEX_SIZE)];
+
+static void
+capture_frame(twr_frame_t * frame, uint32_t utime){
+    capture_record_t record = {
+        .utime = utime,
+        .src_address = frame->src_address,
+        .dst_address = frame->dst_address,
+        .code = frame->code,
+        .request_timestamp = frame->request_timestamp,
+        .response_timestamp = frame->response_timestamp,
+        .reception_timestamp = frame->reception_timestamp,
+        .transmission_timestamp = frame->transmission_timestamp
+    };
+    capture_append(&g_capture, &record);
+#if MYNEWT_VAL(CAPTURE_SESSION_NRECORDS)
+    // Close the session to get the index and trailer out, the next file follows on the console
+    if (g_capture.nrecords >= MYNEWT_VAL(CAPTURE_SESSION_NRECORDS))
+        capture_rotate(&g_capture);
+#endif
+}
+#endif
+
+#if MYNEWT_VAL(UWBTIME_ENABLED)
+static uwbtime_instance_t g_uwbtime;
+static uint64_t g_request_uwbtime;      // Scheduled start of the current round
+#endif
 
 static dw1000_rng_config_t rng_config = {
     .tx_holdoff_delay = 0x0600,         // Send Time delay in usec.
@@ -132,6 +190,15 @@ slot_timer_cb(struct os_event *ev){
     uint64_t dx_time = (clk->epoch + (uint64_t) (idx * ((uint64_t)tdma->period << 16)/tdma->nslots));
 #endif
     dx_time = dx_time  & 0xFFFFFFFE00UL;
+#if MYNEWT_VAL(UWBTIME_ENABLED)
+    g_request_uwbtime = uwbtime_extend(&g_uwbtime, dx_time);
+#endif
+#if MYNEWT_VAL(RATECTL_ENABLED)
+    // A stationary tag leaves its slot idle, the request below blocks until
+    // the round completes so there is nothing left to pick up
+    if (ratectl_skip(&g_ratectl, os_cputime_ticks_to_usecs(os_cputime_get32())))
+        return;
+#endif
     //    uint32_t tic = os_cputime_ticks_to_usecs(os_cputime_get32());
     if(dw1000_nranges_request_delay_start(inst, 0xffff, dx_time, DWT_DS_TWR_NRNG).start_tx_error){
         uint32_t utime = os_cputime_ticks_to_usecs(os_cputime_get32());
@@ -161,17 +228,70 @@ slot_timer_cb(struct os_event *ev){
     if (frame->code == DWT_DS_TWR_NRNG_FINAL || frame->code == DWT_DS_TWR_NRNG_EXT_FINAL) {
         previous_frame = rng->frames[0];
         int i;
+#if MYNEWT_VAL(MLAT_ENABLED)
+        mlat_range_t ranges[MYNEWT_VAL(N_NODES)];
+#endif
         for(i = 0 ; i < nranges->resp_count ; i++)
         {
+#if MYNEWT_VAL(CAPTURE_ENABLED)
+            // Both frames of the exchange are kept, the replay pairs them back by src_address
+#if MYNEWT_VAL(UWBTIME_ENABLED)
+            // Stamped with the time of the request on air rather than of its processing
+            uint32_t utime = os_cputime_ticks_to_usecs(uwbtime_to_cputime(&g_uwbtime, g_request_uwbtime));
+#else
+            uint32_t utime = os_cputime_ticks_to_usecs(os_cputime_get32());
+#endif
+            capture_frame(previous_frame+i, utime);
+            capture_frame(previous_frame+i+nnodes, utime);
+#endif
             float range = dw1000_rng_tof_to_meters(dw1000_nranges_twr_to_tof_frames(previous_frame+i, previous_frame+i+nnodes));
+#if MYNEWT_VAL(LINKSTATS_ENABLED)
+            linkstats_update(&g_linkstats, (previous_frame+i)->src_address, (previous_frame+i)->dst_address, (int32_t)(range*1000));
+#endif
+#if MYNEWT_VAL(RATECTL_ENABLED)
+            ratectl_range(&g_ratectl, os_cputime_ticks_to_usecs(os_cputime_get32()), (previous_frame+i)->src_address, (int32_t)(range*1000));
+#endif
+#if MYNEWT_VAL(RNGFILTER_ENABLED)
+            rngfilter_output_t filtered;
+            rngfilter_update(&g_rngfilter, (previous_frame+i)->src_address, (previous_frame+i)->dst_address,
+                    os_cputime_ticks_to_usecs(os_cputime_get32()), (int32_t)(range*1000), &filtered);
+#endif
+#if MYNEWT_VAL(MLAT_ENABLED)
+            ranges[i].address = (previous_frame+i)->src_address;
+#if MYNEWT_VAL(RNGFILTER_ENABLED)
+            ranges[i].range = filtered.range_mm / 1000.0f;
+#else
+            ranges[i].range = range;
+#endif
+#endif
+#if MYNEWT_VAL(RNGFILTER_ENABLED)
+            // Reported with or without the raw output, linkstats only summarises the unfiltered ranges
+            printf("  src_addr= 0x%X  dst_addr= 0x%X  range= %lu  filtered= %ld  rate= %ld\n",(previous_frame+i)->src_address,(previous_frame+i)->dst_address,
+                    (uint32_t)(range*1000), filtered.range_mm, filtered.rate_mms);
+#elif !MYNEWT_VAL(LINKSTATS_ENABLED) || MYNEWT_VAL(LINKSTATS_RAW)
             printf("  src_addr= 0x%X  dst_addr= 0x%X  range= %lu\n",(previous_frame+i)->src_address,(previous_frame+i)->dst_address, (uint32_t)(range*1000));
+#endif
             (previous_frame+i+nnodes)->code = DWT_DS_TWR_NRNG_END;
             (previous_frame+i)->code = DWT_DS_TWR_NRNG_END;
         }
+#if MYNEWT_VAL(MLAT_ENABLED)
+        mlat_fix_t fix;
+        mlat_solve(&g_mlat, ranges, nranges->resp_count, &fix);
+        printf("{\"utime\": %lu,\"mlat\": {\"x\": %ld,\"y\": %ld,\"z\": %ld,\"rms\": %ld,\"n\": %u,\"status\": %d}}\n",
+                os_cputime_ticks_to_usecs(os_cputime_get32()),
+                (int32_t)(fix.x * 1000), (int32_t)(fix.y * 1000), (int32_t)(fix.z * 1000), (int32_t)(fix.rms * 1000),
+                fix.nranges, fix.status);
+#endif
+#if !MYNEWT_VAL(LINKSTATS_ENABLED) || MYNEWT_VAL(LINKSTATS_RAW)
         printf("time-secs:: %lu\n", os_cputime_ticks_to_usecs(os_cputime_get32())/1000000);
+#endif
         rng->idx = 0xffff;
         nranges->resp_count = 0;
     }
+#if MYNEWT_VAL(LINKSTATS_ENABLED)
+    // Each ranged slot is one round, nodes that did not answer it count a miss
+    linkstats_round(&g_linkstats);
+#endif
 
 }
 
@@ -190,10 +310,6 @@ slot_timer_cb(struct os_event *ev){
  */
 static bool
 timeout_cb(struct _dw1000_dev_instance_t * inst) {
-    if(inst->fctrl != FCNTL_IEEE_RANGE_16){
-        return false;
-    }
-
     if (inst->status.rx_timeout_error){
         printf("{\"utime\": %lu,\"msg\": \"timeout_cb::rx_timeout_error\"}\n",os_cputime_ticks_to_usecs(os_cputime_get32()));
     }
@@ -220,9 +336,6 @@ timeout_cb(struct _dw1000_dev_instance_t * inst) {
  */
 static bool
 error_cb(struct _dw1000_dev_instance_t * inst) {
-    if(inst->fctrl != FCNTL_IEEE_RANGE_16){
-        return false;
-    }   
     uint32_t utime = os_cputime_ticks_to_usecs(os_cputime_get32());
     if (inst->status.start_rx_error)
         printf("{\"utime\": %lu,\"error_cb\": \"start_rx_error\"}\n",utime);
@@ -241,9 +354,6 @@ error_cb(struct _dw1000_dev_instance_t * inst) {
 
 static bool
 tx_complete_cb(dw1000_dev_instance_t* inst){
-    if(inst->fctrl != FCNTL_IEEE_RANGE_16){
-        return false;
-    }
     return true;
 }
 
@@ -266,9 +376,6 @@ tx_complete_cb(dw1000_dev_instance_t* inst){
 
 static bool 
 complete_cb(struct _dw1000_dev_instance_t * inst){
-    if(inst->fctrl != FCNTL_IEEE_RANGE_16){
-        return false;
-    }
     //os_callout_init(&slot_complete_callout, os_eventq_dflt_get(), slot_complete_cb, inst);
     //os_eventq_put(os_eventq_dflt_get(), &slot_complete_callout.c_ev);
     
@@ -282,6 +389,7 @@ complete_cb(struct _dw1000_dev_instance_t * inst){
 }
 
 #define SLOT MYNEWT_VAL(SLOT_ID)
+_Static_assert(SLOT >= 64 || !(MYNEWT_VAL(TDMA_DATA_SLOTS) & (1ULL << SLOT)), "SLOT_ID is one of the TDMA_DATA_SLOTS");
 #define ALT_SLOT 0
 int main(int argc, char **argv){
     int rc;
@@ -309,9 +417,13 @@ int main(int argc, char **argv){
     tdma_cbs.rx_timeout_cb = timeout_cb;
     tdma_cbs.rx_complete_cb = complete_cb;
     tdma_cbs.tx_complete_cb = tx_complete_cb;
-    tdma_cbs.id = DW1000_RANGE;
-    dw1000_add_extension_callbacks(inst, tdma_cbs);
+    rc = dispatch_register(inst, FCNTL_IEEE_RANGE_16, DISPATCH_CODE_ANY_LO, DISPATCH_CODE_ANY_HI, &tdma_cbs);
+    SYSINIT_PANIC_ASSERT(rc == 0);
 
+#if MYNEWT_VAL(UWBTIME_ENABLED)
+    uwbtime_init(&g_uwbtime, inst);
+    uwbtime_start(&g_uwbtime);
+#endif
 #if MYNEWT_VAL(DW1000_CCP_ENABLED)
     dw1000_ccp_init(inst, 2, MYNEWT_VAL(UUID_CCP_MASTER));
 #endif
@@ -326,6 +438,27 @@ int main(int argc, char **argv){
     nranges->nnodes= MYNEWT_VAL(N_NODES);
     dw1000_nranges_init(inst, nranges);
     printf("number of nodes  ===== %u \n",nranges->nnodes);
+#endif
+#if MYNEWT_VAL(MLAT_ENABLED)
+    mlat_init(&g_mlat, NULL, 0);
+    anchors_init(&g_anchors);
+    anchors_set_cb(&g_anchors, mlat_anchor_cb, &g_mlat);
+#endif
+#if MYNEWT_VAL(RATECTL_ENABLED)
+    ratectl_init(&g_ratectl);
+#endif
+#if MYNEWT_VAL(RNGFILTER_ENABLED)
+    rngfilter_init(&g_rngfilter);
+#endif
+#if MYNEWT_VAL(LINKSTATS_ENABLED)
+    linkstats_init(&g_linkstats);
+#endif
+#if MYNEWT_VAL(CAPTURE_ENABLED)
+    capture_config_t capture_config = {
+        .columns = CAPTURE_COL_TWR,
+        .block_nrecords = MYNEWT_VAL(CAPTURE_BLOCK_NRECORDS)
+    };
+    capture_init(&g_capture, &capture_config, g_capture_index, MYNEWT_VAL(CAPTURE_INDEX_SIZE), capture_console_sink, NULL);
 #endif
     printf("device_id = 0x%lX\n",inst->device_id);
     printf("PANID = 0x%X\n",inst->PANID);
@@ -47,6 +47,20 @@
 #if MYNEWT_VAL(DW1000_PAN)
 #include <dw1000/dw1000_pan.h>
 #endif
+#if MYNEWT_VAL(PANCACHE_ENABLED)
+#include <pancache/dw1000_pancache.h>
+static pancache_instance_t g_pancache;
+#endif
+#if MYNEWT_VAL(PANJOIN_ENABLED)
+#include <panjoin/dw1000_panjoin.h>
+static panjoin_instance_t g_panjoin;
+#if MYNEWT_VAL(PANCACHE_ENABLED)
+static void
+pancache_start_cb(pancache_instance_t * cache){
+    panjoin_start(&g_panjoin);
+}
+#endif
+#endif
 #if MYNEWT_VAL(DW1000_RANGE)
 #include <dw1000/dw1000_range.h>
 #endif
@@ -164,11 +178,25 @@ int main(int argc, char **argv){
 #endif
 #if MYNEWT_VAL(DW1000_PAN)
     dw1000_pan_init(inst, &pan_config);   
+#if MYNEWT_VAL(PANCACHE_ENABLED)
+    pancache_init(&g_pancache, inst);
+#if MYNEWT_VAL(PANJOIN_ENABLED)
+    panjoin_init(&g_panjoin, inst);
+    pancache_set_start(&g_pancache, pancache_start_cb);
+#endif
+    pancache_join(&g_pancache);
+#else
+#if MYNEWT_VAL(PANJOIN_ENABLED)
+    panjoin_init(&g_panjoin, inst);
+    panjoin_start(&g_panjoin);
+#else
     dw1000_pan_start(inst, DWT_NONBLOCKING);
+#endif
     while(inst->pan->status.valid != true){
         os_eventq_run(os_eventq_dflt_get());
         os_cputime_delay_usecs(5000);
     }
+#endif
 #endif
     dw1000_set_address16(inst, inst->my_short_address);
     dw1000_mac_framefilter(inst, DWT_FF_DATA_EN);
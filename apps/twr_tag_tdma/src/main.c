@@ -38,6 +38,7 @@
 #include <dw1000/dw1000_mac.h>
 #include <dw1000/dw1000_rng.h>
 #include <dw1000/dw1000_ftypes.h>
+#include <dispatch/dw1000_dispatch.h>
 #include <tdma/dw1000_tdma.h>
 #include <ccp/dw1000_ccp.h>
 
@@ -240,9 +241,6 @@ slot_complete_cb(struct os_event * ev){
  */
 static bool
 error_cb(struct _dw1000_dev_instance_t * inst) {
-    if(inst->fctrl != FCNTL_IEEE_RANGE_16){
-        return false;
-    }   
     uint32_t utime = os_cputime_ticks_to_usecs(os_cputime_get32());
     if (inst->status.start_rx_error)
         printf("{\"utime\": %lu,\"msg\": \"start_rx_error\",\"%s\":%d}\n",utime, __FILE__, __LINE__);
@@ -274,9 +272,6 @@ static struct os_callout slot_complete_callout;
 
 static bool 
 rx_complete_cb(struct _dw1000_dev_instance_t * inst){
-    if(inst->fctrl != FCNTL_IEEE_RANGE_16){
-        return false;
-    }
     os_callout_init(&slot_complete_callout, os_eventq_dflt_get(), slot_complete_cb, inst);
     os_eventq_put(os_eventq_dflt_get(), &slot_complete_callout.c_ev);
     return false;
@@ -307,7 +302,8 @@ int main(int argc, char **argv){
         .rx_error_cb = error_cb,
         .rx_complete_cb = rx_complete_cb
     };
-    dw1000_add_extension_callbacks(inst, cbs);
+    rc = dispatch_register(inst, FCNTL_IEEE_RANGE_16, DISPATCH_CODE_ANY_LO, DISPATCH_CODE_ANY_HI, &cbs);
+    SYSINIT_PANIC_ASSERT(rc == 0);
 
 #if MYNEWT_VAL(DW1000_CCP_ENABLED)
     dw1000_ccp_init(inst, 2, MYNEWT_VAL(UUID_CCP_MASTER));
@@ -332,8 +328,12 @@ int main(int argc, char **argv){
         g_slot[i] = i;
     tdma_init(inst, MYNEWT_VAL(TDMA_PERIOD), NSLOTS); 
     tdma_assign_slot(inst->tdma, slot0_timer_cb, g_slot[0], &g_slot[0]);
-    for (uint16_t i = 1; i < sizeof(g_slot)/sizeof(uint16_t); i++)
+    for (uint16_t i = 1; i < sizeof(g_slot)/sizeof(uint16_t); i++){
+        // Data slots of the lwip apps stay free
+        if (i < 64 && (MYNEWT_VAL(TDMA_DATA_SLOTS) & (1ULL << i)))
+            continue;
         tdma_assign_slot(inst->tdma, slot_timer_cb, g_slot[i], &g_slot[i]);
+    }
 
     while (1) {
         os_eventq_run(os_eventq_dflt_get());
@@ -0,0 +1,91 @@
+/**
+ * Copyright 2018, Decawave Limited, All Rights Reserved
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _DW1000_ANCHORS_H_
+#define _DW1000_ANCHORS_H_
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <os/os.h>
+#include "syscfg/syscfg.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Anchor positions in sys/config, one anchor/<address> entry per anchor
+ * holding "x,y,z" in mm, e.g. anchor/0x0001=0,0,2000. Entries are loaded at
+ * boot and applied through the callback the application installs with
+ * anchors_set_cb(), e.g. to mlat_anchor_set() or fusion_anchor_set(). They are set from the shell with
+ * the config command (CONFIG_CLI) and kept with "config save", or with
+ * anchors_set() which saves the entry at once.
+ */
+
+typedef int (*anchors_set_cb_t)(void * arg, uint16_t address, int32_t x, int32_t y, int32_t z);
+
+typedef struct _anchors_entry_t{
+    uint16_t address;
+    int32_t x, y, z;                // mm
+}anchors_entry_t;
+
+typedef struct _anchors_instance_t{
+    anchors_set_cb_t set_cb;
+    void * set_arg;
+    uint16_t nanchors;
+    uint16_t nrejected;             // Malformed entries or table full
+    anchors_entry_t anchors[MYNEWT_VAL(ANCHORS_N)];
+}anchors_instance_t;
+
+/**
+ * [anchors_init description]
+ * Register the anchor config handler and load the stored anchors, one instance per device.
+ * @param  anchors [Anchors instance]
+ * @return         [Anchors instance]
+ */
+anchors_instance_t * anchors_init(anchors_instance_t * anchors);
+
+/**
+ * [anchors_set_cb description]
+ * Apply the anchors loaded so far through set_cb, and every anchor set afterwards.
+ * @param  anchors [Anchors instance]
+ * @param  set_cb  [Called per anchor, e.g. a wrapper of mlat_anchor_set()]
+ * @param  set_arg [Its argument]
+ */
+void anchors_set_cb(anchors_instance_t * anchors, anchors_set_cb_t set_cb, void * set_arg);
+
+/**
+ * [anchors_set description]
+ * Add or move an anchor, apply it and save it to config.
+ * @param  anchors [Anchors instance]
+ * @param  address [Anchor short address]
+ * @param  x       [mm]
+ * @param  y       [mm]
+ * @param  z       [mm]
+ * @return         [0 on success, OS_ENOMEM when the table is full, otherwise the config rc]
+ */
+int anchors_set(anchors_instance_t * anchors, uint16_t address, int32_t x, int32_t y, int32_t z);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* _DW1000_ANCHORS_H_ */
@@ -0,0 +1,149 @@
+/*
+ * Copyright 2018, Decawave Limited, All Rights Reserved
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <os/os.h>
+#include "syscfg/syscfg.h"
+#include <config/config.h>
+
+#include <anchors/dw1000_anchors.h>
+
+static anchors_instance_t * g_anchors;
+
+static anchors_entry_t *
+anchors_find(anchors_instance_t * anchors, uint16_t address, bool add){
+    for (uint16_t i = 0; i < anchors->nanchors; i++)
+        if (anchors->anchors[i].address == address)
+            return &anchors->anchors[i];
+    if (!add || anchors->nanchors == MYNEWT_VAL(ANCHORS_N))
+        return NULL;
+    anchors_entry_t * entry = &anchors->anchors[anchors->nanchors++];
+    entry->address = address;
+    return entry;
+}
+
+static int
+anchors_apply(anchors_instance_t * anchors, uint16_t address, int32_t x, int32_t y, int32_t z){
+    anchors_entry_t * entry = anchors_find(anchors, address, true);
+    if (entry == NULL){
+        anchors->nrejected++;
+        return OS_ENOMEM;
+    }
+    entry->x = x;
+    entry->y = y;
+    entry->z = z;
+    if (anchors->set_cb)
+        anchors->set_cb(anchors->set_arg, address, x, y, z);
+    return 0;
+}
+
+static char *
+anchors_conf_get(int argc, char **argv, char *val, int val_len_max){
+    if (argc != 1 || g_anchors == NULL)
+        return NULL;
+    anchors_entry_t * entry = anchors_find(g_anchors, (uint16_t) strtoul(argv[0], NULL, 0), false);
+    if (entry == NULL)
+        return NULL;
+    snprintf(val, val_len_max, "%ld,%ld,%ld", (long) entry->x, (long) entry->y, (long) entry->z);
+    return val;
+}
+
+static int
+anchors_conf_set(int argc, char **argv, char *val){
+    char * end;
+    int32_t xyz[3];
+
+    if (argc != 1 || g_anchors == NULL)
+        return OS_ENOENT;
+    uint32_t address = strtoul(argv[0], &end, 0);
+    if (*end != '\0' || address > UINT16_MAX)
+        return OS_ENOENT;
+    if (val == NULL)
+        return OS_EINVAL;
+    for (int i = 0; i < 3; i++){
+        xyz[i] = strtol(val, &end, 0);
+        if (end == val || *end != (i < 2 ? ',' : '\0')){
+            g_anchors->nrejected++;
+            return OS_EINVAL;
+        }
+        val = end + 1;
+    }
+    return anchors_apply(g_anchors, address, xyz[0], xyz[1], xyz[2]);
+}
+
+static int
+anchors_conf_export(void (*export_func)(char *name, char *val), enum conf_export_tgt tgt){
+    char name[16], val[40];
+
+    for (uint16_t i = 0; i < g_anchors->nanchors; i++){
+        anchors_entry_t * entry = &g_anchors->anchors[i];
+        snprintf(name, sizeof(name), "anchor/0x%04X", entry->address);
+        snprintf(val, sizeof(val), "%ld,%ld,%ld", (long) entry->x, (long) entry->y, (long) entry->z);
+        export_func(name, val);
+    }
+    return 0;
+}
+
+static struct conf_handler anchors_conf_handler = {
+    .ch_name = "anchor",
+    .ch_get = anchors_conf_get,
+    .ch_set = anchors_conf_set,
+    .ch_export = anchors_conf_export
+};
+
+anchors_instance_t *
+anchors_init(anchors_instance_t * anchors){
+    assert(anchors);
+    assert(g_anchors == NULL || g_anchors == anchors);
+
+    memset(anchors, 0, sizeof(anchors_instance_t));
+    if (g_anchors == NULL){
+        g_anchors = anchors;
+        conf_register(&anchors_conf_handler);
+    }
+    conf_load();
+    printf("{\"utime\": %lu,\"anchors\": {\"n\": %u,\"rejected\": %u}}\n",
+            os_cputime_ticks_to_usecs(os_cputime_get32()), anchors->nanchors, anchors->nrejected);
+    return anchors;
+}
+
+void
+anchors_set_cb(anchors_instance_t * anchors, anchors_set_cb_t set_cb, void * set_arg){
+    anchors->set_cb = set_cb;
+    anchors->set_arg = set_arg;
+    for (uint16_t i = 0; set_cb && i < anchors->nanchors; i++){
+        anchors_entry_t * entry = &anchors->anchors[i];
+        set_cb(set_arg, entry->address, entry->x, entry->y, entry->z);
+    }
+}
+
+int
+anchors_set(anchors_instance_t * anchors, uint16_t address, int32_t x, int32_t y, int32_t z){
+    char name[16], val[40];
+
+    int rc = anchors_apply(anchors, address, x, y, z);
+    if (rc)
+        return rc;
+    snprintf(name, sizeof(name), "anchor/0x%04X", address);
+    snprintf(val, sizeof(val), "%ld,%ld,%ld", (long) x, (long) y, (long) z);
+    return conf_save_one(name, val);
+}
@@ -0,0 +1,303 @@
+/**
+ * Copyright 2018, Decawave Limited, All Rights Reserved
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _DW1000_CAPTURE_H_
+#define _DW1000_CAPTURE_H_
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stddef.h>
+#include "syscfg/syscfg.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Capture file layout (little endian, no implicit padding):
+ *
+ *   capture_file_header_t
+ *   block[0] ... block[nblocks-1]
+ *   capture_index_entry_t[nentries]    (optional)
+ *   capture_file_trailer_t             (optional)
+ *
+ * Each block is a capture_block_header_t followed by one column per bit set
+ * in the file column mask. Columns are stored in capture_column_t order, each
+ * holding nrecords values of the column width, so a reader can address any
+ * field of any record directly from a memory mapped file. The index and
+ * trailer are written when the capture is closed; a file without them
+ * (e.g. a stream cut short) is still readable by walking the block headers.
+ * When the blocks outnumber the index entries held in RAM the index is
+ * coarsened, pairs of entries are merged and each entry then covers stride
+ * consecutive blocks; a reader walks the block headers within an entry.
+ */
+
+#define CAPTURE_FILE_MAGIC      0x50435744UL    // "DWCP"
+#define CAPTURE_BLOCK_MAGIC     0x42435744UL    // "DWCB"
+#define CAPTURE_TRAILER_MAGIC   0x58435744UL    // "DWCX"
+#define CAPTURE_VERSION         2
+
+typedef enum _capture_column_t{
+    CAPTURE_COL_UTIME = 0,          // uint32_t, os_cputime in usec
+    CAPTURE_COL_REQUEST,            // uint32_t, request_timestamp
+    CAPTURE_COL_RESPONSE,           // uint32_t, response_timestamp
+    CAPTURE_COL_RECEPTION,          // uint32_t, reception_timestamp
+    CAPTURE_COL_TRANSMISSION,       // uint32_t, transmission_timestamp
+    CAPTURE_COL_SRC,                // uint16_t, src_address
+    CAPTURE_COL_DST,                // uint16_t, dst_address
+    CAPTURE_COL_CODE,               // uint16_t, frame code
+    CAPTURE_COL_RSSI,               // int16_t, dBm in Q8
+    CAPTURE_COL_FP_IDX,             // uint16_t, first path index
+    CAPTURE_COL_CIR,                // int16_t[2 * ncir], interleaved real/imag
+    CAPTURE_NCOLUMNS
+}capture_column_t;
+
+#define CAPTURE_COL(c) (1UL << (c))
+#define CAPTURE_COL_TWR (CAPTURE_COL(CAPTURE_COL_UTIME) | CAPTURE_COL(CAPTURE_COL_REQUEST) \
+                        | CAPTURE_COL(CAPTURE_COL_RESPONSE) | CAPTURE_COL(CAPTURE_COL_RECEPTION) \
+                        | CAPTURE_COL(CAPTURE_COL_TRANSMISSION) | CAPTURE_COL(CAPTURE_COL_SRC) \
+                        | CAPTURE_COL(CAPTURE_COL_DST) | CAPTURE_COL(CAPTURE_COL_CODE))
+
+typedef struct _capture_file_header_t{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t ncir;                  // Complex CIR samples per record
+    uint32_t columns;               // Bitmask of capture_column_t
+    uint16_t block_nrecords;        // Records per full block
+    uint16_t reserved;
+}__attribute__((__packed__)) capture_file_header_t;
+
+typedef struct _capture_block_header_t{
+    uint32_t magic;
+    uint32_t size;                  // Block size in bytes, header included
+    uint64_t utime_first;           // Unwrapped utime of the first record
+    uint64_t utime_last;            // Unwrapped utime of the last record
+    uint16_t nrecords;
+    uint16_t reserved;
+}__attribute__((__packed__)) capture_block_header_t;
+
+typedef struct _capture_index_entry_t{
+    uint64_t utime_first;
+    uint64_t utime_last;
+    uint32_t offset;                // Offset of the first block of the entry from the start of file
+    uint32_t nrecords;
+}__attribute__((__packed__)) capture_index_entry_t;
+
+typedef struct _capture_file_trailer_t{
+    uint32_t magic;
+    uint32_t nblocks;
+    uint32_t index_offset;
+    uint32_t nrecords;
+    uint32_t nentries;              // Index entries
+    uint32_t stride;                // Blocks per index entry, the last one may hold fewer
+}__attribute__((__packed__)) capture_file_trailer_t;
+
+/*
+ * One ranging record, as printed by the twr_node_tdma, twr_node_range and nranges apps.
+ */
+typedef struct _capture_record_t{
+    uint32_t utime;
+    uint16_t src_address;
+    uint16_t dst_address;
+    uint16_t code;
+    uint32_t request_timestamp;
+    uint32_t response_timestamp;
+    uint32_t reception_timestamp;
+    uint32_t transmission_timestamp;
+    int16_t rssi;                   // dBm in Q8
+    uint16_t fp_idx;
+    const int16_t * cir;            // 2 * ncir interleaved real/imag samples, or NULL
+}capture_record_t;
+
+typedef int capture_sink_fn(void * arg, const void * data, uint32_t len);
+
+typedef struct _capture_status_t{
+    uint16_t opened:1;
+    uint16_t sink_error:1;
+}capture_status_t;
+
+typedef struct _capture_config_t{
+    uint32_t columns;
+    uint16_t ncir;
+    uint16_t block_nrecords;
+}capture_config_t;
+
+typedef struct _capture_instance_t{
+    capture_status_t status;
+    capture_config_t config;
+    capture_sink_fn * sink;
+    void * sink_arg;
+    uint32_t offset;                // Bytes handed to the sink so far
+    uint32_t nrecords;              // Records in closed blocks
+    uint16_t idx;                   // Records in the current block
+    uint32_t nblocks;
+    uint16_t nindex;                // Index capacity, even
+    uint16_t nentries;              // Index entries in use
+    uint32_t stride;                // Blocks per index entry
+    capture_index_entry_t * index;
+    uint64_t utime_first;           // Unwrapped utime of the first record in the current block
+    uint64_t utime_prev;            // Unwrapped utime of the last appended record
+    uint32_t utime[MYNEWT_VAL(CAPTURE_BLOCK_NRECORDS)];
+    uint32_t request[MYNEWT_VAL(CAPTURE_BLOCK_NRECORDS)];
+    uint32_t response[MYNEWT_VAL(CAPTURE_BLOCK_NRECORDS)];
+    uint32_t reception[MYNEWT_VAL(CAPTURE_BLOCK_NRECORDS)];
+    uint32_t transmission[MYNEWT_VAL(CAPTURE_BLOCK_NRECORDS)];
+    uint16_t src[MYNEWT_VAL(CAPTURE_BLOCK_NRECORDS)];
+    uint16_t dst[MYNEWT_VAL(CAPTURE_BLOCK_NRECORDS)];
+    uint16_t code[MYNEWT_VAL(CAPTURE_BLOCK_NRECORDS)];
+    int16_t rssi[MYNEWT_VAL(CAPTURE_BLOCK_NRECORDS)];
+    uint16_t fp_idx[MYNEWT_VAL(CAPTURE_BLOCK_NRECORDS)];
+#if MYNEWT_VAL(CAPTURE_CIR_SIZE) > 0
+    int16_t cir[MYNEWT_VAL(CAPTURE_BLOCK_NRECORDS)][2 * MYNEWT_VAL(CAPTURE_CIR_SIZE)];
+#endif
+}capture_instance_t;
+
+/*
+ * Read side view of a memory mapped capture.
+ */
+typedef struct _capture_reader_t{
+    const uint8_t * base;
+    size_t len;
+    const capture_file_header_t * header;
+    const capture_index_entry_t * index;    // NULL if the file has no trailer
+    uint32_t nentries;
+    uint32_t stride;
+    uint32_t nblocks;
+    uint32_t nrecords;
+    uint32_t cursor;                // Last block resolved, speeds up block walks
+    uint32_t cursor_offset;
+}capture_reader_t;
+
+typedef struct _capture_block_t{
+    const capture_block_header_t * header;
+    uint16_t nrecords;
+    uint16_t ncir;
+    const uint32_t * utime;
+    const uint32_t * request;
+    const uint32_t * response;
+    const uint32_t * reception;
+    const uint32_t * transmission;
+    const uint16_t * src;
+    const uint16_t * dst;
+    const uint16_t * code;
+    const int16_t * rssi;
+    const uint16_t * fp_idx;
+    const int16_t * cir;
+}capture_block_t;
+
+/**
+ * [capture_init description]
+ * Initialise a capture and write the file header to the sink.
+ * @param  capture [Capture instance]
+ * @param  config  [Columns, CIR length and block size]
+ * @param  index   [Storage for the time index, may be NULL]
+ * @param  nindex  [Number of index entries, rounded down to even. Beyond nindex blocks entries are merged pairwise]
+ * @param  sink    [Byte sink, called in file order]
+ * @param  arg     [Sink argument]
+ * @return         [0 on success]
+ */
+int capture_init(capture_instance_t * capture, const capture_config_t * config,
+        capture_index_entry_t index[], uint16_t nindex, capture_sink_fn * sink, void * arg);
+
+/**
+ * [capture_append description]
+ * Append a record, flushing the current block to the sink when full.
+ * @param  capture [Capture instance]
+ * @param  record  [Record]
+ * @return         [0 on success]
+ */
+int capture_append(capture_instance_t * capture, const capture_record_t * record);
+
+/**
+ * [capture_flush description]
+ * Write out the current, possibly partial, block.
+ * @param  capture [Capture instance]
+ * @return         [0 on success]
+ */
+int capture_flush(capture_instance_t * capture);
+
+/**
+ * [capture_close description]
+ * Flush and write the time index and trailer.
+ * @param  capture [Capture instance]
+ * @return         [0 on success]
+ */
+int capture_close(capture_instance_t * capture);
+
+/**
+ * [capture_rotate description]
+ * Close the capture and open the next one on the same sink with the same config,
+ * bounding the session length. Consecutive files are split on their header by
+ * apps/matlab/capture_from_log.m.
+ * @param  capture [Capture instance]
+ * @return         [0 on success]
+ */
+int capture_rotate(capture_instance_t * capture);
+
+/**
+ * [capture_console_sink description]
+ * Sink emitting base64 encoded chunks as {"capture":"..."} console lines.
+ * Concatenating the decoded chunks in order yields the capture file.
+ */
+int capture_console_sink(void * arg, const void * data, uint32_t len);
+
+/**
+ * [capture_column_width description]
+ * Width in bytes of one value of a column.
+ */
+uint32_t capture_column_width(capture_column_t column, uint16_t ncir);
+
+/**
+ * [capture_reader_open description]
+ * Attach a reader to a capture held in memory, typically an mmap of the file.
+ * @param  reader [Reader]
+ * @param  base   [Start of the capture]
+ * @param  len    [Length in bytes]
+ * @return        [0 on success, -1 if the buffer is not a capture]
+ */
+int capture_reader_open(capture_reader_t * reader, const void * base, size_t len);
+
+/**
+ * [capture_reader_block description]
+ * Resolve the column pointers of block n.
+ * @return        [0 on success, -1 if n is out of range or the block is corrupt]
+ */
+int capture_reader_block(capture_reader_t * reader, uint32_t n, capture_block_t * block);
+
+/**
+ * [capture_reader_seek description]
+ * Find the first block that may contain records at or after utime.
+ * Binary search on the index, block walk when the file has none.
+ * @param  utime  [Unwrapped utime in usec]
+ * @return        [Block number, nblocks if utime is past the end]
+ */
+uint32_t capture_reader_seek(capture_reader_t * reader, uint64_t utime);
+
+/**
+ * [capture_block_utime description]
+ * Unwrapped utime of record i within a block.
+ */
+uint64_t capture_block_utime(const capture_block_t * block, uint16_t i);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* _DW1000_CAPTURE_H_ */
@@ -0,0 +1,445 @@
+/*
+ * Copyright 2018, Decawave Limited, All Rights Reserved
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include "syscfg/syscfg.h"
+
+#include <capture/dw1000_capture.h>
+#if MYNEWT_VAL(CAPTURE_CONSOLE_SINK)
+#include <base64/base64.h>
+#endif
+
+#define CAPTURE_PAD(n) (((n) + 3) & ~3UL)
+
+static int
+capture_write(capture_instance_t * capture, const void * data, uint32_t len){
+
+    if (len == 0 || capture->status.sink_error)
+        return capture->status.sink_error ? -1 : 0;
+    if (capture->sink(capture->sink_arg, data, len) != 0){
+        capture->status.sink_error = 1;
+        return -1;
+    }
+    capture->offset += len;
+    return 0;
+}
+
+uint32_t
+capture_column_width(capture_column_t column, uint16_t ncir){
+
+    switch(column){
+        case CAPTURE_COL_UTIME ... CAPTURE_COL_TRANSMISSION:
+            return sizeof(uint32_t);
+        case CAPTURE_COL_SRC ... CAPTURE_COL_FP_IDX:
+            return sizeof(uint16_t);
+        case CAPTURE_COL_CIR:
+            return 2 * sizeof(int16_t) * ncir;
+        default:
+            return 0;
+    }
+}
+
+static uint32_t
+capture_block_size(uint32_t columns, uint16_t ncir, uint16_t nrecords){
+
+    uint32_t size = sizeof(capture_block_header_t);
+    for (uint16_t c = 0; c < CAPTURE_NCOLUMNS; c++)
+        if (columns & CAPTURE_COL(c))
+            size += capture_column_width(c, ncir) * nrecords;
+    return CAPTURE_PAD(size);
+}
+
+int
+capture_init(capture_instance_t * capture, const capture_config_t * config,
+        capture_index_entry_t index[], uint16_t nindex, capture_sink_fn * sink, void * arg){
+
+    assert(capture);
+    assert(config);
+    assert(sink);
+    assert(config->block_nrecords > 0 && config->block_nrecords <= MYNEWT_VAL(CAPTURE_BLOCK_NRECORDS));
+    assert(!(config->columns & CAPTURE_COL(CAPTURE_COL_CIR)) || config->ncir <= MYNEWT_VAL(CAPTURE_CIR_SIZE));
+
+    memset(capture, 0, sizeof(capture_instance_t));
+    capture->config = *config;
+    if (!(config->columns & CAPTURE_COL(CAPTURE_COL_CIR)))
+        capture->config.ncir = 0;
+    capture->sink = sink;
+    capture->sink_arg = arg;
+    capture->index = index;
+    capture->nindex = (index == NULL || nindex < 2) ? 0 : nindex & ~1;
+    capture->stride = 1;
+
+    capture_file_header_t header = {
+        .magic = CAPTURE_FILE_MAGIC,
+        .version = CAPTURE_VERSION,
+        .ncir = capture->config.ncir,
+        .columns = capture->config.columns,
+        .block_nrecords = capture->config.block_nrecords
+    };
+    capture->status.opened = 1;
+    return capture_write(capture, &header, sizeof(header));
+}
+
+int
+capture_append(capture_instance_t * capture, const capture_record_t * record){
+
+    assert(capture);
+    assert(record);
+    if (!capture->status.opened)
+        return -1;
+
+    // The console utime is a 32-bit usec counter, keep a wrap free copy for the index
+    uint64_t utime = record->utime;
+    if (capture->nblocks || capture->idx){
+        uint64_t hi = capture->utime_prev & ~0xFFFFFFFFULL;
+        if (record->utime < (uint32_t)capture->utime_prev)
+            hi += 0x100000000ULL;
+        utime |= hi;
+    }
+    uint16_t idx = capture->idx;
+    if (idx == 0)
+        capture->utime_first = utime;
+    capture->utime_prev = utime;
+
+    capture->utime[idx] = record->utime;
+    capture->request[idx] = record->request_timestamp;
+    capture->response[idx] = record->response_timestamp;
+    capture->reception[idx] = record->reception_timestamp;
+    capture->transmission[idx] = record->transmission_timestamp;
+    capture->src[idx] = record->src_address;
+    capture->dst[idx] = record->dst_address;
+    capture->code[idx] = record->code;
+    capture->rssi[idx] = record->rssi;
+    capture->fp_idx[idx] = record->fp_idx;
+#if MYNEWT_VAL(CAPTURE_CIR_SIZE) > 0
+    if (capture->config.ncir){
+        if (record->cir)
+            memcpy(capture->cir[idx], record->cir, 2 * sizeof(int16_t) * capture->config.ncir);
+        else
+            memset(capture->cir[idx], 0, 2 * sizeof(int16_t) * capture->config.ncir);
+    }
+#endif
+    capture->idx++;
+
+    if (capture->idx == capture->config.block_nrecords)
+        return capture_flush(capture);
+    return 0;
+}
+
+int
+capture_flush(capture_instance_t * capture){
+
+    assert(capture);
+    uint16_t n = capture->idx;
+    if (n == 0)
+        return 0;
+
+    uint32_t columns = capture->config.columns;
+    uint16_t ncir = capture->config.ncir;
+    uint32_t offset = capture->offset;
+    capture_block_header_t header = {
+        .magic = CAPTURE_BLOCK_MAGIC,
+        .size = capture_block_size(columns, ncir, n),
+        .utime_first = capture->utime_first,
+        .utime_last = capture->utime_prev,
+        .nrecords = n
+    };
+    const void * column[CAPTURE_NCOLUMNS] = {
+        [CAPTURE_COL_UTIME] = capture->utime,
+        [CAPTURE_COL_REQUEST] = capture->request,
+        [CAPTURE_COL_RESPONSE] = capture->response,
+        [CAPTURE_COL_RECEPTION] = capture->reception,
+        [CAPTURE_COL_TRANSMISSION] = capture->transmission,
+        [CAPTURE_COL_SRC] = capture->src,
+        [CAPTURE_COL_DST] = capture->dst,
+        [CAPTURE_COL_CODE] = capture->code,
+        [CAPTURE_COL_RSSI] = capture->rssi,
+        [CAPTURE_COL_FP_IDX] = capture->fp_idx
+    };
+
+    int rc = capture_write(capture, &header, sizeof(header));
+    for (uint16_t c = 0; c < CAPTURE_COL_CIR; c++)
+        if (columns & CAPTURE_COL(c))
+            rc |= capture_write(capture, column[c], capture_column_width(c, ncir) * n);
+#if MYNEWT_VAL(CAPTURE_CIR_SIZE) > 0
+    if (columns & CAPTURE_COL(CAPTURE_COL_CIR)){
+        if (ncir == MYNEWT_VAL(CAPTURE_CIR_SIZE))
+            rc |= capture_write(capture, capture->cir, capture_column_width(CAPTURE_COL_CIR, ncir) * n);
+        else
+            for (uint16_t i = 0; i < n; i++)
+                rc |= capture_write(capture, capture->cir[i], capture_column_width(CAPTURE_COL_CIR, ncir));
+    }
+#endif
+    static const uint8_t pad[4] = {0};
+    rc |= capture_write(capture, pad, header.size - (capture->offset - offset));
+
+    if (capture->nindex){
+        if (capture->nblocks % capture->stride == 0 && capture->nentries == capture->nindex){
+            // Index full, merge entry pairs and double the blocks per entry
+            for (uint16_t i = 0; i < capture->nindex / 2; i++){
+                capture_index_entry_t * a = &capture->index[2 * i];
+                capture_index_entry_t * b = &capture->index[2 * i + 1];
+                capture->index[i] = (capture_index_entry_t){
+                    .utime_first = a->utime_first,
+                    .utime_last = b->utime_last,
+                    .offset = a->offset,
+                    .nrecords = a->nrecords + b->nrecords
+                };
+            }
+            capture->nentries = capture->nindex / 2;
+            capture->stride *= 2;
+        }
+        if (capture->nblocks % capture->stride == 0){
+            capture->index[capture->nentries++] = (capture_index_entry_t){
+                .utime_first = header.utime_first,
+                .utime_last = header.utime_last,
+                .offset = offset,
+                .nrecords = n
+            };
+        }else{
+            capture_index_entry_t * entry = &capture->index[capture->nentries - 1];
+            entry->utime_last = header.utime_last;
+            entry->nrecords += n;
+        }
+    }
+
+    capture->nblocks++;
+    capture->nrecords += n;
+    capture->idx = 0;
+    return rc;
+}
+
+int
+capture_close(capture_instance_t * capture){
+
+    assert(capture);
+    if (!capture->status.opened)
+        return -1;
+
+    int rc = capture_flush(capture);
+    if (capture->nindex){
+        capture_file_trailer_t trailer = {
+            .magic = CAPTURE_TRAILER_MAGIC,
+            .nblocks = capture->nblocks,
+            .index_offset = capture->offset,
+            .nrecords = capture->nrecords,
+            .nentries = capture->nentries,
+            .stride = capture->stride
+        };
+        rc |= capture_write(capture, capture->index, capture->nentries * sizeof(capture_index_entry_t));
+        rc |= capture_write(capture, &trailer, sizeof(trailer));
+    }
+    capture->status.opened = 0;
+    return rc;
+}
+
+int
+capture_rotate(capture_instance_t * capture){
+
+    assert(capture);
+    capture_config_t config = capture->config;
+    int rc = capture_close(capture);
+    rc |= capture_init(capture, &config, capture->index, capture->nindex, capture->sink, capture->sink_arg);
+    return rc;
+}
+
+#if MYNEWT_VAL(CAPTURE_CONSOLE_SINK)
+#define CAPTURE_CHUNK_SIZE (96)
+
+int
+capture_console_sink(void * arg, const void * data, uint32_t len){
+
+    char str[BASE64_ENCODE_SIZE(CAPTURE_CHUNK_SIZE) + 1];
+    const uint8_t * ptr = (const uint8_t *) data;
+
+    while (len){
+        uint32_t n = (len > CAPTURE_CHUNK_SIZE) ? CAPTURE_CHUNK_SIZE : len;
+        int rc = base64_encode(ptr, n, str, 1);
+        str[rc] = '\0';
+        printf("{\"capture\":\"%s\"}\n", str);
+        ptr += n;
+        len -= n;
+    }
+    return 0;
+}
+#endif
+
+static const capture_block_header_t *
+capture_reader_block_header(const capture_reader_t * reader, uint32_t offset){
+
+    if (offset + sizeof(capture_block_header_t) > reader->len)
+        return NULL;
+    const capture_block_header_t * header = (const capture_block_header_t *)(reader->base + offset);
+    if (header->magic != CAPTURE_BLOCK_MAGIC || header->size < sizeof(capture_block_header_t)
+            || offset + header->size > reader->len)
+        return NULL;
+    return header;
+}
+
+int
+capture_reader_open(capture_reader_t * reader, const void * base, size_t len){
+
+    assert(reader);
+    memset(reader, 0, sizeof(capture_reader_t));
+    if (base == NULL || len < sizeof(capture_file_header_t))
+        return -1;
+
+    reader->base = (const uint8_t *) base;
+    reader->len = len;
+    reader->header = (const capture_file_header_t *) base;
+    if (reader->header->magic != CAPTURE_FILE_MAGIC || reader->header->version != CAPTURE_VERSION)
+        return -1;
+    reader->cursor_offset = sizeof(capture_file_header_t);
+
+    if (len >= sizeof(capture_file_header_t) + sizeof(capture_file_trailer_t)){
+        const capture_file_trailer_t * trailer = (const capture_file_trailer_t *)
+                (reader->base + len - sizeof(capture_file_trailer_t));
+        if (trailer->magic == CAPTURE_TRAILER_MAGIC && trailer->stride > 0
+                && (uint64_t)trailer->nentries * trailer->stride >= trailer->nblocks
+                && (uint64_t)trailer->index_offset + (uint64_t)trailer->nentries * sizeof(capture_index_entry_t)
+                    + sizeof(capture_file_trailer_t) == len){
+            reader->index = (const capture_index_entry_t *)(reader->base + trailer->index_offset);
+            reader->nentries = trailer->nentries;
+            reader->stride = trailer->stride;
+            reader->nblocks = trailer->nblocks;
+            reader->nrecords = trailer->nrecords;
+            return 0;
+        }
+    }
+
+    // No index, count the blocks that made it to the file
+    const capture_block_header_t * header;
+    uint32_t offset = sizeof(capture_file_header_t);
+    while ((header = capture_reader_block_header(reader, offset)) != NULL){
+        reader->nblocks++;
+        reader->nrecords += header->nrecords;
+        offset += header->size;
+    }
+    return 0;
+}
+
+static uint32_t
+capture_reader_offset(capture_reader_t * reader, uint32_t n){
+
+    if (reader->index){
+        uint32_t entry = n / reader->stride;
+        if (n < reader->cursor || reader->cursor / reader->stride != entry){
+            reader->cursor = entry * reader->stride;
+            reader->cursor_offset = reader->index[entry].offset;
+        }
+    }else if (n < reader->cursor){
+        reader->cursor = 0;
+        reader->cursor_offset = sizeof(capture_file_header_t);
+    }
+    while (reader->cursor < n){
+        const capture_block_header_t * header = capture_reader_block_header(reader, reader->cursor_offset);
+        assert(header);
+        reader->cursor_offset += header->size;
+        reader->cursor++;
+    }
+    return reader->cursor_offset;
+}
+
+int
+capture_reader_block(capture_reader_t * reader, uint32_t n, capture_block_t * block){
+
+    assert(reader);
+    assert(block);
+    if (n >= reader->nblocks)
+        return -1;
+
+    const capture_block_header_t * header = capture_reader_block_header(reader, capture_reader_offset(reader, n));
+    if (header == NULL)
+        return -1;
+
+    uint32_t columns = reader->header->columns;
+    uint16_t ncir = reader->header->ncir;
+    if (capture_block_size(columns, ncir, header->nrecords) != header->size)
+        return -1;
+
+    memset(block, 0, sizeof(capture_block_t));
+    block->header = header;
+    block->nrecords = header->nrecords;
+    block->ncir = ncir;
+
+    const void ** column[CAPTURE_NCOLUMNS] = {
+        [CAPTURE_COL_UTIME] = (const void **) &block->utime,
+        [CAPTURE_COL_REQUEST] = (const void **) &block->request,
+        [CAPTURE_COL_RESPONSE] = (const void **) &block->response,
+        [CAPTURE_COL_RECEPTION] = (const void **) &block->reception,
+        [CAPTURE_COL_TRANSMISSION] = (const void **) &block->transmission,
+        [CAPTURE_COL_SRC] = (const void **) &block->src,
+        [CAPTURE_COL_DST] = (const void **) &block->dst,
+        [CAPTURE_COL_CODE] = (const void **) &block->code,
+        [CAPTURE_COL_RSSI] = (const void **) &block->rssi,
+        [CAPTURE_COL_FP_IDX] = (const void **) &block->fp_idx,
+        [CAPTURE_COL_CIR] = (const void **) &block->cir
+    };
+    const uint8_t * ptr = (const uint8_t *)(header + 1);
+    for (uint16_t c = 0; c < CAPTURE_NCOLUMNS; c++)
+        if (columns & CAPTURE_COL(c)){
+            *column[c] = ptr;
+            ptr += capture_column_width(c, ncir) * header->nrecords;
+        }
+    return 0;
+}
+
+uint32_t
+capture_reader_seek(capture_reader_t * reader, uint64_t utime){
+
+    assert(reader);
+    uint32_t n = 0;
+    if (reader->index){
+        uint32_t lo = 0, hi = reader->nentries;
+        while (lo < hi){
+            uint32_t mid = lo + (hi - lo) / 2;
+            if (reader->index[mid].utime_last < utime)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+        if (lo == reader->nentries)
+            return reader->nblocks;
+        if (reader->stride == 1)
+            return lo;
+        n = lo * reader->stride;
+    }
+
+    for (; n < reader->nblocks; n++){
+        const capture_block_header_t * header = capture_reader_block_header(reader, capture_reader_offset(reader, n));
+        if (header == NULL || header->utime_last >= utime)
+            break;
+    }
+    return n;
+}
+
+uint64_t
+capture_block_utime(const capture_block_t * block, uint16_t i){
+
+    assert(block);
+    assert(block->utime);
+    uint64_t first = block->header->utime_first;
+    uint64_t hi = first & ~0xFFFFFFFFULL;
+    if (block->utime[i] < (uint32_t) first)
+        hi += 0x100000000ULL;
+    return hi | block->utime[i];
+}
@@ -0,0 +1,123 @@
+/**
+ * Copyright 2018, Decawave Limited, All Rights Reserved
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _DW1000_DISCOVERY_H_
+#define _DW1000_DISCOVERY_H_
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <os/os.h>
+#include "syscfg/syscfg.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <dw1000/dw1000_dev.h>
+#include <discovery_table/dw1000_discovery_table.h>
+
+/*
+ * Node discovery. The requester broadcasts a discovery request carrying a
+ * response window of nslots slots and a per round seed; every node answers
+ * once in the slot given by discovery_slot(), so all nodes are heard in one
+ * window but for the collisions, and colliding nodes are likely to land in
+ * different slots in the next round. The window is sized on the nodes known
+ * and the collisions of the last round, see discovery_nslots(). The node
+ * table and the window sizing are in lib/discovery_table.
+ */
+
+#define FCNTL_IEEE_DISCOVERY_16 0x8843  // MAC command frame, PAN ID compressed, 16-bit addressing
+
+typedef enum _discovery_code_t{
+    DISCOVERY_CODE_REQUEST = 1,
+    DISCOVERY_CODE_RESPONSE
+}discovery_code_t;
+
+typedef struct _discovery_request_frame_t{
+    uint16_t fctrl;
+    uint8_t seq_num;
+    uint16_t PANID;
+    uint16_t dst_address;           // 0xFFFF
+    uint16_t src_address;
+    uint16_t code;                  // DISCOVERY_CODE_REQUEST
+    uint16_t nslots;
+    uint16_t slot_usec;
+    uint32_t seed;
+}__attribute__((__packed__)) discovery_request_frame_t;
+
+typedef struct _discovery_response_frame_t{
+    uint16_t fctrl;
+    uint8_t seq_num;
+    uint16_t PANID;
+    uint16_t dst_address;
+    uint16_t src_address;
+    uint16_t code;                  // DISCOVERY_CODE_RESPONSE
+    uint8_t dev_type;
+    uint8_t slot_id;
+}__attribute__((__packed__)) discovery_response_frame_t;
+
+typedef struct _discovery_status_t{
+    uint16_t active:1;              // Response window open
+    uint16_t complete:1;            // A round found nothing new
+}discovery_status_t;
+
+typedef struct _discovery_instance_t{
+    struct _dw1000_dev_instance_t * parent;
+    discovery_status_t status;
+    discovery_table_t table;
+    uint32_t seed;
+    uint16_t round;
+    uint16_t nslots;
+    uint16_t nresponses;
+    uint16_t ncollisions;
+    uint32_t utime_start;           // First round, usec
+    struct os_callout callout;      // Window end
+    struct os_event postprocess_ev;
+}discovery_instance_t;
+
+/**
+ * [discovery_init description]
+ * Register the request and response handlers with lib/dispatch, a node
+ * answers requests from then on.
+ * @param  discovery [Discovery instance]
+ * @param  inst      [dw1000 instance]
+ * @return           [Discovery instance]
+ */
+discovery_instance_t * discovery_init(discovery_instance_t * discovery, struct _dw1000_dev_instance_t * inst);
+
+/**
+ * [discovery_set_postprocess description]
+ * Event posted to the default eventq when a round closes, ev_arg is the discovery instance.
+ */
+void discovery_set_postprocess(discovery_instance_t * discovery, os_event_fn * postprocess);
+
+/**
+ * [discovery_start description]
+ * Broadcast a request and collect the responses of one round. Does not block.
+ * @param  discovery [Discovery instance]
+ */
+void discovery_start(discovery_instance_t * discovery);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* _DW1000_DISCOVERY_H_ */
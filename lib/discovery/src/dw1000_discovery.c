@@ -0,0 +1,220 @@
+/*
+ * Copyright 2018, Decawave Limited, All Rights Reserved
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <stddef.h>
+#include <assert.h>
+#include <os/os.h>
+#include <os/os_cputime.h>
+#include "syscfg/syscfg.h"
+#include "sysinit/sysinit.h"
+
+#include <dw1000/dw1000_dev.h>
+#include <dw1000/dw1000_hal.h>
+#include <dw1000/dw1000_mac.h>
+#include <dw1000/dw1000_phy.h>
+#include <dispatch/dw1000_dispatch.h>
+#include <discovery/dw1000_discovery.h>
+
+static discovery_instance_t * g_discovery;
+
+/*
+ * Schedule the response to a request, false if there is none to send and the
+ * receiver is left off.
+ */
+static bool
+discovery_respond(dw1000_dev_instance_t * inst){
+    discovery_request_frame_t request;
+
+    if (inst->frame_len < sizeof(discovery_request_frame_t))
+        return false;
+    dw1000_read_rx(inst, (uint8_t *) &request, 0, sizeof(discovery_request_frame_t));
+    if (request.src_address == inst->my_short_address || request.nslots == 0)
+        return false;
+
+    uint64_t request_timestamp = dw1000_read_rxtime(inst);
+    uint16_t slot = discovery_slot(inst->my_short_address, request.seed, request.nslots);
+    uint64_t response_tx_delay = request_timestamp
+            + (((uint64_t) MYNEWT_VAL(DISCOVERY_HOLDOFF_USEC) + (uint64_t) slot * request.slot_usec) << 16);
+    discovery_response_frame_t response = {
+        .fctrl = FCNTL_IEEE_DISCOVERY_16,
+        .seq_num = request.seq_num,
+        .PANID = inst->PANID,
+        .dst_address = request.src_address,
+        .src_address = inst->my_short_address,
+        .code = DISCOVERY_CODE_RESPONSE,
+        .dev_type = inst->dev_type,
+        .slot_id = inst->slot_id
+    };
+
+    dw1000_write_tx(inst, (uint8_t *) &response, 0, sizeof(discovery_response_frame_t));
+    dw1000_write_tx_fctrl(inst, sizeof(discovery_response_frame_t), 0, true);
+    dw1000_set_wait4resp(inst, true);
+    dw1000_set_delay_start(inst, response_tx_delay);
+    dw1000_set_rx_timeout(inst, 0);
+    dw1000_start_tx(inst);
+    return true;
+}
+
+static bool
+discovery_rx_complete_cb(dw1000_dev_instance_t * inst){
+    discovery_instance_t * discovery = g_discovery;
+    uint16_t code;
+
+    if (inst->frame_len < offsetof(discovery_request_frame_t, code) + sizeof(uint16_t))
+        return false;
+    dw1000_read_rx(inst, (uint8_t *) &code, offsetof(discovery_request_frame_t, code), sizeof(uint16_t));
+
+    if (code == DISCOVERY_CODE_REQUEST){
+        // A requester with its own window open stays listening, as does a node with nothing to answer
+        if (discovery->status.active || !discovery_respond(inst)){
+            dw1000_set_rx_timeout(inst, 0);
+            dw1000_start_rx(inst);
+        }
+        return true;
+    }
+    if (code != DISCOVERY_CODE_RESPONSE)
+        return false;
+
+    if (discovery->status.active && inst->frame_len >= sizeof(discovery_response_frame_t)){
+        discovery_response_frame_t response;
+        dw1000_read_rx(inst, (uint8_t *) &response, 0, sizeof(discovery_response_frame_t));
+        if (response.dst_address == inst->my_short_address){
+            discovery->nresponses++;
+            discovery_table_heard(&discovery->table, response.src_address);
+        }
+    }
+    dw1000_set_rx_timeout(inst, 0);
+    dw1000_start_rx(inst);
+    return true;
+}
+
+/*
+ * A corrupted frame in the window is taken as colliding responses.
+ */
+static bool
+discovery_rx_error_cb(dw1000_dev_instance_t * inst){
+    discovery_instance_t * discovery = g_discovery;
+
+    if (!discovery->status.active)
+        return false;
+    discovery->ncollisions++;
+    dw1000_set_rx_timeout(inst, 0);
+    dw1000_start_rx(inst);
+    return false;
+}
+
+static void
+discovery_window_cb(struct os_event * ev){
+    discovery_instance_t * discovery = (discovery_instance_t *) ev->ev_arg;
+    discovery_table_t * table = &discovery->table;
+    uint32_t utime = os_cputime_ticks_to_usecs(os_cputime_get32());
+
+    discovery->status.active = 0;
+    discovery_table_round(table);
+    printf("{\"utime\": %lu,\"discovery\": {\"round\": %u,\"nslots\": %u,\"responses\": %u,\"collisions\": %u,"
+            "\"nnodes\": %u,\"new\": %u,\"dropped\": %u}}\n",
+            utime, discovery->round, discovery->nslots, discovery->nresponses, discovery->ncollisions,
+            table->nnodes, table->nnew, table->ndropped);
+
+    if (table->nnew || table->ndropped || discovery->ncollisions)
+        discovery->status.complete = 0;
+    else if (!discovery->status.complete){
+        discovery->status.complete = 1;
+        printf("{\"utime\": %lu,\"discovery\": {\"complete_usec\": %lu,\"nnodes\": %u,\"rounds\": %u}}\n",
+                utime, utime - discovery->utime_start, table->nnodes, discovery->round);
+    }
+    if (discovery->postprocess_ev.ev_cb)
+        os_eventq_put(os_eventq_dflt_get(), &discovery->postprocess_ev);
+}
+
+discovery_instance_t *
+discovery_init(discovery_instance_t * discovery, dw1000_dev_instance_t * inst){
+    assert(discovery);
+    assert(inst);
+    assert(g_discovery == NULL);
+
+    memset(discovery, 0, sizeof(discovery_instance_t));
+    discovery->parent = inst;
+    discovery->seed = (uint32_t)(inst->my_long_address ^ (inst->my_long_address >> 32)) ^ os_cputime_get32();
+    if (discovery->seed == 0)
+        discovery->seed = 1;
+    discovery->postprocess_ev.ev_arg = discovery;
+    os_callout_init(&discovery->callout, os_eventq_dflt_get(), discovery_window_cb, discovery);
+    g_discovery = discovery;
+
+    dw1000_extension_callbacks_t rx_cbs = {
+        .rx_complete_cb = discovery_rx_complete_cb
+    };
+    int rc = dispatch_register(inst, FCNTL_IEEE_DISCOVERY_16, DISPATCH_CODE_ANY_LO, DISPATCH_CODE_ANY_HI, &rx_cbs);
+    SYSINIT_PANIC_ASSERT(rc == 0);
+    dw1000_extension_callbacks_t cbs = {
+        .id = MYNEWT_VAL(DISCOVERY_EXTENSION_ID),
+        .rx_error_cb = discovery_rx_error_cb
+    };
+    dw1000_add_extension_callbacks(inst, cbs);
+    return discovery;
+}
+
+void
+discovery_set_postprocess(discovery_instance_t * discovery, os_event_fn * postprocess){
+    discovery->postprocess_ev.ev_cb = postprocess;
+}
+
+void
+discovery_start(discovery_instance_t * discovery){
+    static uint8_t seq_num;
+    dw1000_dev_instance_t * inst = discovery->parent;
+
+    if (discovery->status.active)
+        return;
+    if (discovery->round++ == 0)
+        discovery->utime_start = os_cputime_ticks_to_usecs(os_cputime_get32());
+    discovery->seed ^= discovery->seed << 13;
+    discovery->seed ^= discovery->seed >> 17;
+    discovery->seed ^= discovery->seed << 5;
+    discovery->nslots = discovery_nslots(discovery->table.nnodes, discovery->nresponses, discovery->ncollisions, discovery->nslots);
+    discovery->nresponses = 0;
+    discovery->ncollisions = 0;
+    discovery->status.active = 1;
+
+    discovery_request_frame_t request = {
+        .fctrl = FCNTL_IEEE_DISCOVERY_16,
+        .seq_num = seq_num++,
+        .PANID = inst->PANID,
+        .dst_address = 0xFFFF,
+        .src_address = inst->my_short_address,
+        .code = DISCOVERY_CODE_REQUEST,
+        .nslots = discovery->nslots,
+        .slot_usec = MYNEWT_VAL(DISCOVERY_SLOT_USEC),
+        .seed = discovery->seed
+    };
+
+    dw1000_phy_forcetrxoff(inst);
+    dw1000_write_tx(inst, (uint8_t *) &request, 0, sizeof(discovery_request_frame_t));
+    dw1000_write_tx_fctrl(inst, sizeof(discovery_request_frame_t), 0, true);
+    dw1000_set_wait4resp(inst, true);
+    dw1000_set_rx_timeout(inst, 0);
+    dw1000_start_tx(inst);
+
+    uint32_t usecs = MYNEWT_VAL(DISCOVERY_HOLDOFF_USEC) + (discovery->nslots + 1) * (uint32_t) MYNEWT_VAL(DISCOVERY_SLOT_USEC);
+    os_callout_reset(&discovery->callout, (uint64_t) OS_TICKS_PER_SEC * usecs / 1000000 + 1);
+}
@@ -0,0 +1,113 @@
+/**
+ * Copyright 2018, Decawave Limited, All Rights Reserved
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _DW1000_DISCOVERY_TABLE_H_
+#define _DW1000_DISCOVERY_TABLE_H_
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "syscfg/syscfg.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Node table and response window of lib/discovery. The node table is a
+ * sorted array of short addresses with a bitmap of the nodes heard in the
+ * current round. New nodes are collected in a sorted pending list and merged,
+ * and nodes unheard for DISCOVERY_MAX_MISSES rounds dropped, in one pass when
+ * the round closes. Nothing here touches the radio, lib/discovery drives it
+ * on the devices, apps/discovery_sim on the host.
+ */
+
+typedef struct _discovery_table_t{
+    uint16_t nnodes;
+    uint16_t npending;
+    uint16_t nnew;                  // Merged by the last round
+    uint16_t ndropped;              // Dropped by the last round
+    uint16_t addr[MYNEWT_VAL(DISCOVERY_NNODES)];        // Sorted
+    uint8_t misses[MYNEWT_VAL(DISCOVERY_NNODES)];       // Rounds unheard in a row
+    uint32_t seen[(MYNEWT_VAL(DISCOVERY_NNODES) + 31) / 32];
+    uint16_t pending[MYNEWT_VAL(DISCOVERY_NNODES)];     // New this round, sorted
+}discovery_table_t;
+
+/**
+ * [discovery_table_init description]
+ * @param  table [Node table]
+ */
+void discovery_table_init(discovery_table_t * table);
+
+/**
+ * [discovery_table_find description]
+ * @param  table   [Node table]
+ * @param  address [Short address]
+ * @return         [Index in the table, -1 if unknown or pending]
+ */
+int discovery_table_find(discovery_table_t * table, uint16_t address);
+
+/**
+ * [discovery_table_heard description]
+ * A node answered in the current round.
+ * @param  table   [Node table]
+ * @param  address [Short address]
+ * @return         [1 if new, 0 if known, -1 if the table is full]
+ */
+int discovery_table_heard(discovery_table_t * table, uint16_t address);
+
+/**
+ * [discovery_table_round description]
+ * Close a round: age the nodes not heard, drop those unheard for
+ * DISCOVERY_MAX_MISSES rounds and merge the new ones.
+ * @param  table [Node table]
+ * @return       [Nodes in the table]
+ */
+uint16_t discovery_table_round(discovery_table_t * table);
+
+/**
+ * [discovery_slot description]
+ * Response slot of a node for a round.
+ * @param  address [Short address of the node]
+ * @param  seed    [Round seed]
+ * @param  nslots  [Slots in the window]
+ * @return         [Slot]
+ */
+uint16_t discovery_slot(uint16_t address, uint32_t seed, uint16_t nslots);
+
+/**
+ * [discovery_nslots description]
+ * Response window for the next round, DISCOVERY_WINDOW_FACTOR times the
+ * expected responders: the responses of the last round plus 2.39 per
+ * collision (Schoute), at least the nodes known. When most of the last
+ * window collided it doubles, the estimate being too low.
+ * @param  nnodes      [Nodes known]
+ * @param  nresponses  [Responses of the last round]
+ * @param  ncollisions [Collisions of the last round]
+ * @param  nslots      [Slots of the last round]
+ * @return             [Slots, within DISCOVERY_NSLOTS_MIN and DISCOVERY_NSLOTS_MAX]
+ */
+uint16_t discovery_nslots(uint16_t nnodes, uint16_t nresponses, uint16_t ncollisions, uint16_t nslots);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* _DW1000_DISCOVERY_TABLE_H_ */
@@ -0,0 +1,136 @@
+/*
+ * Copyright 2018, Decawave Limited, All Rights Reserved
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+#include <stdio.h>
+#include <string.h>
+#include "syscfg/syscfg.h"
+
+#include <discovery_table/dw1000_discovery_table.h>
+
+/*
+ * First index with addr[i] >= address.
+ */
+static uint16_t
+discovery_lower_bound(const uint16_t * addr, uint16_t n, uint16_t address){
+    uint16_t lo = 0, hi = n;
+    while (lo < hi){
+        uint16_t mid = (lo + hi) / 2;
+        if (addr[mid] < address)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+void
+discovery_table_init(discovery_table_t * table){
+    memset(table, 0, sizeof(discovery_table_t));
+}
+
+int
+discovery_table_find(discovery_table_t * table, uint16_t address){
+    uint16_t i = discovery_lower_bound(table->addr, table->nnodes, address);
+    return (i < table->nnodes && table->addr[i] == address) ? i : -1;
+}
+
+int
+discovery_table_heard(discovery_table_t * table, uint16_t address){
+    int i = discovery_table_find(table, address);
+    if (i >= 0){
+        table->seen[i / 32] |= 1UL << (i % 32);
+        return 0;
+    }
+    uint16_t j = discovery_lower_bound(table->pending, table->npending, address);
+    if (j < table->npending && table->pending[j] == address)
+        return 0;
+    if (table->nnodes + table->npending == MYNEWT_VAL(DISCOVERY_NNODES))
+        return -1;
+
+    memmove(&table->pending[j + 1], &table->pending[j], (table->npending - j) * sizeof(uint16_t));
+    table->pending[j] = address;
+    table->npending++;
+    return 1;
+}
+
+uint16_t
+discovery_table_round(discovery_table_t * table){
+    uint16_t n = 0;
+
+    table->ndropped = 0;
+    for (uint16_t i = 0; i < table->nnodes; i++){
+        if (table->seen[i / 32] & (1UL << (i % 32)))
+            table->misses[i] = 0;
+        else if (++table->misses[i] >= MYNEWT_VAL(DISCOVERY_MAX_MISSES)){
+            table->ndropped++;
+            continue;
+        }
+        table->addr[n] = table->addr[i];
+        table->misses[n] = table->misses[i];
+        n++;
+    }
+
+    // Merge the new nodes from the back, in place
+    int32_t i = n - 1, j = table->npending - 1, k = n + table->npending - 1;
+    while (j >= 0){
+        if (i >= 0 && table->addr[i] > table->pending[j]){
+            table->addr[k] = table->addr[i];
+            table->misses[k] = table->misses[i];
+            i--;
+        }else{
+            table->addr[k] = table->pending[j];
+            table->misses[k] = 0;
+            j--;
+        }
+        k--;
+    }
+    table->nnodes = n + table->npending;
+    table->nnew = table->npending;
+    table->npending = 0;
+    memset(table->seen, 0, sizeof(table->seen));
+    return table->nnodes;
+}
+
+uint16_t
+discovery_slot(uint16_t address, uint32_t seed, uint16_t nslots){
+    uint32_t x = address ^ seed;
+    x = (x ^ 61) ^ (x >> 16);
+    x *= 9;
+    x ^= x >> 4;
+    x *= 0x27d4eb2d;
+    x ^= x >> 15;
+    return x % nslots;
+}
+
+uint16_t
+discovery_nslots(uint16_t nnodes, uint16_t nresponses, uint16_t ncollisions, uint16_t nslots){
+    uint32_t estimate = nresponses + (239 * ncollisions + 99) / 100;
+    if (estimate < nnodes)
+        estimate = nnodes;
+    uint32_t n = MYNEWT_VAL(DISCOVERY_WINDOW_FACTOR) * estimate;
+
+    if (2 * ncollisions > nslots && n < 2 * (uint32_t) nslots)
+        n = 2 * (uint32_t) nslots;
+    if (n < MYNEWT_VAL(DISCOVERY_NSLOTS_MIN))
+        n = MYNEWT_VAL(DISCOVERY_NSLOTS_MIN);
+    if (n > MYNEWT_VAL(DISCOVERY_NSLOTS_MAX))
+        n = MYNEWT_VAL(DISCOVERY_NSLOTS_MAX);
+    return n;
+}
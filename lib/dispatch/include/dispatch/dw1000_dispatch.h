@@ -0,0 +1,114 @@
+/**
+ * Copyright 2018, Decawave Limited, All Rights Reserved
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _DW1000_DISPATCH_H_
+#define _DW1000_DISPATCH_H_
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "syscfg/syscfg.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <dw1000/dw1000_dev.h>
+#include <dw1000/dw1000_ftypes.h>
+
+/*
+ * The dispatch table is registered with the driver as a single extension.
+ * Events are routed to the handler set bound to inst->fctrl and, for frames
+ * carrying a ranging code (ieee_rng_request_frame_t layout), to the code range
+ * holding the received code. Handlers are only called for their own frames
+ * so need not check inst->fctrl. Events without a match return false and the
+ * driver carries on with the remaining extensions.
+ *
+ * tx_complete, tx_error, rx_timeout and rx_error events carry no frame, they
+ * go to the handler set of the last frame received under inst->fctrl.
+ */
+
+#define DISPATCH_CODE_ANY_LO 0x0000
+#define DISPATCH_CODE_ANY_HI 0xFFFF
+
+typedef struct _dispatch_entry_t{
+    uint16_t fctrl;
+    uint16_t code_lo;               // Inclusive code range
+    uint16_t code_hi;
+    bool (* tx_complete_cb) (struct _dw1000_dev_instance_t *);
+    bool (* rx_complete_cb) (struct _dw1000_dev_instance_t *);
+    bool (* rx_timeout_cb) (struct _dw1000_dev_instance_t *);
+    bool (* rx_error_cb) (struct _dw1000_dev_instance_t *);
+    bool (* tx_error_cb) (struct _dw1000_dev_instance_t *);
+}dispatch_entry_t;
+
+typedef struct _dispatch_fctrl_t{
+    uint16_t fctrl;
+    uint16_t read_code:1;           // More than one handler set, or a partial code range
+    uint16_t used:1;
+    uint8_t last;                   // Entry of the last frame received, index + 1
+    uint8_t code_map[MYNEWT_VAL(DISPATCH_NCODES)];  // Entry by code, index + 1
+    uint32_t entries;               // Bitmask of the entries bound to this fctrl
+}dispatch_fctrl_t;
+
+typedef struct _dispatch_instance_t{
+    struct _dw1000_dev_instance_t * parent;
+    uint16_t code;                  // Code of the frame being dispatched
+    uint16_t nentries;
+    dispatch_fctrl_t fctrl[MYNEWT_VAL(DISPATCH_NFCTRL)];
+    dispatch_entry_t entries[MYNEWT_VAL(DISPATCH_NENTRIES)];
+}dispatch_instance_t;
+
+/**
+ * [dispatch_register description]
+ * Bind a handler set to a frame control and code range. The dispatch table of
+ * the instance is created and registered with the driver on first use.
+ * @param  inst    [dw1000 instance]
+ * @param  fctrl   [Frame control, e.g. FCNTL_IEEE_N_RANGES_16]
+ * @param  code_lo [First code, DISPATCH_CODE_ANY_LO for all codes]
+ * @param  code_hi [Last code, DISPATCH_CODE_ANY_HI for all codes]
+ * @param  cbs     [Handlers, NULL members are skipped]
+ * @return         [0 on success, -1 if the table is full or the range overlaps an existing one]
+ */
+int dispatch_register(struct _dw1000_dev_instance_t * inst, uint16_t fctrl, uint16_t code_lo, uint16_t code_hi,
+        const dw1000_extension_callbacks_t * cbs);
+
+/**
+ * [dispatch_get description]
+ * Dispatch table of an instance, created on first use.
+ */
+dispatch_instance_t * dispatch_get(struct _dw1000_dev_instance_t * inst);
+
+/**
+ * [dispatch_rx_code description]
+ * Code of the frame being dispatched, saves handlers reading it back over spi.
+ * Only valid within an rx_complete_cb bound to a partial code range or sharing
+ * its frame control with another handler set.
+ */
+static inline uint16_t
+dispatch_rx_code(struct _dw1000_dev_instance_t * inst){
+    return dispatch_get(inst)->code;
+}
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* _DW1000_DISPATCH_H_ */
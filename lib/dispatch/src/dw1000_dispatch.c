@@ -0,0 +1,211 @@
+/*
+ * Copyright 2018, Decawave Limited, All Rights Reserved
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <stddef.h>
+#include <assert.h>
+#include <os/os.h>
+#include "syscfg/syscfg.h"
+
+#include <dw1000/dw1000_dev.h>
+#include <dw1000/dw1000_hal.h>
+#include <dw1000/dw1000_mac.h>
+#include <dw1000/dw1000_ftypes.h>
+#include <dispatch/dw1000_dispatch.h>
+
+#define DISPATCH_NFCTRL MYNEWT_VAL(DISPATCH_NFCTRL)
+#define DISPATCH_NCODES MYNEWT_VAL(DISPATCH_NCODES)
+
+_Static_assert((DISPATCH_NFCTRL & (DISPATCH_NFCTRL - 1)) == 0, "DISPATCH_NFCTRL must be a power of two");
+_Static_assert(MYNEWT_VAL(DISPATCH_NENTRIES) <= 32, "DISPATCH_NENTRIES exceeds the fctrl entry mask");
+_Static_assert(MYNEWT_VAL(DISPATCH_NENTRIES) < 256, "DISPATCH_NENTRIES exceeds the code map");
+
+static dispatch_instance_t g_dispatch[MYNEWT_VAL(DISPATCH_NINSTANCES)];
+
+static bool dispatch_tx_complete_cb(dw1000_dev_instance_t * inst);
+static bool dispatch_rx_complete_cb(dw1000_dev_instance_t * inst);
+static bool dispatch_rx_timeout_cb(dw1000_dev_instance_t * inst);
+static bool dispatch_rx_error_cb(dw1000_dev_instance_t * inst);
+static bool dispatch_tx_error_cb(dw1000_dev_instance_t * inst);
+
+static inline uint16_t
+dispatch_hash(uint16_t fctrl){
+    return (fctrl ^ (fctrl >> 5) ^ (fctrl >> 11)) & (DISPATCH_NFCTRL - 1);
+}
+
+/*
+ * Open addressing with linear probing, slots are never removed.
+ */
+static dispatch_fctrl_t *
+dispatch_fctrl(dispatch_instance_t * dispatch, uint16_t fctrl, bool create){
+
+    uint16_t h = dispatch_hash(fctrl);
+    for (uint16_t i = 0; i < DISPATCH_NFCTRL; i++){
+        dispatch_fctrl_t * slot = &dispatch->fctrl[(h + i) & (DISPATCH_NFCTRL - 1)];
+        if (slot->used && slot->fctrl == fctrl)
+            return slot;
+        if (!slot->used){
+            if (!create)
+                return NULL;
+            memset(slot, 0, sizeof(dispatch_fctrl_t));
+            slot->used = 1;
+            slot->fctrl = fctrl;
+            return slot;
+        }
+    }
+    return NULL;
+}
+
+dispatch_instance_t *
+dispatch_get(dw1000_dev_instance_t * inst){
+
+    assert(inst);
+    dispatch_instance_t * dispatch = NULL;
+    for (uint16_t i = 0; i < MYNEWT_VAL(DISPATCH_NINSTANCES); i++){
+        if (g_dispatch[i].parent == inst)
+            return &g_dispatch[i];
+        if (dispatch == NULL && g_dispatch[i].parent == NULL)
+            dispatch = &g_dispatch[i];
+    }
+    assert(dispatch);
+
+    memset(dispatch, 0, sizeof(dispatch_instance_t));
+    dispatch->parent = inst;
+
+    dw1000_extension_callbacks_t dispatch_cbs;
+    memset(&dispatch_cbs, 0, sizeof(dispatch_cbs));
+    dispatch_cbs.tx_complete_cb = dispatch_tx_complete_cb;
+    dispatch_cbs.rx_complete_cb = dispatch_rx_complete_cb;
+    dispatch_cbs.rx_timeout_cb = dispatch_rx_timeout_cb;
+    dispatch_cbs.rx_error_cb = dispatch_rx_error_cb;
+    dispatch_cbs.tx_error_cb = dispatch_tx_error_cb;
+    dispatch_cbs.id = MYNEWT_VAL(DISPATCH_EXTENSION_ID);
+    dw1000_add_extension_callbacks(inst, dispatch_cbs);
+
+    return dispatch;
+}
+
+int
+dispatch_register(dw1000_dev_instance_t * inst, uint16_t fctrl, uint16_t code_lo, uint16_t code_hi,
+        const dw1000_extension_callbacks_t * cbs){
+
+    assert(cbs);
+    assert(code_lo <= code_hi);
+    dispatch_instance_t * dispatch = dispatch_get(inst);
+
+    if (dispatch->nentries == MYNEWT_VAL(DISPATCH_NENTRIES))
+        return -1;
+    dispatch_fctrl_t * slot = dispatch_fctrl(dispatch, fctrl, true);
+    if (slot == NULL)
+        return -1;
+    for (uint16_t e = 0; e < dispatch->nentries; e++)
+        if ((slot->entries & (1UL << e)) && code_lo <= dispatch->entries[e].code_hi && dispatch->entries[e].code_lo <= code_hi)
+            return -1;
+
+    uint16_t e = dispatch->nentries++;
+    dispatch_entry_t * entry = &dispatch->entries[e];
+    entry->fctrl = fctrl;
+    entry->code_lo = code_lo;
+    entry->code_hi = code_hi;
+    entry->tx_complete_cb = cbs->tx_complete_cb;
+    entry->rx_complete_cb = cbs->rx_complete_cb;
+    entry->rx_timeout_cb = cbs->rx_timeout_cb;
+    entry->rx_error_cb = cbs->rx_error_cb;
+    entry->tx_error_cb = cbs->tx_error_cb;
+
+    slot->entries |= 1UL << e;
+    for (uint32_t code = code_lo; code <= code_hi && code < DISPATCH_NCODES; code++)
+        slot->code_map[code] = e + 1;
+    slot->read_code = (slot->entries != (1UL << e)) || code_lo != DISPATCH_CODE_ANY_LO || code_hi != DISPATCH_CODE_ANY_HI;
+    if (slot->last == 0)
+        slot->last = e + 1;
+    return 0;
+}
+
+/*
+ * Codes beyond the direct lookup are matched against the few entries of the slot.
+ */
+static dispatch_entry_t *
+dispatch_code(dispatch_instance_t * dispatch, dispatch_fctrl_t * slot, uint16_t code){
+
+    if (code < DISPATCH_NCODES)
+        return slot->code_map[code] ? &dispatch->entries[slot->code_map[code] - 1] : NULL;
+
+    for (uint16_t e = 0; e < dispatch->nentries; e++)
+        if ((slot->entries & (1UL << e)) && code >= dispatch->entries[e].code_lo && code <= dispatch->entries[e].code_hi)
+            return &dispatch->entries[e];
+    return NULL;
+}
+
+static bool
+dispatch_rx_complete_cb(dw1000_dev_instance_t * inst){
+
+    dispatch_instance_t * dispatch = dispatch_get(inst);
+    dispatch_fctrl_t * slot = dispatch_fctrl(dispatch, inst->fctrl, false);
+    if (slot == NULL)
+        return false;
+
+    dispatch_entry_t * entry;
+    if (slot->read_code){
+        if (inst->frame_len < offsetof(ieee_rng_request_frame_t, code) + sizeof(uint16_t))
+            return false;
+        dw1000_read_rx(inst, (uint8_t *) &dispatch->code, offsetof(ieee_rng_request_frame_t, code), sizeof(uint16_t));
+        entry = dispatch_code(dispatch, slot, dispatch->code);
+        if (entry == NULL)
+            return false;
+        slot->last = entry - dispatch->entries + 1;
+    }else
+        entry = &dispatch->entries[slot->last - 1];
+
+    return (entry->rx_complete_cb) ? entry->rx_complete_cb(inst) : false;
+}
+
+static inline dispatch_entry_t *
+dispatch_last(dw1000_dev_instance_t * inst){
+
+    dispatch_instance_t * dispatch = dispatch_get(inst);
+    dispatch_fctrl_t * slot = dispatch_fctrl(dispatch, inst->fctrl, false);
+    return (slot == NULL) ? NULL : &dispatch->entries[slot->last - 1];
+}
+
+static bool
+dispatch_tx_complete_cb(dw1000_dev_instance_t * inst){
+    dispatch_entry_t * entry = dispatch_last(inst);
+    return (entry && entry->tx_complete_cb) ? entry->tx_complete_cb(inst) : false;
+}
+
+static bool
+dispatch_rx_timeout_cb(dw1000_dev_instance_t * inst){
+    dispatch_entry_t * entry = dispatch_last(inst);
+    return (entry && entry->rx_timeout_cb) ? entry->rx_timeout_cb(inst) : false;
+}
+
+static bool
+dispatch_rx_error_cb(dw1000_dev_instance_t * inst){
+    dispatch_entry_t * entry = dispatch_last(inst);
+    return (entry && entry->rx_error_cb) ? entry->rx_error_cb(inst) : false;
+}
+
+static bool
+dispatch_tx_error_cb(dw1000_dev_instance_t * inst){
+    dispatch_entry_t * entry = dispatch_last(inst);
+    return (entry && entry->tx_error_cb) ? entry->tx_error_cb(inst) : false;
+}
@@ -0,0 +1,132 @@
+/**
+ * Copyright 2018, Decawave Limited, All Rights Reserved
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _DW1000_FUSION_H_
+#define _DW1000_FUSION_H_
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "syscfg/syscfg.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Extended Kalman filter fusing IMU samples with UWB ranges on a tag held
+ * about level. The state is the horizontal position, velocity and heading:
+ *
+ *   [x y vx vy psi]   m, m/s, rad
+ *
+ * Each IMU sample predicts the state with the body frame horizontal
+ * acceleration rotated by the heading and the yaw rate integrated into it.
+ * Each range to a known anchor corrects it, the magnetometer heading
+ * optionally too. Ranges far outside their predicted spread are rejected.
+ */
+
+#define FUSION_NSTATES 5
+
+typedef enum _fusion_state_idx_t{
+    FUSION_X = 0,
+    FUSION_Y,
+    FUSION_VX,
+    FUSION_VY,
+    FUSION_PSI
+}fusion_state_idx_t;
+
+typedef struct _fusion_anchor_t{
+    uint16_t address;
+    int32_t x;                      // mm
+    int32_t y;
+    int32_t z;
+}fusion_anchor_t;
+
+typedef struct _fusion_imu_t{
+    float accel[3];                 // Body frame, m/s^2
+    float gyro[3];                  // Body frame, deg/s
+}fusion_imu_t;
+
+typedef struct _fusion_status_t{
+    uint16_t initialized:1;
+    uint16_t predicted:1;           // Holds an IMU time reference
+}fusion_status_t;
+
+typedef struct _fusion_instance_t{
+    fusion_status_t status;
+    uint16_t nanchors;
+    uint32_t utime;                 // Last prediction, usec
+    uint32_t nranges;
+    uint32_t nrejected;
+    float state[FUSION_NSTATES];
+    float P[FUSION_NSTATES][FUSION_NSTATES];
+    fusion_anchor_t anchors[MYNEWT_VAL(FUSION_NANCHORS)];
+}fusion_instance_t;
+
+/**
+ * [fusion_init description]
+ * Load the anchor table and start from the anchor centroid at rest.
+ * @param  fusion   [Filter instance]
+ * @param  anchors  [Anchor table, may be NULL]
+ * @param  nanchors [Anchors]
+ * @return          [Filter instance]
+ */
+fusion_instance_t * fusion_init(fusion_instance_t * fusion, const fusion_anchor_t * anchors, uint16_t nanchors);
+
+/**
+ * [fusion_anchor_set description]
+ * Add or move an anchor.
+ * @return          [0 on success, -1 if the table is full]
+ */
+int fusion_anchor_set(fusion_instance_t * fusion, uint16_t address, int32_t x, int32_t y, int32_t z);
+
+/**
+ * [fusion_predict description]
+ * Propagate the state to the time of an IMU sample.
+ * @param  fusion [Filter instance]
+ * @param  utime  [Sample time in usec, may wrap]
+ * @param  imu    [Accelerometer and gyroscope sample]
+ */
+void fusion_predict(fusion_instance_t * fusion, uint32_t utime, const fusion_imu_t * imu);
+
+/**
+ * [fusion_range description]
+ * Correct with a range to an anchor.
+ * @param  fusion  [Filter instance]
+ * @param  address [Anchor]
+ * @param  range   [Range in m]
+ * @return         [0 if applied, -1 for an unknown anchor, -2 if gated out]
+ */
+int fusion_range(fusion_instance_t * fusion, uint16_t address, float range);
+
+/**
+ * [fusion_heading description]
+ * Correct with the magnetometer heading of a level tag, offset by FUSION_MAG_OFFSET_MDEG
+ * into the site frame. No-op when FUSION_MAG_NOISE_MDEG is 0, the default.
+ * @param  fusion [Filter instance]
+ * @param  mag    [Body frame magnetic field, any unit]
+ */
+void fusion_heading(fusion_instance_t * fusion, const float mag[3]);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* _DW1000_FUSION_H_ */
@@ -0,0 +1,211 @@
+/*
+ * Copyright 2018, Decawave Limited, All Rights Reserved
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+#include <string.h>
+#include <assert.h>
+#include <math.h>
+#include "syscfg/syscfg.h"
+
+#include <fusion/dw1000_fusion.h>
+
+#define N FUSION_NSTATES
+#define FUSION_MAX_DT 0.5f          // s, bounds the prediction over an IMU stall
+#define DEG2RAD ((float) M_PI / 180)
+
+static float
+fusion_wrap(float a){
+    while (a > (float) M_PI)
+        a -= 2 * (float) M_PI;
+    while (a <= -(float) M_PI)
+        a += 2 * (float) M_PI;
+    return a;
+}
+
+static const fusion_anchor_t *
+fusion_anchor_find(const fusion_instance_t * fusion, uint16_t address){
+    for (uint16_t i = 0; i < fusion->nanchors; i++)
+        if (fusion->anchors[i].address == address)
+            return &fusion->anchors[i];
+    return NULL;
+}
+
+fusion_instance_t *
+fusion_init(fusion_instance_t * fusion, const fusion_anchor_t * anchors, uint16_t nanchors){
+    assert(fusion);
+
+    memset(fusion, 0, sizeof(fusion_instance_t));
+    for (uint16_t i = 0; anchors && i < nanchors; i++)
+        fusion_anchor_set(fusion, anchors[i].address, anchors[i].x, anchors[i].y, anchors[i].z);
+
+    for (uint16_t i = 0; i < fusion->nanchors; i++){
+        fusion->state[FUSION_X] += fusion->anchors[i].x / 1000.0f / fusion->nanchors;
+        fusion->state[FUSION_Y] += fusion->anchors[i].y / 1000.0f / fusion->nanchors;
+    }
+    float sigma = MYNEWT_VAL(FUSION_INIT_SIGMA_MM) / 1000.0f;
+    fusion->P[FUSION_X][FUSION_X] = sigma * sigma;
+    fusion->P[FUSION_Y][FUSION_Y] = sigma * sigma;
+    fusion->P[FUSION_VX][FUSION_VX] = 1.0f;
+    fusion->P[FUSION_VY][FUSION_VY] = 1.0f;
+    fusion->P[FUSION_PSI][FUSION_PSI] = (float)(M_PI * M_PI);
+    fusion->status.initialized = 1;
+    return fusion;
+}
+
+int
+fusion_anchor_set(fusion_instance_t * fusion, uint16_t address, int32_t x, int32_t y, int32_t z){
+    fusion_anchor_t * anchor = (fusion_anchor_t *) fusion_anchor_find(fusion, address);
+
+    if (anchor == NULL){
+        if (fusion->nanchors == MYNEWT_VAL(FUSION_NANCHORS))
+            return -1;
+        anchor = &fusion->anchors[fusion->nanchors++];
+        anchor->address = address;
+    }
+    anchor->x = x;
+    anchor->y = y;
+    anchor->z = z;
+    return 0;
+}
+
+void
+fusion_predict(fusion_instance_t * fusion, uint32_t utime, const fusion_imu_t * imu){
+    float * s = fusion->state;
+
+    if (!fusion->status.predicted){
+        fusion->status.predicted = 1;
+        fusion->utime = utime;
+        return;
+    }
+    float dt = (uint32_t)(utime - fusion->utime) / 1e6f;
+    fusion->utime = utime;
+    if (dt > FUSION_MAX_DT)
+        dt = FUSION_MAX_DT;
+
+    float c = cosf(s[FUSION_PSI]), sn = sinf(s[FUSION_PSI]);
+    float ax = c * imu->accel[0] - sn * imu->accel[1];
+    float ay = sn * imu->accel[0] + c * imu->accel[1];
+    float dt2 = dt * dt / 2;
+
+    s[FUSION_X] += s[FUSION_VX] * dt + ax * dt2;
+    s[FUSION_Y] += s[FUSION_VY] * dt + ay * dt2;
+    s[FUSION_VX] += ax * dt;
+    s[FUSION_VY] += ay * dt;
+    s[FUSION_PSI] = fusion_wrap(s[FUSION_PSI] + imu->gyro[2] * DEG2RAD * dt);
+
+    // Jacobian of the prediction
+    float F[N][N] = {{0}};
+    for (uint8_t i = 0; i < N; i++)
+        F[i][i] = 1;
+    F[FUSION_X][FUSION_VX] = dt;
+    F[FUSION_Y][FUSION_VY] = dt;
+    F[FUSION_X][FUSION_PSI] = -ay * dt2;
+    F[FUSION_Y][FUSION_PSI] = ax * dt2;
+    F[FUSION_VX][FUSION_PSI] = -ay * dt;
+    F[FUSION_VY][FUSION_PSI] = ax * dt;
+
+    float FP[N][N];
+    for (uint8_t i = 0; i < N; i++)
+        for (uint8_t j = 0; j < N; j++){
+            FP[i][j] = 0;
+            for (uint8_t k = 0; k < N; k++)
+                FP[i][j] += F[i][k] * fusion->P[k][j];
+        }
+    for (uint8_t i = 0; i < N; i++)
+        for (uint8_t j = i; j < N; j++){
+            float v = 0;
+            for (uint8_t k = 0; k < N; k++)
+                v += FP[i][k] * F[j][k];
+            fusion->P[i][j] = fusion->P[j][i] = v;
+        }
+
+    // Acceleration noise enters as a white jerk free input, yaw rate noise on psi
+    float qa = MYNEWT_VAL(FUSION_ACCEL_NOISE) / 1000.0f;
+    float qg = MYNEWT_VAL(FUSION_GYRO_NOISE) / 1000.0f * DEG2RAD;
+    qa *= qa;
+    for (uint8_t i = 0; i < 2; i++){
+        fusion->P[FUSION_X + i][FUSION_X + i] += qa * dt2 * dt2;
+        fusion->P[FUSION_X + i][FUSION_VX + i] += qa * dt2 * dt;
+        fusion->P[FUSION_VX + i][FUSION_X + i] += qa * dt2 * dt;
+        fusion->P[FUSION_VX + i][FUSION_VX + i] += qa * dt * dt;
+    }
+    fusion->P[FUSION_PSI][FUSION_PSI] += qg * qg * dt * dt;
+}
+
+/*
+ * Scalar measurement update with measurement row H, innovation y and variance R.
+ */
+static int
+fusion_update(fusion_instance_t * fusion, const float H[N], float y, float R, float gate){
+    float PH[N];
+    float S = R;
+
+    for (uint8_t i = 0; i < N; i++){
+        PH[i] = 0;
+        for (uint8_t k = 0; k < N; k++)
+            PH[i] += fusion->P[i][k] * H[k];
+    }
+    for (uint8_t i = 0; i < N; i++)
+        S += H[i] * PH[i];
+    if (gate > 0 && y * y > gate * gate * S)
+        return -2;
+
+    for (uint8_t i = 0; i < N; i++)
+        fusion->state[i] += PH[i] / S * y;
+    fusion->state[FUSION_PSI] = fusion_wrap(fusion->state[FUSION_PSI]);
+    for (uint8_t i = 0; i < N; i++)
+        for (uint8_t j = 0; j < N; j++)
+            fusion->P[i][j] -= PH[i] * PH[j] / S;
+    return 0;
+}
+
+int
+fusion_range(fusion_instance_t * fusion, uint16_t address, float range){
+    const fusion_anchor_t * anchor = fusion_anchor_find(fusion, address);
+    if (anchor == NULL)
+        return -1;
+
+    float dx = fusion->state[FUSION_X] - anchor->x / 1000.0f;
+    float dy = fusion->state[FUSION_Y] - anchor->y / 1000.0f;
+    float dz = (MYNEWT_VAL(FUSION_Z_MM) - anchor->z) / 1000.0f;
+    float r = sqrtf(dx * dx + dy * dy + dz * dz);
+    if (r < 1e-3f)
+        r = 1e-3f;
+
+    float H[N] = {dx / r, dy / r, 0, 0, 0};
+    float sigma = MYNEWT_VAL(FUSION_RANGE_NOISE_MM) / 1000.0f;
+    int rc = fusion_update(fusion, H, range - r, sigma * sigma, MYNEWT_VAL(FUSION_GATE));
+    if (rc == 0)
+        fusion->nranges++;
+    else
+        fusion->nrejected++;
+    return rc;
+}
+
+void
+fusion_heading(fusion_instance_t * fusion, const float mag[3]){
+#if MYNEWT_VAL(FUSION_MAG_NOISE_MDEG) > 0
+    float H[N] = {0, 0, 0, 0, 1};
+    float sigma = MYNEWT_VAL(FUSION_MAG_NOISE_MDEG) / 1000.0f * DEG2RAD;
+    // Magnetic heading, rotated into the site frame of the state and anchors
+    float psi = atan2f(-mag[1], mag[0]) + MYNEWT_VAL(FUSION_MAG_OFFSET_MDEG) / 1000.0f * DEG2RAD;
+
+    fusion_update(fusion, H, fusion_wrap(psi - fusion->state[FUSION_PSI]), sigma * sigma, 0);
+#endif
+}
@@ -0,0 +1,116 @@
+/**
+ * Copyright 2018, Decawave Limited, All Rights Reserved
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _DW1000_HOLDOFF_H_
+#define _DW1000_HOLDOFF_H_
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "syscfg/syscfg.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <os/os.h>
+#include <dw1000/dw1000_dev.h>
+#include <dw1000/dw1000_rng.h>
+
+/*
+ * The turnaround of a response is the time from the rx timestamp of the
+ * request to the delayed-tx register write, in dw1000 time units. The
+ * tx_holdoff_delay unit is 1 << 16 of those (~1.026us).
+ *
+ * Responders use tx_holdoff_delay as the slot spacing of an nranges round, so it
+ * is a network wide value and is never changed here. The measurement only checks
+ * that the configured value covers this device's turnaround.
+ */
+#define HOLDOFF_UNIT_SHIFT 16
+
+typedef struct _holdoff_status_t{
+    uint16_t measuring:1;
+    uint16_t checked:1;
+    uint16_t insufficient:1;        // Configured tx_holdoff_delay below the required value
+}holdoff_status_t;
+
+typedef struct _holdoff_instance_t{
+    struct _dw1000_dev_instance_t * parent;
+    dw1000_rng_config_t * config;
+    holdoff_status_t status;
+    uint16_t required;              // Worst turnaround plus margin of the last check, tx_holdoff_delay units
+    uint16_t nsamples;
+    uint32_t turnaround_min;        // dw1000 time units
+    uint32_t turnaround_max;
+    uint64_t turnaround_sum;
+    uint16_t ntx;                   // Delayed transmissions in the current window
+    uint16_t nlate;                 // Late transmissions in the current window
+    uint32_t nlate_total;
+    struct os_callout callout;      // Reporting, HOLDOFF_VERBOSE
+}holdoff_instance_t;
+
+/**
+ * [holdoff_init description]
+ * Attach to the rng config whose tx_holdoff_delay is checked.
+ * @param  holdoff [Holdoff instance]
+ * @param  inst    [dw1000 instance]
+ * @param  config  [Ranging config]
+ */
+void holdoff_init(holdoff_instance_t * holdoff, struct _dw1000_dev_instance_t * inst, dw1000_rng_config_t * config);
+
+/**
+ * [holdoff_start description]
+ * Start a check over the next HOLDOFF_NSAMPLES delayed responses.
+ */
+void holdoff_start(holdoff_instance_t * holdoff);
+
+/**
+ * [holdoff_sample description]
+ * Measure the turnaround of a response, call immediately before dw1000_set_delay_start.
+ * Reads the system time only while measuring.
+ * @param  holdoff      [Holdoff instance]
+ * @param  rx_timestamp [Rx timestamp of the frame being answered]
+ */
+void holdoff_sample(holdoff_instance_t * holdoff, uint64_t rx_timestamp);
+
+/**
+ * [holdoff_sample_systime description]
+ * As holdoff_sample, with the system time read back by the caller right after the
+ * delayed-tx register write, e.g. queued behind DX_TIME on an SPI command queue.
+ * @param  holdoff      [Holdoff instance]
+ * @param  rx_timestamp [Rx timestamp of the frame being answered]
+ * @param  systime      [SYS_TIME following the DX_TIME write]
+ */
+void holdoff_sample_systime(holdoff_instance_t * holdoff, uint64_t rx_timestamp, uint64_t systime);
+
+/**
+ * [holdoff_tx description]
+ * Runtime watch, report the outcome of a delayed dw1000_start_tx. More than
+ * HOLDOFF_LATE_LIMIT late transmissions per window start a new check.
+ * @param  holdoff [Holdoff instance]
+ * @param  late    [start_tx_error reported]
+ */
+void holdoff_tx(holdoff_instance_t * holdoff, bool late);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* _DW1000_HOLDOFF_H_ */
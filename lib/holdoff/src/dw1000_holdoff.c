@@ -0,0 +1,138 @@
+/*
+ * Copyright 2018, Decawave Limited, All Rights Reserved
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <os/os.h>
+#include "syscfg/syscfg.h"
+
+#include <dw1000/dw1000_dev.h>
+#include <dw1000/dw1000_hal.h>
+#include <dw1000/dw1000_mac.h>
+#include <dw1000/dw1000_rng.h>
+#include <holdoff/dw1000_holdoff.h>
+
+#define HOLDOFF_QUANTUM MYNEWT_VAL(HOLDOFF_QUANTUM)
+
+#if MYNEWT_VAL(HOLDOFF_VERBOSE)
+static void
+holdoff_report_cb(struct os_event * ev){
+    holdoff_instance_t * holdoff = (holdoff_instance_t *) ev->ev_arg;
+
+    printf("{\"utime\": %lu,\"holdoff\": {\"turnaround_min\": %lu,\"turnaround_max\": %lu,\"turnaround_mean\": %lu,"
+            "\"tx_holdoff_delay\": \"0x%04X\",\"required\": \"0x%04X\",\"insufficient\": %d,\"nlate\": %lu}}\n",
+            os_cputime_ticks_to_usecs(os_cputime_get32()),
+            holdoff->turnaround_min, holdoff->turnaround_max,
+            (uint32_t)(holdoff->turnaround_sum / MYNEWT_VAL(HOLDOFF_NSAMPLES)),
+            holdoff->config->tx_holdoff_delay, holdoff->required, holdoff->status.insufficient, holdoff->nlate_total
+    );
+}
+#endif
+
+void
+holdoff_init(holdoff_instance_t * holdoff, dw1000_dev_instance_t * inst, dw1000_rng_config_t * config){
+
+    assert(holdoff);
+    assert(config);
+    memset(holdoff, 0, sizeof(holdoff_instance_t));
+    holdoff->parent = inst;
+    holdoff->config = config;
+#if MYNEWT_VAL(HOLDOFF_VERBOSE)
+    os_callout_init(&holdoff->callout, os_eventq_dflt_get(), holdoff_report_cb, holdoff);
+#endif
+}
+
+void
+holdoff_start(holdoff_instance_t * holdoff){
+
+    assert(holdoff);
+    holdoff->nsamples = 0;
+    holdoff->turnaround_min = UINT32_MAX;
+    holdoff->turnaround_max = 0;
+    holdoff->turnaround_sum = 0;
+    holdoff->ntx = holdoff->nlate = 0;
+    holdoff->status.measuring = 1;
+}
+
+/*
+ * Worst turnaround plus margin, rounded up to the quantum.
+ */
+static uint16_t
+holdoff_value(holdoff_instance_t * holdoff){
+
+    uint32_t value = (holdoff->turnaround_max + (1UL << HOLDOFF_UNIT_SHIFT) - 1) >> HOLDOFF_UNIT_SHIFT;
+    value += MYNEWT_VAL(HOLDOFF_MARGIN);
+    value = (value + HOLDOFF_QUANTUM - 1) / HOLDOFF_QUANTUM * HOLDOFF_QUANTUM;
+    return (value < UINT16_MAX) ? value : UINT16_MAX;
+}
+
+void
+holdoff_sample(holdoff_instance_t * holdoff, uint64_t rx_timestamp){
+
+    if (holdoff == NULL || !holdoff->status.measuring)
+        return;
+
+    holdoff_sample_systime(holdoff, rx_timestamp, dw1000_read_systime(holdoff->parent));
+}
+
+void
+holdoff_sample_systime(holdoff_instance_t * holdoff, uint64_t rx_timestamp, uint64_t systime){
+
+    if (holdoff == NULL || !holdoff->status.measuring)
+        return;
+
+    uint32_t turnaround = (uint32_t)((systime - rx_timestamp) & 0xFFFFFFFFFFULL);
+
+    if (turnaround < holdoff->turnaround_min)
+        holdoff->turnaround_min = turnaround;
+    if (turnaround > holdoff->turnaround_max)
+        holdoff->turnaround_max = turnaround;
+    holdoff->turnaround_sum += turnaround;
+
+    if (++holdoff->nsamples == MYNEWT_VAL(HOLDOFF_NSAMPLES)){
+        holdoff->required = holdoff_value(holdoff);
+        holdoff->status.insufficient = holdoff->required > holdoff->config->tx_holdoff_delay;
+        holdoff->status.measuring = 0;
+        holdoff->status.checked = 1;
+        holdoff->ntx = holdoff->nlate = 0;
+#if MYNEWT_VAL(HOLDOFF_VERBOSE)
+        os_eventq_put(os_eventq_dflt_get(), &holdoff->callout.c_ev);
+#endif
+    }
+}
+
+void
+holdoff_tx(holdoff_instance_t * holdoff, bool late){
+
+    if (holdoff == NULL || holdoff->status.measuring)
+        return;
+
+    if (late){
+        holdoff->nlate++;
+        holdoff->nlate_total++;
+        if (holdoff->nlate > MYNEWT_VAL(HOLDOFF_LATE_LIMIT)){
+            holdoff_start(holdoff);
+            return;
+        }
+    }
+    if (++holdoff->ntx == MYNEWT_VAL(HOLDOFF_NSAMPLES))
+        holdoff->ntx = holdoff->nlate = 0;
+}
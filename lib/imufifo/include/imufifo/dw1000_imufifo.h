@@ -0,0 +1,119 @@
+/**
+ * Copyright 2018, Decawave Limited, All Rights Reserved
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _DW1000_IMUFIFO_H_
+#define _DW1000_IMUFIFO_H_
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "syscfg/syscfg.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <os/os.h>
+
+/*
+ * Batched accelerometer and gyroscope sampling from the hardware FIFO of an
+ * LSM6DSL or MPU-6500. Both run at IMUFIFO_ODR_HZ into the FIFO, which is
+ * drained with one I2C transaction every 3/4 of a batch period and handed to
+ * the consumer as a packed array of raw samples. The newest sample of a batch
+ * is stamped with the time of the drain, the others are spaced by the sample
+ * period; the stamp is late by up to one sample period.
+ */
+
+#define IMUFIFO_SAMPLE_SIZE 12      // Bytes per sample in the FIFO
+
+typedef struct _imufifo_sample_t{
+    int16_t accel[3];               // Body frame, LSB of accel_scale
+    int16_t gyro[3];                // Body frame, LSB of gyro_scale
+}imufifo_sample_t;
+
+typedef struct _imufifo_batch_t{
+    uint32_t cputime;               // os_cputime of the newest sample
+    uint64_t timestamp;             // Newest sample on the clock set by imufifo_set_clock(), 0 without
+    uint32_t period;                // Sample period, usec
+    uint16_t nsamples;
+    imufifo_sample_t samples[MYNEWT_VAL(IMUFIFO_BATCH)];     // Oldest first
+}imufifo_batch_t;
+
+struct _imufifo_instance_t;
+typedef void imufifo_cb_t(struct _imufifo_instance_t * imu, const imufifo_batch_t * batch, void * arg);
+typedef uint64_t imufifo_clock_fn(void * arg, uint32_t cputime);
+
+typedef struct _imufifo_instance_t{
+    uint8_t i2c_num;
+    uint8_t address;
+    float accel_scale;              // m/s^2 per LSB
+    float gyro_scale;               // deg/s per LSB
+    uint32_t nbatches;
+    uint32_t noverruns;             // FIFO overflows, samples were lost
+    uint32_t nerrors;               // Failed bus transactions
+    struct os_callout callout;
+    imufifo_cb_t * cb;
+    void * cb_arg;
+    imufifo_clock_fn * clock;
+    void * clock_arg;
+    imufifo_batch_t batch;
+    uint8_t buf[MYNEWT_VAL(IMUFIFO_BATCH) * IMUFIFO_SAMPLE_SIZE];
+}imufifo_instance_t;
+
+/**
+ * [imufifo_init description]
+ * Configure the IMU for FIFO operation at IMUFIFO_ODR_HZ, ±4g and ±500deg/s.
+ * @param  imu [IMU instance]
+ * @param  cb  [Consumer, called from the default event queue]
+ * @param  arg [Consumer argument]
+ * @return     [0 on success, bus error otherwise]
+ */
+int imufifo_init(imufifo_instance_t * imu, imufifo_cb_t * cb, void * arg);
+
+/**
+ * [imufifo_set_clock description]
+ * Stamp batches on another time base too, e.g. a uwbtime_from_cputime() wrapper.
+ */
+void imufifo_set_clock(imufifo_instance_t * imu, imufifo_clock_fn * clock, void * arg);
+
+/**
+ * [imufifo_start description]
+ * Flush the FIFO and start the periodic drain.
+ */
+void imufifo_start(imufifo_instance_t * imu);
+
+/**
+ * [imufifo_stop description]
+ * Stop the periodic drain.
+ */
+void imufifo_stop(imufifo_instance_t * imu);
+
+/**
+ * [imufifo_drain description]
+ * Read the samples waiting in the FIFO, at most IMUFIFO_BATCH, and pass them to the consumer.
+ * @return     [Samples read, -1 on bus error]
+ */
+int imufifo_drain(imufifo_instance_t * imu);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* _DW1000_IMUFIFO_H_ */
@@ -0,0 +1,262 @@
+/*
+ * Copyright 2018, Decawave Limited, All Rights Reserved
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+#include <string.h>
+#include <assert.h>
+#include <os/os.h>
+#include <hal/hal_i2c.h>
+#include "syscfg/syscfg.h"
+
+#include <imufifo/dw1000_imufifo.h>
+
+#define IMUFIFO_I2C_TIMEOUT (OS_TICKS_PER_SEC / 10)
+#define IMUFIFO_DRAIN_TICKS (OS_TICKS_PER_SEC * MYNEWT_VAL(IMUFIFO_BATCH) * 3 / (4 * MYNEWT_VAL(IMUFIFO_ODR_HZ)))
+#define GRAVITY 9.80665f
+
+#if MYNEWT_VAL(IMUFIFO_MPU6500)
+#define MPU6500_SMPLRT_DIV      0x19
+#define MPU6500_CONFIG          0x1A
+#define MPU6500_GYRO_CONFIG     0x1B
+#define MPU6500_ACCEL_CONFIG    0x1C
+#define MPU6500_FIFO_EN         0x23
+#define MPU6500_INT_STATUS      0x3A
+#define MPU6500_USER_CTRL       0x6A
+#define MPU6500_PWR_MGMT_1      0x6B
+#define MPU6500_FIFO_COUNTH     0x72
+#define MPU6500_FIFO_R_W        0x74
+
+#define MPU6500_FIFO_OFLOW_INT  0x10
+#define MPU6500_USER_FIFO_EN    0x40
+#define MPU6500_USER_FIFO_RST   0x04
+#define MPU6500_DIV (1000 / MYNEWT_VAL(IMUFIFO_ODR_HZ))
+#define IMUFIFO_PERIOD_USEC (1000UL * MPU6500_DIV)
+_Static_assert(MYNEWT_VAL(IMUFIFO_BATCH) * IMUFIFO_SAMPLE_SIZE <= 512, "IMUFIFO_BATCH exceeds the MPU-6500 FIFO");
+#else
+#define LSM6DSL_FIFO_CTRL3      0x08
+#define LSM6DSL_FIFO_CTRL5      0x0A
+#define LSM6DSL_CTRL1_XL        0x10
+#define LSM6DSL_CTRL2_G         0x11
+#define LSM6DSL_CTRL3_C         0x12
+#define LSM6DSL_FIFO_STATUS1    0x3A
+#define LSM6DSL_FIFO_DATA_OUT_L 0x3E
+
+#define LSM6DSL_CTRL3_BDU       0x40
+#define LSM6DSL_CTRL3_IF_INC    0x04
+#define LSM6DSL_FS_XL_4G        0x08
+#define LSM6DSL_FS_G_500DPS     0x04
+#define LSM6DSL_FIFO_CONTINUOUS 0x06
+#define LSM6DSL_STATUS2_OVER_RUN 0x40
+#define LSM6DSL_PATTERN_WORDS   6   // Gyro x, y, z then accel x, y, z
+
+#define LSM6DSL_ODR(hz) ((hz) <= 13 ? 1 : (hz) <= 26 ? 2 : (hz) <= 52 ? 3 : (hz) <= 104 ? 4 \
+                        : (hz) <= 208 ? 5 : (hz) <= 416 ? 6 : 7)
+static const uint32_t lsm6dsl_period_usec[] = {0, 80000, 38462, 19231, 9615, 4808, 2404, 1200};
+#define IMUFIFO_PERIOD_USEC lsm6dsl_period_usec[LSM6DSL_ODR(MYNEWT_VAL(IMUFIFO_ODR_HZ))]
+#endif
+
+static int
+imufifo_write_reg(imufifo_instance_t * imu, uint8_t reg, uint8_t value){
+    uint8_t buf[2] = {reg, value};
+    struct hal_i2c_master_data data = {
+        .address = imu->address,
+        .len = sizeof(buf),
+        .buffer = buf
+    };
+    return hal_i2c_master_write(imu->i2c_num, &data, IMUFIFO_I2C_TIMEOUT, 1);
+}
+
+/*
+ * Register address write and read with a repeated start, one bus transaction.
+ */
+static int
+imufifo_read(imufifo_instance_t * imu, uint8_t reg, uint8_t * buf, uint16_t len){
+    struct hal_i2c_master_data data = {
+        .address = imu->address,
+        .len = 1,
+        .buffer = &reg
+    };
+    int rc = hal_i2c_master_write(imu->i2c_num, &data, IMUFIFO_I2C_TIMEOUT, 0);
+    if (rc)
+        return rc;
+    data.len = len;
+    data.buffer = buf;
+    return hal_i2c_master_read(imu->i2c_num, &data, IMUFIFO_I2C_TIMEOUT, 1);
+}
+
+static void
+imufifo_callout_cb(struct os_event * ev){
+    imufifo_instance_t * imu = (imufifo_instance_t *) ev->ev_arg;
+
+    imufifo_drain(imu);
+    os_callout_reset(&imu->callout, IMUFIFO_DRAIN_TICKS);
+}
+
+int
+imufifo_init(imufifo_instance_t * imu, imufifo_cb_t * cb, void * arg){
+    int rc;
+    assert(imu);
+
+    memset(imu, 0, sizeof(imufifo_instance_t));
+    imu->i2c_num = MYNEWT_VAL(IMUFIFO_I2C_NUM);
+    imu->address = MYNEWT_VAL(IMUFIFO_I2C_ADDR);
+    imu->cb = cb;
+    imu->cb_arg = arg;
+    imu->batch.period = IMUFIFO_PERIOD_USEC;
+    os_callout_init(&imu->callout, os_eventq_dflt_get(), imufifo_callout_cb, imu);
+
+#if MYNEWT_VAL(IMUFIFO_MPU6500)
+    imu->accel_scale = 4 * GRAVITY / 32768;
+    imu->gyro_scale = 500.0f / 32768;
+    const uint8_t config[][2] = {
+        {MPU6500_PWR_MGMT_1, 0x01},                             // PLL clock
+        {MPU6500_SMPLRT_DIV, MPU6500_DIV - 1},
+        {MPU6500_CONFIG, 0x01},                                 // 184Hz DLPF, 1kHz internal rate, FIFO overwrites when full
+        {MPU6500_GYRO_CONFIG, 0x08},                            // ±500deg/s
+        {MPU6500_ACCEL_CONFIG, 0x08},                           // ±4g
+        {MPU6500_FIFO_EN, 0x78}                                 // Gyro x, y, z and accel
+    };
+#else
+    imu->accel_scale = 0.122e-3f * GRAVITY;
+    imu->gyro_scale = 17.5e-3f;
+    const uint8_t config[][2] = {
+        {LSM6DSL_CTRL3_C, LSM6DSL_CTRL3_BDU | LSM6DSL_CTRL3_IF_INC},
+        {LSM6DSL_CTRL1_XL, (LSM6DSL_ODR(MYNEWT_VAL(IMUFIFO_ODR_HZ)) << 4) | LSM6DSL_FS_XL_4G},
+        {LSM6DSL_CTRL2_G, (LSM6DSL_ODR(MYNEWT_VAL(IMUFIFO_ODR_HZ)) << 4) | LSM6DSL_FS_G_500DPS},
+        {LSM6DSL_FIFO_CTRL3, 0x09}                              // Gyro and accel, no decimation
+    };
+#endif
+    for (uint8_t i = 0; i < sizeof(config)/sizeof(config[0]); i++)
+        if ((rc = imufifo_write_reg(imu, config[i][0], config[i][1])) != 0)
+            return rc;
+    return 0;
+}
+
+void
+imufifo_set_clock(imufifo_instance_t * imu, imufifo_clock_fn * clock, void * arg){
+    imu->clock = clock;
+    imu->clock_arg = arg;
+}
+
+/*
+ * Empty the FIFO and (re)start collecting.
+ */
+static int
+imufifo_flush(imufifo_instance_t * imu){
+#if MYNEWT_VAL(IMUFIFO_MPU6500)
+    int rc = imufifo_write_reg(imu, MPU6500_USER_CTRL, MPU6500_USER_FIFO_RST);
+    if (rc == 0)
+        rc = imufifo_write_reg(imu, MPU6500_USER_CTRL, MPU6500_USER_FIFO_EN);
+#else
+    // Bypass mode empties the FIFO
+    int rc = imufifo_write_reg(imu, LSM6DSL_FIFO_CTRL5, 0);
+    if (rc == 0)
+        rc = imufifo_write_reg(imu, LSM6DSL_FIFO_CTRL5,
+                (LSM6DSL_ODR(MYNEWT_VAL(IMUFIFO_ODR_HZ)) << 3) | LSM6DSL_FIFO_CONTINUOUS);
+#endif
+    return rc;
+}
+
+void
+imufifo_start(imufifo_instance_t * imu){
+    if (imufifo_flush(imu) != 0)
+        imu->nerrors++;
+    os_callout_reset(&imu->callout, IMUFIFO_DRAIN_TICKS);
+}
+
+void
+imufifo_stop(imufifo_instance_t * imu){
+    os_callout_stop(&imu->callout);
+}
+
+int
+imufifo_drain(imufifo_instance_t * imu){
+    imufifo_batch_t * batch = &imu->batch;
+    uint8_t status[4];
+    uint16_t nsamples;
+    int rc;
+
+    batch->cputime = os_cputime_get32();
+#if MYNEWT_VAL(IMUFIFO_MPU6500)
+    if ((rc = imufifo_read(imu, MPU6500_INT_STATUS, status, 1)) != 0)
+        goto err;
+    if (status[0] & MPU6500_FIFO_OFLOW_INT){
+        imu->noverruns++;
+        imufifo_flush(imu);
+        return 0;
+    }
+    if ((rc = imufifo_read(imu, MPU6500_FIFO_COUNTH, status, 2)) != 0)
+        goto err;
+    nsamples = (((status[0] & 0x1F) << 8) | status[1]) / IMUFIFO_SAMPLE_SIZE;
+    if (nsamples > MYNEWT_VAL(IMUFIFO_BATCH))
+        nsamples = MYNEWT_VAL(IMUFIFO_BATCH);
+    if (nsamples && (rc = imufifo_read(imu, MPU6500_FIFO_R_W, imu->buf, nsamples * IMUFIFO_SAMPLE_SIZE)) != 0)
+        goto err;
+    // Big endian, accel x, y, z then gyro x, y, z
+    for (uint16_t i = 0; i < nsamples; i++){
+        const uint8_t * p = &imu->buf[i * IMUFIFO_SAMPLE_SIZE];
+        for (uint8_t j = 0; j < 3; j++){
+            batch->samples[i].accel[j] = (int16_t)((p[2 * j] << 8) | p[2 * j + 1]);
+            batch->samples[i].gyro[j] = (int16_t)((p[6 + 2 * j] << 8) | p[6 + 2 * j + 1]);
+        }
+    }
+#else
+    // FIFO_STATUS1-4: unread words, overrun flag and the pattern index of the next word
+    if ((rc = imufifo_read(imu, LSM6DSL_FIFO_STATUS1, status, 4)) != 0)
+        goto err;
+    if (status[1] & LSM6DSL_STATUS2_OVER_RUN)
+        imu->noverruns++;
+    uint16_t nwords = ((status[1] & 0x07) << 8) | status[0];
+    uint16_t pattern = ((status[3] & 0x03) << 8) | status[2];
+    if (pattern){
+        // Realign on a sample boundary, only after an overrun
+        uint16_t skip = LSM6DSL_PATTERN_WORDS - pattern;
+        if (skip > nwords)
+            return 0;
+        if ((rc = imufifo_read(imu, LSM6DSL_FIFO_DATA_OUT_L, imu->buf, 2 * skip)) != 0)
+            goto err;
+        nwords -= skip;
+    }
+    nsamples = nwords / LSM6DSL_PATTERN_WORDS;
+    if (nsamples > MYNEWT_VAL(IMUFIFO_BATCH))
+        nsamples = MYNEWT_VAL(IMUFIFO_BATCH);
+    // FIFO_DATA_OUT_H rolls back to FIFO_DATA_OUT_L, the batch is one burst
+    if (nsamples && (rc = imufifo_read(imu, LSM6DSL_FIFO_DATA_OUT_L, imu->buf, nsamples * IMUFIFO_SAMPLE_SIZE)) != 0)
+        goto err;
+    // Little endian, gyro x, y, z then accel x, y, z
+    for (uint16_t i = 0; i < nsamples; i++){
+        const uint8_t * p = &imu->buf[i * IMUFIFO_SAMPLE_SIZE];
+        for (uint8_t j = 0; j < 3; j++){
+            batch->samples[i].gyro[j] = (int16_t)(p[2 * j] | (p[2 * j + 1] << 8));
+            batch->samples[i].accel[j] = (int16_t)(p[6 + 2 * j] | (p[6 + 2 * j + 1] << 8));
+        }
+    }
+#endif
+    batch->nsamples = nsamples;
+    if (nsamples == 0)
+        return 0;
+    batch->timestamp = imu->clock ? imu->clock(imu->clock_arg, batch->cputime) : 0;
+    imu->nbatches++;
+    if (imu->cb)
+        imu->cb(imu, batch, imu->cb_arg);
+    return nsamples;
+err:
+    imu->nerrors++;
+    return -1;
+}
@@ -0,0 +1,104 @@
+/**
+ * Copyright 2018, Decawave Limited, All Rights Reserved
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _DW1000_LINKSTATS_H_
+#define _DW1000_LINKSTATS_H_
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "syscfg/syscfg.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <os/os.h>
+
+/*
+ * Running range statistics per (src, dst) link in a fixed open addressed
+ * table: Welford mean and variance, min/max and the share of rounds the link
+ * answered. Every LINKSTATS_PERIOD_MS one summary line is printed and the
+ * statistics restart:
+ *
+ * {"utime": 123456,"linkstats": [[src,dst,n,nmiss,mean_mm,std_mm,min_mm,max_mm],...]}
+ */
+
+typedef struct _linkstats_link_t{
+    uint16_t src_address;
+    uint16_t dst_address;
+    uint16_t used:1;
+    uint16_t round;                 // Last round the link answered in
+    uint32_t n;
+    uint32_t nmiss;
+    float mean;                     // mm
+    float m2;                       // Sum of squared deviations, mm^2
+    int32_t min;
+    int32_t max;
+}linkstats_link_t;
+
+typedef struct _linkstats_instance_t{
+    uint16_t round;
+    uint32_t ndropped;              // Samples of links beyond LINKSTATS_NLINKS
+    struct os_callout callout;
+    linkstats_link_t links[MYNEWT_VAL(LINKSTATS_NLINKS)];
+}linkstats_instance_t;
+
+/**
+ * [linkstats_init description]
+ * Clear the table and start the periodic summary on the default event queue.
+ * @param  stats [Statistics instance]
+ * @return       [Statistics instance]
+ */
+linkstats_instance_t * linkstats_init(linkstats_instance_t * stats);
+
+/**
+ * [linkstats_update description]
+ * Add a range to the statistics of a link, O(1).
+ * @param  stats       [Statistics instance]
+ * @param  src_address [Initiator]
+ * @param  dst_address [Responder]
+ * @param  range_mm    [Range in mm]
+ */
+void linkstats_update(linkstats_instance_t * stats, uint16_t src_address, uint16_t dst_address, int32_t range_mm);
+
+/**
+ * [linkstats_round description]
+ * Close a ranging round, links that did not answer in it count a miss.
+ */
+void linkstats_round(linkstats_instance_t * stats);
+
+/**
+ * [linkstats_find description]
+ * Statistics of a link, NULL if untracked.
+ */
+const linkstats_link_t * linkstats_find(linkstats_instance_t * stats, uint16_t src_address, uint16_t dst_address);
+
+/**
+ * [linkstats_summary description]
+ * Print the summary line and restart the statistics, done periodically.
+ */
+void linkstats_summary(linkstats_instance_t * stats);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* _DW1000_LINKSTATS_H_ */
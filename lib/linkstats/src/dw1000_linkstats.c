@@ -0,0 +1,153 @@
+/*
+ * Copyright 2018, Decawave Limited, All Rights Reserved
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <math.h>
+#include <os/os.h>
+#include "syscfg/syscfg.h"
+
+#include <linkstats/dw1000_linkstats.h>
+
+#define LINKSTATS_NLINKS MYNEWT_VAL(LINKSTATS_NLINKS)
+_Static_assert((LINKSTATS_NLINKS & (LINKSTATS_NLINKS - 1)) == 0, "LINKSTATS_NLINKS must be a power of 2");
+
+static linkstats_link_t *
+linkstats_lookup(linkstats_instance_t * stats, uint16_t src_address, uint16_t dst_address, bool insert){
+    uint32_t key = ((uint32_t) src_address << 16) | dst_address;
+    uint32_t h = (key * 2654435761UL) >> 16;
+
+    for (uint16_t i = 0; i < LINKSTATS_NLINKS; i++){
+        linkstats_link_t * link = &stats->links[(h + i) & (LINKSTATS_NLINKS - 1)];
+        if (!link->used){
+            if (!insert)
+                return NULL;
+            link->used = 1;
+            link->src_address = src_address;
+            link->dst_address = dst_address;
+            link->round = stats->round - 1;
+            return link;
+        }
+        if (link->src_address == src_address && link->dst_address == dst_address)
+            return link;
+    }
+    return NULL;
+}
+
+static void
+linkstats_restart(linkstats_link_t * link){
+    link->n = 0;
+    link->nmiss = 0;
+    link->mean = 0;
+    link->m2 = 0;
+    link->min = INT32_MAX;
+    link->max = INT32_MIN;
+}
+
+static void
+linkstats_callout_cb(struct os_event * ev){
+    linkstats_instance_t * stats = (linkstats_instance_t *) ev->ev_arg;
+
+    linkstats_summary(stats);
+    os_callout_reset(&stats->callout, OS_TICKS_PER_SEC * MYNEWT_VAL(LINKSTATS_PERIOD_MS) / 1000);
+}
+
+linkstats_instance_t *
+linkstats_init(linkstats_instance_t * stats){
+    assert(stats);
+
+    memset(stats, 0, sizeof(linkstats_instance_t));
+    os_callout_init(&stats->callout, os_eventq_dflt_get(), linkstats_callout_cb, stats);
+    os_callout_reset(&stats->callout, OS_TICKS_PER_SEC * MYNEWT_VAL(LINKSTATS_PERIOD_MS) / 1000);
+    return stats;
+}
+
+void
+linkstats_update(linkstats_instance_t * stats, uint16_t src_address, uint16_t dst_address, int32_t range_mm){
+    os_sr_t sr;
+    OS_ENTER_CRITICAL(sr);
+    linkstats_link_t * link = linkstats_lookup(stats, src_address, dst_address, true);
+    if (link == NULL){
+        stats->ndropped++;
+        OS_EXIT_CRITICAL(sr);
+        return;
+    }
+    if (link->n == 0 && link->nmiss == 0)
+        linkstats_restart(link);
+
+    float x = (float) range_mm;
+    float delta = x - link->mean;
+    link->n++;
+    link->mean += delta / link->n;
+    link->m2 += delta * (x - link->mean);
+    if (range_mm < link->min)
+        link->min = range_mm;
+    if (range_mm > link->max)
+        link->max = range_mm;
+    link->round = stats->round;
+    OS_EXIT_CRITICAL(sr);
+}
+
+void
+linkstats_round(linkstats_instance_t * stats){
+    os_sr_t sr;
+    OS_ENTER_CRITICAL(sr);
+    for (uint16_t i = 0; i < LINKSTATS_NLINKS; i++){
+        linkstats_link_t * link = &stats->links[i];
+        if (link->used && link->round != stats->round){
+            if (link->n == 0 && link->nmiss == 0)
+                linkstats_restart(link);
+            link->nmiss++;
+        }
+    }
+    stats->round++;
+    OS_EXIT_CRITICAL(sr);
+}
+
+const linkstats_link_t *
+linkstats_find(linkstats_instance_t * stats, uint16_t src_address, uint16_t dst_address){
+    return linkstats_lookup(stats, src_address, dst_address, false);
+}
+
+void
+linkstats_summary(linkstats_instance_t * stats){
+    bool first = true;
+
+    printf("{\"utime\": %lu,\"linkstats\": [", os_cputime_ticks_to_usecs(os_cputime_get32()));
+    for (uint16_t i = 0; i < LINKSTATS_NLINKS; i++){
+        linkstats_link_t link;
+        os_sr_t sr;
+        OS_ENTER_CRITICAL(sr);
+        link = stats->links[i];
+        if (link.used)
+            linkstats_restart(&stats->links[i]);
+        OS_EXIT_CRITICAL(sr);
+        if (!link.used || (link.n == 0 && link.nmiss == 0))
+            continue;
+        float std = (link.n > 1) ? sqrtf(link.m2 / (link.n - 1)) : 0;
+        printf("%s[%u,%u,%lu,%lu,%ld,%lu,%ld,%ld]", first ? "" : ",",
+                link.src_address, link.dst_address, link.n, link.nmiss,
+                (int32_t) lroundf(link.mean), (uint32_t) lroundf(std),
+                link.n ? link.min : 0, link.n ? link.max : 0);
+        first = false;
+    }
+    printf("]}\n");
+}
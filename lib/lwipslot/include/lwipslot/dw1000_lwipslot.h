@@ -0,0 +1,108 @@
+/**
+ * Copyright 2018, Decawave Limited, All Rights Reserved
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _DW1000_LWIPSLOT_H_
+#define _DW1000_LWIPSLOT_H_
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "syscfg/syscfg.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <os/os.h>
+#include <dw1000/dw1000_dev.h>
+#include <dw1000/dw1000_lwip.h>
+#include <tdma/dw1000_tdma.h>
+
+/*
+ * A queued frame references the caller's payload, it is not copied. The
+ * buffer must stay untouched until lwipslot_pending() no longer counts it.
+ */
+typedef struct _lwipslot_frame_t{
+    ip_addr_t * ip_addr;
+    void * payload;
+    uint16_t len;
+    uint16_t dst_addr;              // 802.15.4 short address of the next hop
+}lwipslot_frame_t;
+
+typedef struct _lwipslot_status_t{
+    uint16_t initialized:1;
+    uint16_t overrun:1;             // lwipslot_send found the queue full
+    uint16_t start_tx_error:1;      // Last slot was missed, the frame is retried in the next one
+}lwipslot_status_t;
+
+typedef struct _lwipslot_instance_t{
+    struct _dw1000_dev_instance_t * parent;
+    tdma_instance_t * tdma;
+    lwipslot_status_t status;
+    uint16_t head;
+    uint16_t tail;
+    uint32_t nsent;
+    uint32_t nlate;
+    uint32_t noverrun;
+    lwipslot_frame_t frames[MYNEWT_VAL(LWIPSLOT_QUEUE_LEN)];
+}lwipslot_instance_t;
+
+/**
+ * [lwipslot_init description]
+ * Attach to the tdma instance of the device. One lwipslot instance per device.
+ * @param  slot [lwipslot instance]
+ * @param  inst [dw1000 instance, lwip and ccp must already be initialised]
+ * @param  tdma [tdma instance]
+ * @return      [lwipslot instance]
+ */
+lwipslot_instance_t * lwipslot_init(lwipslot_instance_t * slot, struct _dw1000_dev_instance_t * inst, tdma_instance_t * tdma);
+
+/**
+ * [lwipslot_assign description]
+ * Reserve a tdma slot for data. At most one queued frame is sent per assigned slot,
+ * delayed to the slot start derived from the ccp epoch.
+ * @param  slot [lwipslot instance]
+ * @param  idx  [Slot index within the tdma period]
+ */
+void lwipslot_assign(lwipslot_instance_t * slot, uint16_t idx);
+
+/**
+ * [lwipslot_send description]
+ * Queue a payload for the next assigned data slot.
+ * @param  slot     [lwipslot instance]
+ * @param  dst_addr [802.15.4 short address of the next hop]
+ * @param  ip_addr  [Destination address]
+ * @param  payload  [Payload, referenced until sent]
+ * @param  len      [Payload length, at most LWIPSLOT_MAX_PAYLOAD]
+ * @return          [0 on success, -1 if the queue is full or the payload too long]
+ */
+int lwipslot_send(lwipslot_instance_t * slot, uint16_t dst_addr, ip_addr_t * ip_addr, void * payload, uint16_t len);
+
+/**
+ * [lwipslot_pending description]
+ * Number of frames waiting for a slot.
+ */
+uint16_t lwipslot_pending(lwipslot_instance_t * slot);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* _DW1000_LWIPSLOT_H_ */
@@ -0,0 +1,138 @@
+/*
+ * Copyright 2018, Decawave Limited, All Rights Reserved
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <os/os.h>
+#include "syscfg/syscfg.h"
+
+#include <dw1000/dw1000_dev.h>
+#include <dw1000/dw1000_hal.h>
+#include <dw1000/dw1000_mac.h>
+#include <dw1000/dw1000_lwip.h>
+#include <ccp/dw1000_ccp.h>
+#include <tdma/dw1000_tdma.h>
+#include <lwipslot/dw1000_lwipslot.h>
+
+#define LWIPSLOT_QUEUE_LEN MYNEWT_VAL(LWIPSLOT_QUEUE_LEN)
+
+static lwipslot_instance_t * g_lwipslot;
+
+/*
+ * Slot callback, runs ahead of the slot on the tdma event queue. The head of
+ * the queue is handed to lwIP with a delayed start pending, so the 6LoWPAN
+ * frame leaves at the slot start derived from the ccp epoch rather than
+ * whenever the application produced it.
+ */
+static void
+lwipslot_slot_cb(struct os_event * ev){
+    assert(ev);
+
+    tdma_slot_t * tdma_slot = (tdma_slot_t *) ev->ev_arg;
+    tdma_instance_t * tdma = tdma_slot->parent;
+    dw1000_dev_instance_t * inst = tdma->parent;
+    dw1000_ccp_instance_t * ccp = inst->ccp;
+    lwipslot_instance_t * slot = (lwipslot_instance_t *) tdma_slot->arg;
+    uint16_t idx = tdma_slot->idx;
+
+    if (slot == NULL || slot->tail == slot->head)
+        return;
+
+    lwipslot_frame_t * frame = &slot->frames[slot->tail % LWIPSLOT_QUEUE_LEN];
+
+    uint64_t dx_time = ccp->epoch + (idx * ((uint64_t)tdma->period << 16))/tdma->nslots
+                        + ((uint64_t)MYNEWT_VAL(LWIPSLOT_GUARD) << 16);
+    dx_time = dx_time & 0xFFFFFFFE00UL;
+
+    inst->lwip->status.start_tx_error = 0;
+    inst->lwip->dst_addr = frame->dst_addr;
+    dw1000_set_delay_start(inst, dx_time);
+    dw1000_lwip_send(inst, frame->len, (char *)frame->payload, frame->ip_addr);
+
+    if (inst->lwip->status.start_tx_error){
+        /* Slot missed, keep the frame for the next one */
+        slot->status.start_tx_error = 1;
+        slot->nlate++;
+        return;
+    }
+    slot->status.start_tx_error = 0;
+    slot->nsent++;
+
+    os_sr_t sr;
+    OS_ENTER_CRITICAL(sr);
+    slot->tail++;
+    OS_EXIT_CRITICAL(sr);
+}
+
+lwipslot_instance_t *
+lwipslot_init(lwipslot_instance_t * slot, dw1000_dev_instance_t * inst, tdma_instance_t * tdma){
+    assert(slot);
+    assert(inst);
+    assert(tdma);
+    assert(inst->lwip);
+    assert(g_lwipslot == NULL || g_lwipslot == slot);
+
+    memset(slot, 0, sizeof(lwipslot_instance_t));
+    slot->parent = inst;
+    slot->tdma = tdma;
+    slot->status.initialized = 1;
+    g_lwipslot = slot;
+    return slot;
+}
+
+void
+lwipslot_assign(lwipslot_instance_t * slot, uint16_t idx){
+    assert(slot->status.initialized);
+    assert(idx < slot->tdma->nslots);
+
+    tdma_assign_slot(slot->tdma, lwipslot_slot_cb, idx, slot);
+}
+
+int
+lwipslot_send(lwipslot_instance_t * slot, uint16_t dst_addr, ip_addr_t * ip_addr, void * payload, uint16_t len){
+    assert(slot->status.initialized);
+
+    if (len > MYNEWT_VAL(LWIPSLOT_MAX_PAYLOAD))
+        return -1;
+
+    os_sr_t sr;
+    OS_ENTER_CRITICAL(sr);
+    if ((uint16_t)(slot->head - slot->tail) == LWIPSLOT_QUEUE_LEN){
+        OS_EXIT_CRITICAL(sr);
+        slot->status.overrun = 1;
+        slot->noverrun++;
+        return -1;
+    }
+    slot->frames[slot->head % LWIPSLOT_QUEUE_LEN] = (lwipslot_frame_t){
+        .ip_addr = ip_addr,
+        .payload = payload,
+        .len = len,
+        .dst_addr = dst_addr
+    };
+    slot->head++;
+    OS_EXIT_CRITICAL(sr);
+    return 0;
+}
+
+uint16_t
+lwipslot_pending(lwipslot_instance_t * slot){
+    return (uint16_t)(slot->head - slot->tail);
+}
@@ -0,0 +1,110 @@
+/**
+ * Copyright 2018, Decawave Limited, All Rights Reserved
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _DW1000_MLAT_H_
+#define _DW1000_MLAT_H_
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "syscfg/syscfg.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Position from the ranges of one round to anchors at known positions.
+ * Gauss-Newton least squares on the range residuals, warm started from the
+ * last good fix and cold started from the centroid of the anchors heard.
+ */
+
+#define MLAT_DIM ((MYNEWT_VAL(MLAT_3D)) ? 3 : 2)
+
+typedef enum _mlat_status_t{
+    MLAT_OK = 0,
+    MLAT_HIGH_RESIDUAL,             // Converged, rms residual above MLAT_MAX_RESIDUAL_MM
+    MLAT_NO_CONVERGENCE,            // Iteration limit reached
+    MLAT_SINGULAR,                  // Anchor geometry degenerate
+    MLAT_TOO_FEW                    // Fewer known anchors than MLAT_DIM + 1
+}mlat_status_t;
+
+typedef struct _mlat_anchor_t{
+    uint16_t address;
+    int32_t x;                      // mm
+    int32_t y;
+    int32_t z;
+}mlat_anchor_t;
+
+typedef struct _mlat_range_t{
+    uint16_t address;               // Anchor
+    float range;                    // m
+}mlat_range_t;
+
+typedef struct _mlat_fix_t{
+    float x;                        // m
+    float y;
+    float z;
+    float rms;                      // RMS range residual, m
+    uint16_t nranges;               // Ranges used
+    uint16_t niter;
+    mlat_status_t status;
+}mlat_fix_t;
+
+typedef struct _mlat_instance_t{
+    uint16_t nanchors;
+    uint16_t warm:1;                // Last fix usable as a starting point
+    float position[3];
+    mlat_anchor_t anchors[MYNEWT_VAL(MLAT_NANCHORS)];
+}mlat_instance_t;
+
+/**
+ * [mlat_init description]
+ * Load the anchor table, at most MLAT_NANCHORS entries are kept.
+ * @param  mlat     [Solver instance]
+ * @param  anchors  [Anchor table, may be NULL]
+ * @param  nanchors [Anchors]
+ * @return          [Solver instance]
+ */
+mlat_instance_t * mlat_init(mlat_instance_t * mlat, const mlat_anchor_t * anchors, uint16_t nanchors);
+
+/**
+ * [mlat_anchor_set description]
+ * Add or move an anchor.
+ * @return          [0 on success, -1 if the table is full]
+ */
+int mlat_anchor_set(mlat_instance_t * mlat, uint16_t address, int32_t x, int32_t y, int32_t z);
+
+/**
+ * [mlat_solve description]
+ * Solve for the position from a round of ranges, ranges to unknown anchors are ignored.
+ * @param  mlat    [Solver instance]
+ * @param  ranges  [Ranges of the round]
+ * @param  nranges [Ranges]
+ * @param  fix     [Position and quality]
+ * @return         [fix->status]
+ */
+mlat_status_t mlat_solve(mlat_instance_t * mlat, const mlat_range_t * ranges, uint16_t nranges, mlat_fix_t * fix);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* _DW1000_MLAT_H_ */
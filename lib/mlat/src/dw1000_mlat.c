@@ -0,0 +1,183 @@
+/*
+ * Copyright 2018, Decawave Limited, All Rights Reserved
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+#include <string.h>
+#include <assert.h>
+#include <math.h>
+#include "syscfg/syscfg.h"
+
+#include <mlat/dw1000_mlat.h>
+
+#define MLAT_TOLERANCE 1e-3f        // m, step length ending the iteration
+#define MLAT_MIN_DET 1e-9f
+
+static const mlat_anchor_t *
+mlat_anchor_find(const mlat_instance_t * mlat, uint16_t address){
+    for (uint16_t i = 0; i < mlat->nanchors; i++)
+        if (mlat->anchors[i].address == address)
+            return &mlat->anchors[i];
+    return NULL;
+}
+
+mlat_instance_t *
+mlat_init(mlat_instance_t * mlat, const mlat_anchor_t * anchors, uint16_t nanchors){
+    assert(mlat);
+
+    memset(mlat, 0, sizeof(mlat_instance_t));
+    for (uint16_t i = 0; anchors && i < nanchors; i++)
+        mlat_anchor_set(mlat, anchors[i].address, anchors[i].x, anchors[i].y, anchors[i].z);
+    return mlat;
+}
+
+int
+mlat_anchor_set(mlat_instance_t * mlat, uint16_t address, int32_t x, int32_t y, int32_t z){
+    mlat_anchor_t * anchor = (mlat_anchor_t *) mlat_anchor_find(mlat, address);
+
+    if (anchor == NULL){
+        if (mlat->nanchors == MYNEWT_VAL(MLAT_NANCHORS))
+            return -1;
+        anchor = &mlat->anchors[mlat->nanchors++];
+        anchor->address = address;
+    }
+    anchor->x = x;
+    anchor->y = y;
+    anchor->z = z;
+    mlat->warm = 0;
+    return 0;
+}
+
+/*
+ * Solve the symmetric system A x = b of dimension MLAT_DIM by cofactors.
+ */
+static int
+mlat_solve_normal(float A[3][3], const float b[3], float x[3]){
+#if MYNEWT_VAL(MLAT_3D)
+    float c00 = A[1][1] * A[2][2] - A[1][2] * A[2][1];
+    float c01 = A[1][2] * A[2][0] - A[1][0] * A[2][2];
+    float c02 = A[1][0] * A[2][1] - A[1][1] * A[2][0];
+    float det = A[0][0] * c00 + A[0][1] * c01 + A[0][2] * c02;
+    if (fabsf(det) < MLAT_MIN_DET)
+        return -1;
+    float c11 = A[0][0] * A[2][2] - A[0][2] * A[2][0];
+    float c12 = A[0][1] * A[2][0] - A[0][0] * A[2][1];
+    float c22 = A[0][0] * A[1][1] - A[0][1] * A[1][0];
+    x[0] = (c00 * b[0] + c01 * b[1] + c02 * b[2]) / det;
+    x[1] = (c01 * b[0] + c11 * b[1] + c12 * b[2]) / det;
+    x[2] = (c02 * b[0] + c12 * b[1] + c22 * b[2]) / det;
+#else
+    float det = A[0][0] * A[1][1] - A[0][1] * A[1][0];
+    if (fabsf(det) < MLAT_MIN_DET)
+        return -1;
+    x[0] = (A[1][1] * b[0] - A[0][1] * b[1]) / det;
+    x[1] = (A[0][0] * b[1] - A[1][0] * b[0]) / det;
+    x[2] = 0;
+#endif
+    return 0;
+}
+
+/*
+ * Residuals at p, accumulating the normal equations of the range Jacobian when
+ * A and b are given. Returns the sum of squared residuals.
+ */
+static float
+mlat_residuals(const mlat_instance_t * mlat, const mlat_range_t * ranges, uint16_t nranges,
+        const float p[3], float A[3][3], float b[3]){
+    float sse = 0;
+
+    for (uint16_t i = 0; i < nranges; i++){
+        const mlat_anchor_t * anchor = mlat_anchor_find(mlat, ranges[i].address);
+        if (anchor == NULL)
+            continue;
+        float d[3] = {p[0] - anchor->x / 1000.0f, p[1] - anchor->y / 1000.0f, p[2] - anchor->z / 1000.0f};
+        float r = sqrtf(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+        float res = ranges[i].range - r;
+        sse += res * res;
+        if (A == NULL || r < MLAT_TOLERANCE)
+            continue;
+        for (uint8_t j = 0; j < MLAT_DIM; j++){
+            float Jj = d[j] / r;
+            b[j] += Jj * res;
+            for (uint8_t k = 0; k < MLAT_DIM; k++)
+                A[j][k] += Jj * d[k] / r;
+        }
+    }
+    return sse;
+}
+
+mlat_status_t
+mlat_solve(mlat_instance_t * mlat, const mlat_range_t * ranges, uint16_t nranges, mlat_fix_t * fix){
+    float p[3] = {0, 0, MYNEWT_VAL(MLAT_Z_MM) / 1000.0f};
+    uint16_t n = 0;
+
+    memset(fix, 0, sizeof(mlat_fix_t));
+    for (uint16_t i = 0; i < nranges; i++){
+        const mlat_anchor_t * anchor = mlat_anchor_find(mlat, ranges[i].address);
+        if (anchor == NULL)
+            continue;
+        p[0] += anchor->x / 1000.0f;
+        p[1] += anchor->y / 1000.0f;
+        n++;
+    }
+    fix->nranges = n;
+    if (n < MLAT_DIM + 1){
+        fix->status = MLAT_TOO_FEW;
+        return fix->status;
+    }
+    if (mlat->warm){
+        p[0] = mlat->position[0];
+        p[1] = mlat->position[1];
+        p[2] = mlat->position[2];
+    }else{
+        p[0] /= n;
+        p[1] /= n;
+    }
+
+    fix->status = MLAT_NO_CONVERGENCE;
+    for (fix->niter = 1; fix->niter <= MYNEWT_VAL(MLAT_MAX_ITER); fix->niter++){
+        float A[3][3] = {{0}}, b[3] = {0}, delta[3];
+        mlat_residuals(mlat, ranges, nranges, p, A, b);
+        if (mlat_solve_normal(A, b, delta) != 0){
+            fix->status = MLAT_SINGULAR;
+            break;
+        }
+        p[0] += delta[0];
+        p[1] += delta[1];
+        p[2] += delta[2];
+        if (sqrtf(delta[0] * delta[0] + delta[1] * delta[1] + delta[2] * delta[2]) < MLAT_TOLERANCE){
+            fix->status = MLAT_OK;
+            break;
+        }
+    }
+
+    fix->x = p[0];
+    fix->y = p[1];
+    fix->z = p[2];
+    fix->rms = sqrtf(mlat_residuals(mlat, ranges, nranges, p, NULL, NULL) / n);
+    if (fix->status == MLAT_OK && fix->rms > MYNEWT_VAL(MLAT_MAX_RESIDUAL_MM) / 1000.0f)
+        fix->status = MLAT_HIGH_RESIDUAL;
+
+    mlat->warm = (fix->status == MLAT_OK);
+    if (mlat->warm){
+        mlat->position[0] = p[0];
+        mlat->position[1] = p[1];
+        mlat->position[2] = p[2];
+    }
+    return fix->status;
+}
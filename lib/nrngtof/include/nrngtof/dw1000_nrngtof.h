@@ -0,0 +1,62 @@
+/**
+ * Copyright 2018, Decawave Limited, All Rights Reserved
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _DW1000_NRNGTOF_H_
+#define _DW1000_NRNGTOF_H_
+
+#include <stdlib.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <dw1000/dw1000_ftypes.h>
+
+/*
+ * Frame codes of the nranges exchange, following the DS_TWR codes of the driver.
+ */
+typedef enum _dw1000_nranges_modes_t{
+    DWT_DS_TWR_NRNG = 17,
+    DWT_DS_TWR_NRNG_T1,
+    DWT_DS_TWR_NRNG_T2,
+    DWT_DS_TWR_NRNG_FINAL,
+    DWT_DS_TWR_NRNG_END,
+    DWT_DS_TWR_NRNG_EXT,
+    DWT_DS_TWR_NRNG_EXT_T1,
+    DWT_DS_TWR_NRNG_EXT_T2,
+    DWT_DS_TWR_NRNG_EXT_FINAL,
+    DWT_DS_TWR_NRNG_EXT_END
+}dw1000_nranges_modes_t;
+
+/**
+ * [dw1000_nranges_twr_to_tof_frames description]
+ * Double sided ToF of one responder of an nranges round.
+ * @param  first_frame [Frame of the first exchange]
+ * @param  final_frame [Frame of the final exchange]
+ * @return             [ToF in dw1000 time units, 0 if final_frame is not an nranges code]
+ */
+float dw1000_nranges_twr_to_tof_frames(const twr_frame_t * first_frame, const twr_frame_t * final_frame);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* _DW1000_NRNGTOF_H_ */
@@ -0,0 +1,48 @@
+/*
+ * Copyright 2018, Decawave Limited, All Rights Reserved
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+#include <assert.h>
+
+#include <nrngtof/dw1000_nrngtof.h>
+
+float
+dw1000_nranges_twr_to_tof_frames(const twr_frame_t * first_frame, const twr_frame_t * final_frame){
+    float ToF = 0;
+    uint64_t T1R, T1r, T2R, T2r;
+    int64_t nom,denom;
+
+    assert(first_frame != NULL);
+    assert(final_frame != NULL);
+
+    switch(final_frame->code){
+        case DWT_DS_TWR_NRNG ... DWT_DS_TWR_NRNG_END:
+        case DWT_DS_TWR_NRNG_EXT ... DWT_DS_TWR_NRNG_EXT_END:
+            T1R = (first_frame->response_timestamp - first_frame->request_timestamp);
+            T1r = (first_frame->transmission_timestamp  - first_frame->reception_timestamp);
+            T2R = (final_frame->response_timestamp - final_frame->request_timestamp);
+            T2r = (final_frame->transmission_timestamp - final_frame->reception_timestamp);
+            nom = T1R * T2R  - T1r * T2r;
+            denom = T1R + T2R  + T1r + T2r;
+            ToF = (float) (nom) / denom;
+            break;
+        default: break;
+    }
+    return ToF;
+}
@@ -0,0 +1,106 @@
+/**
+ * Copyright 2018, Decawave Limited, All Rights Reserved
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _DW1000_PANCACHE_H_
+#define _DW1000_PANCACHE_H_
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <os/os.h>
+#include "syscfg/syscfg.h"
+#include <dw1000/dw1000_dev.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Cache of the PAN assignment in sys/config under pan/addr, pan/panid and
+ * pan/slot. A device with a cached assignment resumes with it at boot and runs
+ * the PAN exchange in the background, a new assignment from the master
+ * replaces the cached one. A device without one joins as before, blocking on
+ * the exchange, and caches the result. The exchange is dw1000_pan_start()
+ * unless the application sets its own with pancache_set_start(), e.g.
+ * panjoin_start() when lib/panjoin is enabled as well.
+ */
+
+struct _pancache_instance_t;
+typedef void (*pancache_start_cb_t)(struct _pancache_instance_t * cache);
+
+typedef struct _pancache_status_t{
+    uint16_t cached:1;              // Assignment loaded from config
+    uint16_t validating:1;          // Background exchange in progress
+    uint16_t validated:1;           // Master answered since boot
+}pancache_status_t;
+
+typedef struct _pancache_instance_t{
+    pancache_status_t status;
+    struct _dw1000_dev_instance_t * parent;
+    uint16_t short_address;
+    uint16_t PANID;
+    uint16_t slot_id;
+    uint16_t nretries;              // Background exchanges that timed out
+    uint32_t seed;                  // xorshift32 state of the jitter
+    uint32_t utime_start;           // Start of the current exchange, usec
+    pancache_start_cb_t start_cb;   // Starts the PAN exchange, NULL for dw1000_pan_start()
+    struct os_callout callout;
+}pancache_instance_t;
+
+/**
+ * [pancache_init description]
+ * Register the pan config handler and load the cached assignment, one instance per device.
+ * @param  cache [Cache instance]
+ * @param  inst  [dw1000 instance, dw1000_pan_init() done]
+ * @return       [Cache instance]
+ */
+pancache_instance_t * pancache_init(pancache_instance_t * cache, struct _dw1000_dev_instance_t * inst);
+
+/**
+ * [pancache_set_start description]
+ * Start the PAN exchange with start_cb instead of dw1000_pan_start(), the
+ * exchange still completes by setting inst->pan->status.valid.
+ * @param  cache    [Cache instance]
+ * @param  start_cb [Start of the exchange, NULL for dw1000_pan_start()]
+ */
+void pancache_set_start(pancache_instance_t * cache, pancache_start_cb_t start_cb);
+
+/**
+ * [pancache_join description]
+ * Apply the cached assignment to the instance and its address filter and validate it in the background,
+ * or block on the PAN exchange and cache the assignment when there is none.
+ * @param  cache [Cache instance]
+ * @return       [true if resumed from the cache]
+ */
+bool pancache_join(pancache_instance_t * cache);
+
+/**
+ * [pancache_save description]
+ * Cache the assignment currently held by the instance.
+ * @param  cache [Cache instance]
+ * @return       [0 on success]
+ */
+int pancache_save(pancache_instance_t * cache);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* _DW1000_PANCACHE_H_ */
@@ -0,0 +1,216 @@
+/*
+ * Copyright 2018, Decawave Limited, All Rights Reserved
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <os/os.h>
+#include "syscfg/syscfg.h"
+#include <config/config.h>
+
+#include <dw1000/dw1000_dev.h>
+#include <dw1000/dw1000_mac.h>
+#include <dw1000/dw1000_pan.h>
+#include <pancache/dw1000_pancache.h>
+
+static pancache_instance_t * g_pancache;
+
+static char *
+pancache_conf_get(int argc, char **argv, char *val, int val_len_max){
+    if (argc != 1 || g_pancache == NULL)
+        return NULL;
+    if (!strcmp(argv[0], "addr"))
+        snprintf(val, val_len_max, "%u", g_pancache->short_address);
+    else if (!strcmp(argv[0], "panid"))
+        snprintf(val, val_len_max, "%u", g_pancache->PANID);
+    else if (!strcmp(argv[0], "slot"))
+        snprintf(val, val_len_max, "%u", g_pancache->slot_id);
+    else
+        return NULL;
+    return val;
+}
+
+static int
+pancache_conf_set(int argc, char **argv, char *val){
+    int32_t value;
+
+    if (argc != 1 || g_pancache == NULL)
+        return OS_ENOENT;
+    int rc = CONF_VALUE_SET(val, CONF_INT32, value);
+    if (rc)
+        return rc;
+    if (!strcmp(argv[0], "addr"))
+        g_pancache->short_address = value;
+    else if (!strcmp(argv[0], "panid"))
+        g_pancache->PANID = value;
+    else if (!strcmp(argv[0], "slot"))
+        g_pancache->slot_id = value;
+    else
+        return OS_ENOENT;
+    return 0;
+}
+
+static int
+pancache_conf_commit(void){
+    // A zero address is the erased state, see pancache_save()
+    g_pancache->status.cached = g_pancache->short_address != 0;
+    return 0;
+}
+
+static struct conf_handler pancache_conf_handler = {
+    .ch_name = "pan",
+    .ch_get = pancache_conf_get,
+    .ch_set = pancache_conf_set,
+    .ch_commit = pancache_conf_commit
+};
+
+/*
+ * Delay in ms spread over [ms, ms + PANCACHE_JITTER_MS), so that devices
+ * powered up together do not all hit the master at once.
+ */
+static uint32_t
+pancache_jitter(pancache_instance_t * cache, uint32_t ms){
+    // xorshift32
+    cache->seed ^= cache->seed << 13;
+    cache->seed ^= cache->seed >> 17;
+    cache->seed ^= cache->seed << 5;
+#if MYNEWT_VAL(PANCACHE_JITTER_MS) > 0
+    ms += cache->seed % MYNEWT_VAL(PANCACHE_JITTER_MS);
+#endif
+    return OS_TICKS_PER_SEC * ms / 1000;
+}
+
+static void
+pancache_start(pancache_instance_t * cache){
+    cache->utime_start = os_cputime_ticks_to_usecs(os_cputime_get32());
+    if (cache->start_cb)
+        cache->start_cb(cache);
+    else
+        dw1000_pan_start(cache->parent, DWT_NONBLOCKING);
+}
+
+static void
+pancache_poll_cb(struct os_event * ev){
+    pancache_instance_t * cache = (pancache_instance_t *) ev->ev_arg;
+    dw1000_dev_instance_t * inst = cache->parent;
+
+    if (!cache->status.validating){
+        cache->status.validating = 1;
+        pancache_start(cache);
+    }else if (inst->pan->status.valid){
+        // The exchange has written the master's assignment into the instance
+        bool changed = inst->my_short_address != cache->short_address || inst->PANID != cache->PANID
+                || inst->slot_id != cache->slot_id;
+        cache->status.validating = 0;
+        cache->status.validated = 1;
+        printf("{\"utime\": %lu,\"pancache\": {\"validated\": 1,\"changed\": %d}}\n",
+                os_cputime_ticks_to_usecs(os_cputime_get32()), changed);
+        if (changed){
+            dw1000_set_panid(inst, inst->PANID);
+            dw1000_set_address16(inst, inst->my_short_address);
+            pancache_save(cache);
+        }
+        return;
+    }else if (os_cputime_ticks_to_usecs(os_cputime_get32()) - cache->utime_start > 1000 * MYNEWT_VAL(PANCACHE_RETRY_MS)){
+        // The exchange timed out and left the receiver off, try again after a jittered delay
+        cache->status.validating = 0;
+        cache->nretries++;
+        os_callout_reset(&cache->callout, pancache_jitter(cache, 0));
+        return;
+    }
+    os_callout_reset(&cache->callout, OS_TICKS_PER_SEC * MYNEWT_VAL(PANCACHE_POLL_MS) / 1000);
+}
+
+pancache_instance_t *
+pancache_init(pancache_instance_t * cache, dw1000_dev_instance_t * inst){
+    assert(cache);
+    assert(inst);
+    assert(g_pancache == NULL || g_pancache == cache);
+
+    memset(cache, 0, sizeof(pancache_instance_t));
+    cache->parent = inst;
+    cache->seed = (uint32_t)(inst->my_long_address ^ (inst->my_long_address >> 32)) ^ os_cputime_get32();
+    if (cache->seed == 0)
+        cache->seed = 1;
+    os_callout_init(&cache->callout, os_eventq_dflt_get(), pancache_poll_cb, cache);
+
+    if (g_pancache == NULL){
+        g_pancache = cache;
+        conf_register(&pancache_conf_handler);
+    }
+    conf_load();
+    return cache;
+}
+
+void
+pancache_set_start(pancache_instance_t * cache, pancache_start_cb_t start_cb){
+    cache->start_cb = start_cb;
+}
+
+bool
+pancache_join(pancache_instance_t * cache){
+    dw1000_dev_instance_t * inst = cache->parent;
+
+    if (cache->status.cached){
+        inst->my_short_address = cache->short_address;
+        inst->PANID = cache->PANID;
+        inst->slot_id = cache->slot_id;
+        dw1000_set_panid(inst, inst->PANID);
+        dw1000_set_address16(inst, inst->my_short_address);
+        printf("{\"utime\": %lu,\"pancache\": {\"resumed\": 1,\"addr\": \"%X\",\"PANID\": \"%X\",\"slot\": %d}}\n",
+                os_cputime_ticks_to_usecs(os_cputime_get32()), inst->my_short_address, inst->PANID, inst->slot_id);
+        os_callout_reset(&cache->callout, pancache_jitter(cache, MYNEWT_VAL(PANCACHE_VALIDATE_MS)));
+        return true;
+    }
+
+    pancache_start(cache);
+    while(inst->pan->status.valid != true){
+        os_eventq_run(os_eventq_dflt_get());
+        os_cputime_delay_usecs(5000);
+    }
+    cache->status.validated = 1;
+    pancache_save(cache);
+    return false;
+}
+
+int
+pancache_save(pancache_instance_t * cache){
+    dw1000_dev_instance_t * inst = cache->parent;
+    char buf[8];
+    int rc;
+
+    cache->short_address = inst->my_short_address;
+    cache->PANID = inst->PANID;
+    cache->slot_id = inst->slot_id;
+    cache->status.cached = 1;
+
+    // Address last, a first save cut short leaves no assignment behind
+    snprintf(buf, sizeof(buf), "%u", cache->PANID);
+    rc = conf_save_one("pan/panid", buf);
+    if (rc == 0){
+        snprintf(buf, sizeof(buf), "%u", cache->slot_id);
+        rc = conf_save_one("pan/slot", buf);
+    }
+    if (rc == 0){
+        snprintf(buf, sizeof(buf), "%u", cache->short_address);
+        rc = conf_save_one("pan/addr", buf);
+    }
+    return rc;
+}
@@ -0,0 +1,159 @@
+/**
+ * Copyright 2018, Decawave Limited, All Rights Reserved
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _DW1000_PANJOIN_H_
+#define _DW1000_PANJOIN_H_
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <os/os.h>
+#include <os/os_cputime.h>
+#include "syscfg/syscfg.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <dw1000/dw1000_dev.h>
+#include <panjoin_backoff/dw1000_panjoin_backoff.h>
+
+/*
+ * Contention managed PAN join, the device backoff and the master load
+ * estimate are in lib/panjoin_backoff. The beacon and batch frames are data
+ * frames, so devices with the frame filter set to DWT_FF_DATA_EN receive them.
+ * They use frame version 1 (IEEE 802.15.4-2006), which the DW1000 filter
+ * accepts, to keep them apart from FCNTL_IEEE_RANGE_16 in the driver and in
+ * lib/dispatch.
+ *
+ * With batching the master does not answer each request on its own but
+ * broadcasts the assignments of a contention period in one batch frame when
+ * the period closes, or earlier once the frame is full. A device whose
+ * request was lost simply is not in it and contends again.
+ */
+
+#define FCNTL_IEEE_PANJOIN_16 0x9841    // Data frame, version 1, PAN ID compressed, 16-bit addressing
+
+typedef enum _panjoin_code_t{
+    PANJOIN_CODE_BEACON = 1,
+    PANJOIN_CODE_BATCH
+}panjoin_code_t;
+
+typedef struct _panjoin_beacon_frame_t{
+    uint16_t fctrl;
+    uint8_t seq_num;
+    uint16_t PANID;
+    uint16_t dst_address;           // 0xFFFF
+    uint16_t src_address;
+    uint16_t code;                  // PANJOIN_CODE_BEACON, at the ieee_rng_request_frame_t offset
+    uint8_t nslots;
+    uint16_t slot_usec;
+    uint16_t load;                  // Devices estimated to be contending
+}__attribute__((__packed__)) panjoin_beacon_frame_t;
+
+typedef struct _panjoin_assignment_t{
+    uint64_t long_address;          // UUID of the requesting device
+    uint16_t short_address;
+    uint8_t slot_id;
+}__attribute__((__packed__)) panjoin_assignment_t;
+
+typedef struct _panjoin_batch_frame_t{
+    uint16_t fctrl;
+    uint8_t seq_num;
+    uint16_t PANID;
+    uint16_t dst_address;           // 0xFFFF
+    uint16_t src_address;
+    uint16_t code;                  // PANJOIN_CODE_BATCH
+    uint16_t pan_id;                // Assigned PANID
+    uint8_t nentries;
+    panjoin_assignment_t entries[MYNEWT_VAL(PANJOIN_BATCH_NENTRIES)];
+}__attribute__((__packed__)) panjoin_batch_frame_t;
+
+typedef enum _panjoin_state_t{
+    PANJOIN_IDLE = 0,
+    PANJOIN_LISTEN,                 // Waiting for a beacon
+    PANJOIN_CONTEND,                // Backing off
+    PANJOIN_JOINED
+}panjoin_state_t;
+
+typedef struct _panjoin_instance_t{
+    struct _dw1000_dev_instance_t * parent;
+    panjoin_state_t state;
+    panjoin_backoff_t backoff;
+    bool pending;                   // Request sent, outcome known at the next beacon
+    uint32_t utime_start;           // Join start, usec
+    uint32_t utime_beacon;          // Last beacon, usec
+    uint16_t nbeacons;
+    uint16_t nrequests;
+    struct os_event request_ev;
+    struct hal_timer request_timer;
+    struct os_callout callout;      // Beacon timeout and unslotted attempts
+}panjoin_instance_t;
+
+/**
+ * [panjoin_init description]
+ * Register the beacon handler with lib/dispatch.
+ * @param  join [Join instance]
+ * @param  inst [dw1000 instance, dw1000_pan_init() done]
+ * @return      [Join instance]
+ */
+panjoin_instance_t * panjoin_init(panjoin_instance_t * join, struct _dw1000_dev_instance_t * inst);
+
+/**
+ * [panjoin_start description]
+ * Listen for the load beacon and send the PAN request in a contention slot
+ * drawn by the backoff, repeating until pan->status.valid. Does not block.
+ * @param  join [Join instance]
+ */
+void panjoin_start(panjoin_instance_t * join);
+
+/**
+ * [panjoin_beacon_send description]
+ * Master side, broadcast a load beacon now.
+ * @param  inst [dw1000 instance]
+ * @param  load [Load to advertise]
+ */
+void panjoin_beacon_send(struct _dw1000_dev_instance_t * inst, uint16_t load);
+
+/**
+ * [panjoin_batch_add description]
+ * Master side, queue an assignment for the next batch frame. A device
+ * already queued, i.e. a retransmitted request, keeps its place.
+ * @param  batch         [Batch frame]
+ * @param  long_address  [UUID of the device]
+ * @param  short_address [Assigned short address]
+ * @param  slot_id       [Assigned slot]
+ * @return               [Entries queued, -1 if the frame is full]
+ */
+int panjoin_batch_add(panjoin_batch_frame_t * batch, uint64_t long_address, uint16_t short_address, uint8_t slot_id);
+
+/**
+ * [panjoin_batch_send description]
+ * Master side, broadcast the queued assignments now and empty the batch.
+ * @param  inst  [dw1000 instance]
+ * @param  batch [Batch frame]
+ */
+void panjoin_batch_send(struct _dw1000_dev_instance_t * inst, panjoin_batch_frame_t * batch);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* _DW1000_PANJOIN_H_ */
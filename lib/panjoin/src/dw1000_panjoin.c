@@ -0,0 +1,281 @@
+/*
+ * Copyright 2018, Decawave Limited, All Rights Reserved
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <stddef.h>
+#include <assert.h>
+#include <os/os.h>
+#include <os/os_cputime.h>
+#include "syscfg/syscfg.h"
+#include "sysinit/sysinit.h"
+
+#include <dw1000/dw1000_dev.h>
+#include <dw1000/dw1000_hal.h>
+#include <dw1000/dw1000_mac.h>
+#include <dw1000/dw1000_phy.h>
+#include <dw1000/dw1000_pan.h>
+#include <dispatch/dw1000_dispatch.h>
+#include <panjoin/dw1000_panjoin.h>
+
+static panjoin_instance_t * g_panjoin;
+
+static void
+panjoin_joined(panjoin_instance_t * join){
+    os_callout_stop(&join->callout);
+    os_cputime_timer_stop(&join->request_timer);
+    join->state = PANJOIN_JOINED;
+    join->pending = false;
+    printf("{\"utime\": %lu,\"panjoin\": {\"joined_usec\": %lu,\"attempts\": %u,\"beacons\": %u}}\n",
+            os_cputime_ticks_to_usecs(os_cputime_get32()),
+            os_cputime_ticks_to_usecs(os_cputime_get32()) - join->utime_start,
+            join->nrequests, join->nbeacons);
+}
+
+static void
+panjoin_request_ev_cb(struct os_event * ev){
+    panjoin_instance_t * join = (panjoin_instance_t *) ev->ev_arg;
+
+    if (join->state == PANJOIN_JOINED || join->parent->pan->status.valid)
+        return;
+    join->nrequests++;
+    dw1000_pan_start(join->parent, DWT_NONBLOCKING);
+}
+
+static void
+panjoin_request_timer_cb(void * arg){
+    panjoin_instance_t * join = (panjoin_instance_t *) arg;
+    os_eventq_put(os_eventq_dflt_get(), &join->request_ev);
+}
+
+/*
+ * No beacon for PANJOIN_BEACON_TIMEOUT_MS, e.g. a master without panjoin:
+ * keep the same backoff but count slots on the local clock.
+ */
+static void
+panjoin_callout_cb(struct os_event * ev){
+    panjoin_instance_t * join = (panjoin_instance_t *) ev->ev_arg;
+    dw1000_dev_instance_t * inst = join->parent;
+
+    if (inst->pan->status.valid){
+        panjoin_joined(join);
+        return;
+    }
+    if (join->pending)
+        panjoin_backoff_fail(&join->backoff);
+
+    panjoin_backoff_load(&join->backoff, PANJOIN_LOAD_NONE);
+    uint32_t usecs = (panjoin_backoff_slot(&join->backoff, INT16_MAX) + 1) * MYNEWT_VAL(PANJOIN_SLOT_USEC);
+    join->pending = true;
+    os_cputime_timer_relative(&join->request_timer, usecs);
+    // Outcome checked one slot after the request
+    os_callout_reset(&join->callout, (uint64_t) OS_TICKS_PER_SEC * (usecs + MYNEWT_VAL(PANJOIN_SLOT_USEC)) / 1000000 + 1);
+}
+
+static void
+panjoin_beacon_rx(panjoin_instance_t * join, dw1000_dev_instance_t * inst){
+    panjoin_beacon_frame_t beacon;
+
+    if (inst->frame_len < sizeof(panjoin_beacon_frame_t))
+        return;
+    uint32_t cputime = os_cputime_get32();
+    dw1000_read_rx(inst, (uint8_t *) &beacon, 0, sizeof(panjoin_beacon_frame_t));
+    join->utime_beacon = os_cputime_ticks_to_usecs(cputime);
+    join->nbeacons++;
+
+    panjoin_backoff_load(&join->backoff, beacon.load);
+    if (inst->pan->status.valid){
+        panjoin_joined(join);
+        return;
+    }
+    if (join->pending){
+        join->pending = false;
+        panjoin_backoff_fail(&join->backoff);
+    }
+    join->state = PANJOIN_CONTEND;
+    int16_t slot = panjoin_backoff_slot(&join->backoff, beacon.nslots);
+    if (slot >= 0){
+        // Slot 0 starts one slot after the beacon, time enough to turn it round
+        join->pending = true;
+        os_cputime_timer_start(&join->request_timer,
+                cputime + os_cputime_usecs_to_ticks((slot + 1) * (uint32_t) beacon.slot_usec));
+    }
+    os_callout_reset(&join->callout, OS_TICKS_PER_SEC * MYNEWT_VAL(PANJOIN_BEACON_TIMEOUT_MS) / 1000);
+}
+
+static void
+panjoin_batch_rx(panjoin_instance_t * join, dw1000_dev_instance_t * inst){
+    panjoin_batch_frame_t batch;
+    uint16_t len = (inst->frame_len < sizeof(panjoin_batch_frame_t)) ? inst->frame_len : sizeof(panjoin_batch_frame_t);
+
+    if (len < offsetof(panjoin_batch_frame_t, entries))
+        return;
+    dw1000_read_rx(inst, (uint8_t *) &batch, 0, len);
+    uint16_t n = (len - offsetof(panjoin_batch_frame_t, entries)) / sizeof(panjoin_assignment_t);
+    if (batch.nentries < n)
+        n = batch.nentries;
+
+    for (uint16_t i = 0; i < n; i++){
+        if (batch.entries[i].long_address != inst->my_long_address)
+            continue;
+        inst->PANID = batch.pan_id;
+        inst->my_short_address = batch.entries[i].short_address;
+        inst->slot_id = batch.entries[i].slot_id;
+        dw1000_set_panid(inst, inst->PANID);
+        dw1000_set_address16(inst, inst->my_short_address);
+        inst->pan->status.valid = true;
+        panjoin_joined(join);
+        return;
+    }
+}
+
+static bool
+panjoin_rx_complete_cb(dw1000_dev_instance_t * inst){
+    panjoin_instance_t * join = g_panjoin;
+    uint16_t code;
+
+    if (join == NULL || join->state == PANJOIN_IDLE || join->state == PANJOIN_JOINED)
+        return true;
+    if (inst->frame_len >= offsetof(panjoin_beacon_frame_t, code) + sizeof(uint16_t)){
+        dw1000_read_rx(inst, (uint8_t *) &code, offsetof(panjoin_beacon_frame_t, code), sizeof(uint16_t));
+        if (code == PANJOIN_CODE_BEACON)
+            panjoin_beacon_rx(join, inst);
+        else if (code == PANJOIN_CODE_BATCH)
+            panjoin_batch_rx(join, inst);
+    }
+    if (join->state != PANJOIN_JOINED){
+        dw1000_set_rx_timeout(inst, 0);
+        dw1000_start_rx(inst);
+    }
+    return true;
+}
+
+/*
+ * The PAN response timeout leaves the receiver off, keep listening for
+ * beacons and batches until joined.
+ */
+static bool
+panjoin_rx_timeout_cb(dw1000_dev_instance_t * inst){
+    panjoin_instance_t * join = g_panjoin;
+
+    if (join == NULL || join->state == PANJOIN_IDLE || join->state == PANJOIN_JOINED)
+        return false;
+    dw1000_set_rx_timeout(inst, 0);
+    dw1000_start_rx(inst);
+    return false;
+}
+
+panjoin_instance_t *
+panjoin_init(panjoin_instance_t * join, dw1000_dev_instance_t * inst){
+    assert(join);
+    assert(inst);
+    assert(g_panjoin == NULL || g_panjoin == join);
+
+    memset(join, 0, sizeof(panjoin_instance_t));
+    join->parent = inst;
+    panjoin_backoff_init(&join->backoff, (uint32_t)(inst->my_long_address ^ (inst->my_long_address >> 32)) ^ os_cputime_get32());
+    join->request_ev.ev_cb = panjoin_request_ev_cb;
+    join->request_ev.ev_arg = join;
+    os_cputime_timer_init(&join->request_timer, panjoin_request_timer_cb, join);
+    os_callout_init(&join->callout, os_eventq_dflt_get(), panjoin_callout_cb, join);
+
+    if (g_panjoin == NULL){
+        g_panjoin = join;
+        dw1000_extension_callbacks_t cbs = {
+            .rx_complete_cb = panjoin_rx_complete_cb,
+            .rx_timeout_cb = panjoin_rx_timeout_cb
+        };
+        int rc = dispatch_register(inst, FCNTL_IEEE_PANJOIN_16, DISPATCH_CODE_ANY_LO, DISPATCH_CODE_ANY_HI, &cbs);
+        SYSINIT_PANIC_ASSERT(rc == 0);
+    }
+    return join;
+}
+
+void
+panjoin_start(panjoin_instance_t * join){
+    dw1000_dev_instance_t * inst = join->parent;
+
+    join->state = PANJOIN_LISTEN;
+    join->utime_start = os_cputime_ticks_to_usecs(os_cputime_get32());
+    os_callout_reset(&join->callout, OS_TICKS_PER_SEC * MYNEWT_VAL(PANJOIN_BEACON_TIMEOUT_MS) / 1000);
+    dw1000_set_rx_timeout(inst, 0);
+    dw1000_start_rx(inst);
+}
+
+void
+panjoin_beacon_send(dw1000_dev_instance_t * inst, uint16_t load){
+    static uint8_t seq_num;
+    panjoin_beacon_frame_t beacon = {
+        .fctrl = FCNTL_IEEE_PANJOIN_16,
+        .seq_num = seq_num++,
+        .PANID = inst->PANID,
+        .dst_address = 0xFFFF,
+        .src_address = inst->my_short_address,
+        .code = PANJOIN_CODE_BEACON,
+        .nslots = MYNEWT_VAL(PANJOIN_NSLOTS),
+        .slot_usec = MYNEWT_VAL(PANJOIN_SLOT_USEC),
+        .load = load
+    };
+
+    dw1000_phy_forcetrxoff(inst);
+    dw1000_write_tx(inst, (uint8_t *) &beacon, 0, sizeof(panjoin_beacon_frame_t));
+    dw1000_write_tx_fctrl(inst, sizeof(panjoin_beacon_frame_t), 0, true);
+    dw1000_set_wait4resp(inst, true);
+    dw1000_set_rx_timeout(inst, 0);
+    dw1000_start_tx(inst);
+}
+
+int
+panjoin_batch_add(panjoin_batch_frame_t * batch, uint64_t long_address, uint16_t short_address, uint8_t slot_id){
+
+    for (uint16_t i = 0; i < batch->nentries; i++)
+        if (batch->entries[i].long_address == long_address)
+            return batch->nentries;
+    if (batch->nentries == MYNEWT_VAL(PANJOIN_BATCH_NENTRIES))
+        return -1;
+
+    panjoin_assignment_t * entry = &batch->entries[batch->nentries++];
+    entry->long_address = long_address;
+    entry->short_address = short_address;
+    entry->slot_id = slot_id;
+    return batch->nentries;
+}
+
+void
+panjoin_batch_send(dw1000_dev_instance_t * inst, panjoin_batch_frame_t * batch){
+    static uint8_t seq_num;
+    uint16_t len = offsetof(panjoin_batch_frame_t, entries) + batch->nentries * sizeof(panjoin_assignment_t);
+
+    batch->fctrl = FCNTL_IEEE_PANJOIN_16;
+    batch->seq_num = seq_num++;
+    batch->PANID = inst->PANID;
+    batch->dst_address = 0xFFFF;
+    batch->src_address = inst->my_short_address;
+    batch->code = PANJOIN_CODE_BATCH;
+    batch->pan_id = inst->PANID;
+
+    dw1000_phy_forcetrxoff(inst);
+    dw1000_write_tx(inst, (uint8_t *) batch, 0, len);
+    dw1000_write_tx_fctrl(inst, len, 0, true);
+    dw1000_set_wait4resp(inst, true);
+    dw1000_set_rx_timeout(inst, 0);
+    dw1000_start_tx(inst);
+    batch->nentries = 0;
+}
@@ -0,0 +1,132 @@
+/**
+ * Copyright 2018, Decawave Limited, All Rights Reserved
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _DW1000_PANJOIN_BACKOFF_H_
+#define _DW1000_PANJOIN_BACKOFF_H_
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "syscfg/syscfg.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Contention managed PAN join. The master broadcasts a load beacon every
+ * PANJOIN_PERIOD_MS, the PANJOIN_NSLOTS slots that follow form the contention
+ * period in which devices send their PAN request. Every period a device
+ * draws a slot uniformly from a contention window counted in slots,
+ *
+ *   window = beacon heard ? load : PANJOIN_CW_MIN << attempt
+ *
+ * clamped to [PANJOIN_CW_MIN, PANJOIN_CW_MAX] and, with a beacon, to no less
+ * than the slots of the period. It stays silent if the draw falls past the
+ * period. load is the master's estimate of the devices still
+ * contending, so each of them sends with probability 1/load per slot, which
+ * keeps about 1/e of the slots successful whatever the backlog, and a device
+ * booting into a crowded period does not have to collide its way up to the
+ * right window. The master updates the estimate after each period
+ * (pseudo-Bayesian, Rivest): an idle or successful slot lowers it by one, a
+ * collision raises it by 1.39, never below Schoute's 2.39 devices per
+ * collision. Exponential backoff only applies while no beacon is heard.
+ *
+ * Nothing here touches the radio, lib/panjoin drives it on the devices and
+ * pan_master, apps/panjoin_sim on the host.
+ */
+
+#define PANJOIN_LOAD_NONE 0xFFFF        // No beacon heard, see panjoin_backoff_load()
+
+/*
+ * Device side backoff.
+ */
+typedef struct _panjoin_backoff_t{
+    uint32_t seed;                  // xorshift32 state
+    uint16_t attempt;               // Failed attempts so far
+    uint16_t load;                  // Last advertised load, PANJOIN_LOAD_NONE without beacon
+}panjoin_backoff_t;
+
+/*
+ * Master side backlog estimate.
+ */
+typedef struct _panjoin_load_t{
+    uint16_t nsuccess;              // Requests received in the current period
+    uint16_t ncollision;            // Slots lost to collisions in the current period
+    uint16_t load;                  // Advertised estimate
+}panjoin_load_t;
+
+/**
+ * [panjoin_backoff_init description]
+ * @param  backoff [Backoff state]
+ * @param  seed    [Seed, distinct per device, e.g. from the long address]
+ */
+void panjoin_backoff_init(panjoin_backoff_t * backoff, uint32_t seed);
+
+/**
+ * [panjoin_backoff_slot description]
+ * Draw for one contention period with the last advertised load.
+ * @param  backoff [Backoff state]
+ * @param  nslots  [Slots in the period]
+ * @return         [Slot to send the request in, -1 to stay silent]
+ */
+int16_t panjoin_backoff_slot(panjoin_backoff_t * backoff, uint16_t nslots);
+
+/**
+ * [panjoin_backoff_fail description]
+ * The last request went unanswered, widens the window while no beacon is heard.
+ * @param  backoff [Backoff state]
+ */
+void panjoin_backoff_fail(panjoin_backoff_t * backoff);
+
+/**
+ * [panjoin_backoff_load description]
+ * Advertised load from a beacon, used from the next draw on.
+ * @param  backoff [Backoff state]
+ * @param  load    [Advertised load, PANJOIN_LOAD_NONE when beacons are lost]
+ */
+void panjoin_backoff_load(panjoin_backoff_t * backoff, uint16_t load);
+
+/**
+ * [panjoin_load_success description]
+ * Master received a request in the contention period, requests outside it
+ * are not counted by the caller.
+ */
+void panjoin_load_success(panjoin_load_t * load);
+
+/**
+ * [panjoin_load_collision description]
+ * Master lost a contention slot to a collision, typically an rx error.
+ */
+void panjoin_load_collision(panjoin_load_t * load);
+
+/**
+ * [panjoin_load_period description]
+ * Close a contention period and update the estimate.
+ * @param  load [Load estimate]
+ * @return      [Load to advertise in the next beacon]
+ */
+uint16_t panjoin_load_period(panjoin_load_t * load);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* _DW1000_PANJOIN_BACKOFF_H_ */
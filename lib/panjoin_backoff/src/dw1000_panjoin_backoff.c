@@ -0,0 +1,97 @@
+/*
+ * Copyright 2018, Decawave Limited, All Rights Reserved
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+#include <stdio.h>
+#include <string.h>
+#include "syscfg/syscfg.h"
+
+#include <panjoin_backoff/dw1000_panjoin_backoff.h>
+
+static uint32_t
+panjoin_rand(panjoin_backoff_t * backoff){
+    uint32_t x = backoff->seed;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return backoff->seed = x;
+}
+
+void
+panjoin_backoff_init(panjoin_backoff_t * backoff, uint32_t seed){
+    memset(backoff, 0, sizeof(panjoin_backoff_t));
+    backoff->seed = seed ? seed : 1;
+    backoff->load = PANJOIN_LOAD_NONE;
+}
+
+int16_t
+panjoin_backoff_slot(panjoin_backoff_t * backoff, uint16_t nslots){
+    uint32_t window = backoff->load;
+    if (window == PANJOIN_LOAD_NONE)
+        window = (uint32_t) MYNEWT_VAL(PANJOIN_CW_MIN) << ((backoff->attempt < 16) ? backoff->attempt : 16);
+    else if (window < nslots)
+        window = nslots;    // The whole period is there to spread over
+    if (window < MYNEWT_VAL(PANJOIN_CW_MIN))
+        window = MYNEWT_VAL(PANJOIN_CW_MIN);
+    if (window > MYNEWT_VAL(PANJOIN_CW_MAX))
+        window = MYNEWT_VAL(PANJOIN_CW_MAX);
+
+    uint32_t slot = panjoin_rand(backoff) % window;
+    return (slot < nslots) ? (int16_t) slot : -1;
+}
+
+void
+panjoin_backoff_fail(panjoin_backoff_t * backoff){
+    if (backoff->attempt < UINT16_MAX)
+        backoff->attempt++;
+}
+
+void
+panjoin_backoff_load(panjoin_backoff_t * backoff, uint16_t load){
+    backoff->load = load;
+}
+
+void
+panjoin_load_success(panjoin_load_t * load){
+    load->nsuccess++;
+}
+
+void
+panjoin_load_collision(panjoin_load_t * load){
+    load->ncollision++;
+}
+
+uint16_t
+panjoin_load_period(panjoin_load_t * load){
+    int32_t nidle = MYNEWT_VAL(PANJOIN_NSLOTS) - load->nsuccess - load->ncollision;
+    if (nidle < 0)
+        nidle = 0;
+    // Centi-devices
+    int32_t estimate = 100 * load->load + 139 * load->ncollision - 100 * (nidle + load->nsuccess);
+    int32_t floor = 239 * load->ncollision;
+    if (estimate < floor)
+        estimate = floor;
+    if (estimate > 100 * MYNEWT_VAL(PANJOIN_CW_MAX))
+        estimate = 100 * MYNEWT_VAL(PANJOIN_CW_MAX);
+
+    load->load = (estimate + 50) / 100;
+    load->nsuccess = 0;
+    load->ncollision = 0;
+    return load->load;
+}
@@ -0,0 +1,131 @@
+/**
+ * Copyright 2018, Decawave Limited, All Rights Reserved
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _DW1000_RATECTL_H_
+#define _DW1000_RATECTL_H_
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "syscfg/syscfg.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Ranging rate controller. A device is moving while the IMU or its ranges
+ * report motion and falls back to stationary after RATECTL_STILL_MS without
+ * any. Motion needs RATECTL_MOTION_COUNT consecutive samples over threshold so
+ * that a single outlier does not wake the device up. A moving device ranges at
+ * every opportunity, a stationary one at one in RATECTL_STILL_DIVISOR, which
+ * leaves the airtime of the others to the rest of the network.
+ */
+
+typedef enum _ratectl_state_t{
+    RATECTL_STILL = 0,
+    RATECTL_MOVING
+}ratectl_state_t;
+
+typedef struct _ratectl_link_t{
+    uint16_t address;
+    uint8_t nmotion;                // Consecutive ranges away from the reference
+    int32_t range;                  // Reference range in mm, moved on each confirmed motion
+}ratectl_link_t;
+
+typedef struct _ratectl_instance_t{
+    ratectl_state_t state;
+    uint32_t utime;                 // Last confirmed motion, usec
+    uint16_t count;                 // Opportunities since the last range while stationary
+    uint8_t naccel;                 // Consecutive accelerometer samples over threshold
+    uint8_t ngyro;                  // Consecutive gyroscope samples over threshold
+    uint16_t nlinks;
+    uint16_t next;                  // Link replaced when the table is full
+    uint32_t nskipped;              // Opportunities given up while stationary
+    ratectl_link_t links[MYNEWT_VAL(RATECTL_NLINKS)];
+}ratectl_instance_t;
+
+/**
+ * [ratectl_init description]
+ * Start in the moving state, a device settles after RATECTL_STILL_MS.
+ * @param  ctl [Controller instance]
+ * @return     [Controller instance]
+ */
+ratectl_instance_t * ratectl_init(ratectl_instance_t * ctl);
+
+/**
+ * [ratectl_accel description]
+ * Accelerometer sample, motion is a deviation of the magnitude from gravity.
+ * @param  ctl      [Controller instance]
+ * @param  utime    [Sample time, usec]
+ * @param  accel    [Acceleration in m/s^2]
+ */
+void ratectl_accel(ratectl_instance_t * ctl, uint32_t utime, const float accel[3]);
+
+/**
+ * [ratectl_gyro description]
+ * Gyroscope sample.
+ * @param  ctl      [Controller instance]
+ * @param  utime    [Sample time, usec]
+ * @param  gyro     [Angular rate in deg/s]
+ */
+void ratectl_gyro(ratectl_instance_t * ctl, uint32_t utime, const float gyro[3]);
+
+/**
+ * [ratectl_range description]
+ * Range to a peer, motion is a change of more than RATECTL_RANGE_MM from the
+ * reference range of the link. Covers devices without an IMU and constant
+ * velocity motion the accelerometer does not see.
+ * @param  ctl      [Controller instance]
+ * @param  utime    [Range time, usec]
+ * @param  address  [Peer address]
+ * @param  range    [Range in mm]
+ */
+void ratectl_range(ratectl_instance_t * ctl, uint32_t utime, uint16_t address, int32_t range);
+
+/**
+ * [ratectl_update description]
+ * Move to the stationary state once RATECTL_STILL_MS passed without motion.
+ * @param  ctl      [Controller instance]
+ * @param  utime    [Current time, usec]
+ * @return          [State]
+ */
+ratectl_state_t ratectl_update(ratectl_instance_t * ctl, uint32_t utime);
+
+/**
+ * [ratectl_skip description]
+ * Called on each ranging opportunity, e.g. a TDMA slot.
+ * @param  ctl      [Controller instance]
+ * @param  utime    [Current time, usec]
+ * @return          [true if the opportunity is to be left idle]
+ */
+bool ratectl_skip(ratectl_instance_t * ctl, uint32_t utime);
+
+/**
+ * [ratectl_divisor description]
+ * @return          [1 while moving, RATECTL_STILL_DIVISOR while stationary]
+ */
+uint16_t ratectl_divisor(ratectl_instance_t * ctl);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* _DW1000_RATECTL_H_ */
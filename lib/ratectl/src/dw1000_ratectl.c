@@ -0,0 +1,142 @@
+/*
+ * Copyright 2018, Decawave Limited, All Rights Reserved
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <os/os.h>
+#include "syscfg/syscfg.h"
+
+#include <ratectl/dw1000_ratectl.h>
+
+#define RATECTL_NLINKS MYNEWT_VAL(RATECTL_NLINKS)
+#define RATECTL_GRAVITY 9.80665f
+
+static void
+ratectl_motion(ratectl_instance_t * ctl, uint32_t utime){
+    ctl->utime = utime;
+    if (ctl->state == RATECTL_MOVING)
+        return;
+    ctl->state = RATECTL_MOVING;
+    ctl->count = 0;
+#if MYNEWT_VAL(RATECTL_VERBOSE)
+    printf("{\"utime\": %lu,\"ratectl\": {\"moving\": 1,\"skipped\": %lu}}\n", utime, ctl->nskipped);
+#endif
+}
+
+ratectl_instance_t *
+ratectl_init(ratectl_instance_t * ctl){
+    assert(ctl);
+
+    memset(ctl, 0, sizeof(ratectl_instance_t));
+    ctl->state = RATECTL_MOVING;
+    ctl->utime = os_cputime_ticks_to_usecs(os_cputime_get32());
+    return ctl;
+}
+
+void
+ratectl_accel(ratectl_instance_t * ctl, uint32_t utime, const float accel[3]){
+    // |a| outside [g - t, g + t], compared squared
+    const float t = MYNEWT_VAL(RATECTL_ACCEL_MG) * RATECTL_GRAVITY / 1000;
+    float a2 = accel[0] * accel[0] + accel[1] * accel[1] + accel[2] * accel[2];
+
+    if (a2 > (RATECTL_GRAVITY + t) * (RATECTL_GRAVITY + t) || a2 < (RATECTL_GRAVITY - t) * (RATECTL_GRAVITY - t)){
+        if (++ctl->naccel >= MYNEWT_VAL(RATECTL_MOTION_COUNT)){
+            ctl->naccel = MYNEWT_VAL(RATECTL_MOTION_COUNT);
+            ratectl_motion(ctl, utime);
+        }
+    }else
+        ctl->naccel = 0;
+}
+
+void
+ratectl_gyro(ratectl_instance_t * ctl, uint32_t utime, const float gyro[3]){
+    const float t = MYNEWT_VAL(RATECTL_GYRO_DPS);
+
+    if (gyro[0] * gyro[0] + gyro[1] * gyro[1] + gyro[2] * gyro[2] > t * t){
+        if (++ctl->ngyro >= MYNEWT_VAL(RATECTL_MOTION_COUNT)){
+            ctl->ngyro = MYNEWT_VAL(RATECTL_MOTION_COUNT);
+            ratectl_motion(ctl, utime);
+        }
+    }else
+        ctl->ngyro = 0;
+}
+
+void
+ratectl_range(ratectl_instance_t * ctl, uint32_t utime, uint16_t address, int32_t range){
+    ratectl_link_t * link = NULL;
+
+    for (uint16_t i = 0; i < ctl->nlinks; i++)
+        if (ctl->links[i].address == address){
+            link = &ctl->links[i];
+            break;
+        }
+    if (link == NULL){
+        if (ctl->nlinks < RATECTL_NLINKS)
+            link = &ctl->links[ctl->nlinks++];
+        else
+            link = &ctl->links[ctl->next++ % RATECTL_NLINKS];
+        link->address = address;
+        link->nmotion = 0;
+        link->range = range;
+        return;
+    }
+
+    // The reference only moves on confirmed motion, so a slow walk adds up
+    // to a detection however fast the ranges come in
+    if (abs(range - link->range) > MYNEWT_VAL(RATECTL_RANGE_MM)){
+        if (++link->nmotion >= MYNEWT_VAL(RATECTL_MOTION_COUNT)){
+            link->nmotion = 0;
+            link->range = range;
+            ratectl_motion(ctl, utime);
+        }
+    }else
+        link->nmotion = 0;
+}
+
+ratectl_state_t
+ratectl_update(ratectl_instance_t * ctl, uint32_t utime){
+    if (ctl->state == RATECTL_MOVING && utime - ctl->utime > MYNEWT_VAL(RATECTL_STILL_MS) * 1000UL){
+        ctl->state = RATECTL_STILL;
+        ctl->count = 0;
+#if MYNEWT_VAL(RATECTL_VERBOSE)
+        printf("{\"utime\": %lu,\"ratectl\": {\"moving\": 0,\"skipped\": %lu}}\n", utime, ctl->nskipped);
+#endif
+    }
+    return ctl->state;
+}
+
+bool
+ratectl_skip(ratectl_instance_t * ctl, uint32_t utime){
+    if (ratectl_update(ctl, utime) == RATECTL_MOVING)
+        return false;
+
+    bool skip = ctl->count != 0;
+    ctl->count = (ctl->count + 1) % MYNEWT_VAL(RATECTL_STILL_DIVISOR);
+    if (skip)
+        ctl->nskipped++;
+    return skip;
+}
+
+uint16_t
+ratectl_divisor(ratectl_instance_t * ctl){
+    return (ctl->state == RATECTL_MOVING) ? 1 : MYNEWT_VAL(RATECTL_STILL_DIVISOR);
+}
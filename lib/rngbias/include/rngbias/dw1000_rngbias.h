@@ -0,0 +1,105 @@
+/**
+ * Copyright 2018, Decawave Limited, All Rights Reserved
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _DW1000_RNGBIAS_H_
+#define _DW1000_RNGBIAS_H_
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "syscfg/syscfg.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * The leading edge detection of the dw1000 moves with the received power,
+ * biasing the measured range by up to tens of centimetres. The bias is
+ * tabulated per channel and PRF on a received power grid of RNGBIAS_NPOINTS
+ * points from -95dBm in 2dB steps, interpolated linearly and clamped at the
+ * ends, and subtracted from the range. Tables are fitted from recorded
+ * sessions with apps/matlab/bias_fit.m.
+ */
+#define RNGBIAS_RSSI_MIN_Q8 (-95 * 256)     // dBm in Q8
+#define RNGBIAS_STEP_SHIFT 9                // 2dB in Q8
+#define RNGBIAS_NPOINTS 18
+
+typedef struct _rngbias_table_t{
+    uint8_t channel;
+    uint8_t prf64;
+    int16_t bias_mm[RNGBIAS_NPOINTS];       // Measured minus true range
+}rngbias_table_t;
+
+typedef struct _rngbias_instance_t{
+    const rngbias_table_t * table;          // NULL, no correction
+}rngbias_instance_t;
+
+extern const rngbias_table_t rngbias_default_tables[];
+extern const uint16_t rngbias_ndefault_tables;
+
+/**
+ * [rngbias_init description]
+ * Select the default table of a channel and PRF.
+ * @param  bias    [Bias instance]
+ * @param  channel [Channel]
+ * @param  prf64   [64MHz PRF]
+ * @return         [Bias instance, without table if none matches]
+ */
+rngbias_instance_t * rngbias_init(rngbias_instance_t * bias, uint8_t channel, bool prf64);
+
+/**
+ * [rngbias_set_table description]
+ * Use a fitted table in place of the default one.
+ */
+void rngbias_set_table(rngbias_instance_t * bias, const rngbias_table_t * table);
+
+/**
+ * [rngbias_mm description]
+ * Bias at a received power level.
+ * @param  bias    [Bias instance]
+ * @param  rssi_q8 [dBm in Q8, INT16_MIN for no level, giving no correction]
+ * @return         [Bias in mm]
+ */
+int16_t rngbias_mm(const rngbias_instance_t * bias, int16_t rssi_q8);
+
+/**
+ * [rngbias_correct_mm description]
+ * Range corrected for the bias, in mm.
+ */
+static inline int32_t
+rngbias_correct_mm(const rngbias_instance_t * bias, int32_t range_mm, int16_t rssi_q8){
+    return range_mm - rngbias_mm(bias, rssi_q8);
+}
+
+/**
+ * [rngbias_correct description]
+ * Range corrected for the bias, in m, e.g. on dw1000_rng_tof_to_meters output.
+ */
+static inline float
+rngbias_correct(const rngbias_instance_t * bias, float range, int16_t rssi_q8){
+    return range - rngbias_mm(bias, rssi_q8) * 0.001f;
+}
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* _DW1000_RNGBIAS_H_ */
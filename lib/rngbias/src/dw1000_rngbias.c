@@ -0,0 +1,62 @@
+/*
+ * Copyright 2018, Decawave Limited, All Rights Reserved
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include "syscfg/syscfg.h"
+
+#include <rngbias/dw1000_rngbias.h>
+
+rngbias_instance_t *
+rngbias_init(rngbias_instance_t * bias, uint8_t channel, bool prf64){
+    assert(bias);
+
+    bias->table = NULL;
+    for (uint16_t i = 0; i < rngbias_ndefault_tables; i++){
+        if (rngbias_default_tables[i].channel == channel && rngbias_default_tables[i].prf64 == prf64){
+            bias->table = &rngbias_default_tables[i];
+            break;
+        }
+    }
+    return bias;
+}
+
+void
+rngbias_set_table(rngbias_instance_t * bias, const rngbias_table_t * table){
+    bias->table = table;
+}
+
+int16_t
+rngbias_mm(const rngbias_instance_t * bias, int16_t rssi_q8){
+    // INT16_MIN, lib/rssi found the diagnostics empty
+    if (bias->table == NULL || rssi_q8 == INT16_MIN)
+        return 0;
+
+    const int16_t * b = bias->table->bias_mm;
+    int32_t x = (int32_t) rssi_q8 - RNGBIAS_RSSI_MIN_Q8;
+    if (x <= 0)
+        return b[0];
+    uint32_t idx = (uint32_t) x >> RNGBIAS_STEP_SHIFT;
+    if (idx >= RNGBIAS_NPOINTS - 1)
+        return b[RNGBIAS_NPOINTS - 1];
+    int32_t frac = x & ((1 << RNGBIAS_STEP_SHIFT) - 1);
+    return (int16_t)(b[idx] + (((int32_t)(b[idx + 1] - b[idx]) * frac) >> RNGBIAS_STEP_SHIFT));
+}
@@ -0,0 +1,43 @@
+/*
+ * Copyright 2018, Decawave Limited, All Rights Reserved
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <rngbias/dw1000_rngbias.h>
+
+/*
+ * Default tables, -95dBm to -61dBm in 2dB steps, seeded from the Decawave range
+ * bias versus received signal level curves (APS011) of the 500MHz channels.
+ * The curves stop at -93dBm, the -95dBm point repeats it. The 900MHz channels
+ * 4 and 7 have no published level curve and stay flat. Fit for the antenna and
+ * board in use with apps/matlab/bias_fit.m and paste over the matching entry.
+ */
+#define RNGBIAS_NB_PRF16 {110, 110, 106, 97, 84, 65, 36, 0, -39, -64, -87, -109, -127, -143, -163, -179, -187, -198}
+#define RNGBIAS_NB_PRF64 {81, 81, 76, 71, 62, 49, 42, 35, 21, 0, -27, -51, -69, -82, -93, -100, -105, -110}
+
+const rngbias_table_t rngbias_default_tables[] = {
+    {.channel = 1, .prf64 = 0, .bias_mm = RNGBIAS_NB_PRF16}, {.channel = 1, .prf64 = 1, .bias_mm = RNGBIAS_NB_PRF64},
+    {.channel = 2, .prf64 = 0, .bias_mm = RNGBIAS_NB_PRF16}, {.channel = 2, .prf64 = 1, .bias_mm = RNGBIAS_NB_PRF64},
+    {.channel = 3, .prf64 = 0, .bias_mm = RNGBIAS_NB_PRF16}, {.channel = 3, .prf64 = 1, .bias_mm = RNGBIAS_NB_PRF64},
+    {.channel = 4, .prf64 = 0}, {.channel = 4, .prf64 = 1},
+    {.channel = 5, .prf64 = 0, .bias_mm = RNGBIAS_NB_PRF16}, {.channel = 5, .prf64 = 1, .bias_mm = RNGBIAS_NB_PRF64},
+    {.channel = 7, .prf64 = 0}, {.channel = 7, .prf64 = 1}
+};
+
+const uint16_t rngbias_ndefault_tables = sizeof(rngbias_default_tables)/sizeof(rngbias_table_t);
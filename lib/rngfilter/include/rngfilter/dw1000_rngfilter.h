@@ -0,0 +1,103 @@
+/**
+ * Copyright 2018, Decawave Limited, All Rights Reserved
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _DW1000_RNGFILTER_H_
+#define _DW1000_RNGFILTER_H_
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "syscfg/syscfg.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Per (src, dst) link range filter: a sliding median of RNGFILTER_MEDIAN
+ * samples rejects outliers, an alpha-beta tracker on the median smooths the
+ * range and estimates the range rate. All state is integer, ranges in mm and
+ * rates in mm/s carry 8 fractional bits.
+ */
+
+typedef struct _rngfilter_link_t{
+    uint16_t src_address;
+    uint16_t dst_address;
+    uint16_t used:1;
+    uint16_t primed:1;              // Tracker holds a range
+    uint8_t idx;                    // Next window slot
+    uint8_t nsamples;               // Samples in the window
+    int32_t window[MYNEWT_VAL(RNGFILTER_MEDIAN)];
+    int32_t range;                  // mm, Q8
+    int32_t rate;                   // mm/s, Q8
+    uint32_t utime;                 // Last update, usec
+}rngfilter_link_t;
+
+typedef struct _rngfilter_instance_t{
+    int32_t alpha;                  // Q16
+    int32_t beta;                   // Q16
+    uint32_t ndropped;              // Ranges of links beyond RNGFILTER_NLINKS, passed through
+    rngfilter_link_t links[MYNEWT_VAL(RNGFILTER_NLINKS)];
+}rngfilter_instance_t;
+
+typedef struct _rngfilter_output_t{
+    int32_t range_mm;
+    int32_t rate_mms;
+}rngfilter_output_t;
+
+/**
+ * [rngfilter_init description]
+ * Load the RNGFILTER_ALPHA/BETA gains and clear all links.
+ * @param  filter [Filter instance]
+ * @return        [Filter instance]
+ */
+rngfilter_instance_t * rngfilter_init(rngfilter_instance_t * filter);
+
+/**
+ * [rngfilter_reset description]
+ * Forget all links, gains are kept.
+ */
+void rngfilter_reset(rngfilter_instance_t * filter);
+
+/**
+ * [rngfilter_update description]
+ * Run a range through the filter of its link.
+ * @param  filter      [Filter instance]
+ * @param  src_address [Initiator]
+ * @param  dst_address [Responder]
+ * @param  utime       [Time of the range in usec, may wrap]
+ * @param  range_mm    [Range in mm]
+ * @param  out         [Filtered range and range rate]
+ * @return             [0 on success, -1 if the table is full and the range was passed through]
+ */
+int rngfilter_update(rngfilter_instance_t * filter, uint16_t src_address, uint16_t dst_address,
+        uint32_t utime, int32_t range_mm, rngfilter_output_t * out);
+
+/**
+ * [rngfilter_median description]
+ * Median of n values, n <= RNGFILTER_MEDIAN. The upper median for even n.
+ */
+int32_t rngfilter_median(const int32_t * values, uint8_t n);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* _DW1000_RNGFILTER_H_ */
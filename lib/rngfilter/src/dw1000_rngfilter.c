@@ -0,0 +1,126 @@
+/*
+ * Copyright 2018, Decawave Limited, All Rights Reserved
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+#include <string.h>
+#include <assert.h>
+#include "syscfg/syscfg.h"
+
+#include <rngfilter/dw1000_rngfilter.h>
+
+#define RNGFILTER_NLINKS MYNEWT_VAL(RNGFILTER_NLINKS)
+#define RNGFILTER_MEDIAN MYNEWT_VAL(RNGFILTER_MEDIAN)
+_Static_assert((RNGFILTER_NLINKS & (RNGFILTER_NLINKS - 1)) == 0, "RNGFILTER_NLINKS must be a power of 2");
+_Static_assert(RNGFILTER_MEDIAN > 0 && RNGFILTER_MEDIAN < 256, "RNGFILTER_MEDIAN out of range");
+
+#define RNGFILTER_MIN_DT 1000       // usec, bounds the rate gain of back to back ranges
+
+static rngfilter_link_t *
+rngfilter_lookup(rngfilter_instance_t * filter, uint16_t src_address, uint16_t dst_address){
+    uint32_t key = ((uint32_t) src_address << 16) | dst_address;
+    uint32_t h = (key * 2654435761UL) >> 16;
+
+    for (uint16_t i = 0; i < RNGFILTER_NLINKS; i++){
+        rngfilter_link_t * link = &filter->links[(h + i) & (RNGFILTER_NLINKS - 1)];
+        if (!link->used){
+            link->used = 1;
+            link->src_address = src_address;
+            link->dst_address = dst_address;
+            return link;
+        }
+        if (link->src_address == src_address && link->dst_address == dst_address)
+            return link;
+    }
+    return NULL;
+}
+
+rngfilter_instance_t *
+rngfilter_init(rngfilter_instance_t * filter){
+    assert(filter);
+
+    filter->alpha = MYNEWT_VAL(RNGFILTER_ALPHA);
+    filter->beta = MYNEWT_VAL(RNGFILTER_BETA);
+    rngfilter_reset(filter);
+    return filter;
+}
+
+void
+rngfilter_reset(rngfilter_instance_t * filter){
+    filter->ndropped = 0;
+    memset(filter->links, 0, sizeof(filter->links));
+}
+
+int32_t
+rngfilter_median(const int32_t * values, uint8_t n){
+    int32_t sorted[RNGFILTER_MEDIAN];
+
+    assert(n > 0 && n <= RNGFILTER_MEDIAN);
+    for (uint8_t i = 0; i < n; i++){
+        int32_t v = values[i];
+        uint8_t j = i;
+        for (; j > 0 && sorted[j - 1] > v; j--)
+            sorted[j] = sorted[j - 1];
+        sorted[j] = v;
+    }
+    return sorted[n / 2];
+}
+
+int
+rngfilter_update(rngfilter_instance_t * filter, uint16_t src_address, uint16_t dst_address,
+        uint32_t utime, int32_t range_mm, rngfilter_output_t * out){
+
+    rngfilter_link_t * link = rngfilter_lookup(filter, src_address, dst_address);
+    if (link == NULL){
+        filter->ndropped++;
+        out->range_mm = range_mm;
+        out->rate_mms = 0;
+        return -1;
+    }
+
+    uint32_t dt = utime - link->utime;
+    if (link->primed && dt > MYNEWT_VAL(RNGFILTER_TIMEOUT_MS) * 1000UL){
+        link->primed = 0;
+        link->nsamples = 0;
+        link->idx = 0;
+    }
+    link->utime = utime;
+
+    link->window[link->idx] = range_mm;
+    link->idx = (link->idx + 1) % RNGFILTER_MEDIAN;
+    if (link->nsamples < RNGFILTER_MEDIAN)
+        link->nsamples++;
+    int32_t z = rngfilter_median(link->window, link->nsamples) * 256;
+
+    if (!link->primed){
+        link->range = z;
+        link->rate = 0;
+        link->primed = 1;
+    }else{
+        if (dt < RNGFILTER_MIN_DT)
+            dt = RNGFILTER_MIN_DT;
+        int32_t predicted = link->range + (int32_t)(((int64_t) link->rate * dt) / 1000000);
+        int64_t residual = (int64_t) z - predicted;
+        link->range = predicted + (int32_t)((filter->alpha * residual) >> 16);
+        link->rate += (int32_t)(((filter->beta * residual * 1000000) / dt) >> 16);
+    }
+
+    out->range_mm = (link->range + 128) >> 8;
+    out->rate_mms = (link->rate + 128) >> 8;
+    return 0;
+}
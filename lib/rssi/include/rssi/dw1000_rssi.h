@@ -0,0 +1,129 @@
+/**
+ * Copyright 2018, Decawave Limited, All Rights Reserved
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _DW1000_RSSI_H_
+#define _DW1000_RSSI_H_
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "syscfg/syscfg.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <dw1000/dw1000_dev.h>
+
+/*
+ * Received signal and first path power levels in dBm, Q8 fixed point, from
+ * the dw1000 rx diagnostics (user manual 4.7.1 and 4.7.2):
+ *
+ *   rssi = 10 log10(C 2^17 / N^2) - A
+ *   fppl = 10 log10((F1^2 + F2^2 + F3^2) / N^2) - A
+ *
+ * with A = 113.77 at 16MHz PRF and 121.74 at 64MHz. The logarithm is taken in
+ * base 2 from the position of the leading one and a 64 entry table of the
+ * mantissa with linear interpolation, within 0.005dB of the float result.
+ *
+ * Q8 in an int16_t spans -128dBm to +128dBm. Levels below -128dBm, well under
+ * the receiver sensitivity, saturate at INT16_MIN + 1; INT16_MIN is reserved
+ * for empty diagnostics.
+ */
+#define RSSI_Q8(x) ((int16_t)((x) * 256))
+#define RSSI_A_PRF16_Q8 29125       // 113.77dB
+#define RSSI_A_PRF64_Q8 31165       // 121.74dB
+
+/*
+ * Snapshot of the diagnostics needed, rxdiag is overwritten by every reception.
+ */
+typedef struct _rssi_diag_t{
+    uint16_t cir_pwr;
+    uint16_t pacc_cnt;
+    uint16_t fp_amp;
+    uint16_t fp_amp2;
+    uint16_t fp_amp3;
+}rssi_diag_t;
+
+/**
+ * [rssi_log2_q16 description]
+ * Base 2 logarithm, Q16.
+ * @param  x [Value, non zero]
+ * @return   [log2(x) in Q16]
+ */
+int32_t rssi_log2_q16(uint64_t x);
+
+/**
+ * [rssi_level_q8 description]
+ * Received signal power level.
+ * @param  diag  [Rx diagnostics]
+ * @param  prf64 [64MHz PRF]
+ * @return       [dBm in Q8, INT16_MIN if the diagnostics are empty]
+ */
+int16_t rssi_level_q8(const rssi_diag_t * diag, bool prf64);
+
+/**
+ * [rssi_fppl_q8 description]
+ * First path power level.
+ * @param  diag  [Rx diagnostics]
+ * @param  prf64 [64MHz PRF]
+ * @return       [dBm in Q8, INT16_MIN if the diagnostics are empty]
+ */
+int16_t rssi_fppl_q8(const rssi_diag_t * diag, bool prf64);
+
+/**
+ * [rssi_batch_q8 description]
+ * Both levels for the n receptions of e.g. an nranges round, the preamble
+ * accumulation count term being shared between equal counts.
+ * @param  diag  [n snapshots]
+ * @param  rssi  [n results, may be NULL]
+ * @param  fppl  [n results, may be NULL]
+ * @param  n     [Receptions]
+ * @param  prf64 [64MHz PRF]
+ */
+void rssi_batch_q8(const rssi_diag_t * diag, int16_t * rssi, int16_t * fppl, uint16_t n, bool prf64);
+
+/**
+ * [rssi_diag_read description]
+ * Snapshot the diagnostics of the last reception.
+ */
+void rssi_diag_read(struct _dw1000_dev_instance_t * inst, rssi_diag_t * diag);
+
+/**
+ * [dw1000_rssi_q8 description]
+ * Fixed point counterpart of dw1000_get_rssi, for the PRF the device is configured for.
+ * @param  inst [dw1000 instance]
+ * @return      [dBm in Q8]
+ */
+int16_t dw1000_rssi_q8(struct _dw1000_dev_instance_t * inst);
+
+/**
+ * [dw1000_fppl_q8 description]
+ * First path power level of the last reception, for the PRF the device is configured for.
+ * @param  inst [dw1000 instance]
+ * @return      [dBm in Q8]
+ */
+int16_t dw1000_fppl_q8(struct _dw1000_dev_instance_t * inst);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* _DW1000_RSSI_H_ */
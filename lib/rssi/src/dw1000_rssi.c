@@ -0,0 +1,140 @@
+/*
+ * Copyright 2018, Decawave Limited, All Rights Reserved
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include "syscfg/syscfg.h"
+
+#include <dw1000/dw1000_regs.h>
+#include <dw1000/dw1000_dev.h>
+#include <rssi/dw1000_rssi.h>
+
+/*
+ * log2(1 + i/64) in Q16, i = 0..64
+ */
+static const uint32_t rssi_log2_lut[65] = {
+    0x00000, 0x005BA, 0x00B5D, 0x010EB, 0x01664, 0x01BC8, 0x02119, 0x02656,
+    0x02B80, 0x03098, 0x0359F, 0x03A94, 0x03F78, 0x0444C, 0x04910, 0x04DC5,
+    0x0526A, 0x05700, 0x05B89, 0x06003, 0x0646F, 0x068CE, 0x06D20, 0x07165,
+    0x0759D, 0x079CA, 0x07DEA, 0x081FF, 0x08608, 0x08A06, 0x08DFA, 0x091E2,
+    0x095C0, 0x09994, 0x09D5E, 0x0A11E, 0x0A4D4, 0x0A881, 0x0AC24, 0x0AFBE,
+    0x0B350, 0x0B6D9, 0x0BA59, 0x0BDD1, 0x0C140, 0x0C4A8, 0x0C807, 0x0CB5F,
+    0x0CEAF, 0x0D1F7, 0x0D538, 0x0D872, 0x0DBA5, 0x0DED0, 0x0E1F5, 0x0E513,
+    0x0E82A, 0x0EB3B, 0x0EE45, 0x0F149, 0x0F446, 0x0F73E, 0x0FA2F, 0x0FD1A,
+    0x10000
+};
+
+#define RSSI_10LOG10_2_Q16 197283   // 10 log10(2)
+
+int32_t
+rssi_log2_q16(uint64_t x){
+    assert(x);
+    int32_t n = 63 - __builtin_clzll(x);
+    // Mantissa with the leading one at bit 31
+    uint32_t m = (n >= 31) ? (uint32_t)(x >> (n - 31)) : (uint32_t)(x << (31 - n));
+    uint32_t idx = (m >> 25) & 0x3F;
+    uint32_t frac = (m >> 9) & 0xFFFF;
+    int32_t y0 = rssi_log2_lut[idx];
+    int32_t y1 = rssi_log2_lut[idx + 1];
+    return (n << 16) + y0 + (int32_t)(((uint32_t)(y1 - y0) * frac) >> 16);
+}
+
+/*
+ * 10 log10(2^(l/65536)) - A in dBm Q8, rounded.
+ */
+static inline int16_t
+rssi_q16_to_dbm_q8(int32_t log2_q16, bool prf64){
+    int64_t db_q32 = (int64_t) log2_q16 * RSSI_10LOG10_2_Q16;
+    int32_t db_q8 = (int32_t)((db_q32 + (1LL << 23)) >> 24) - (prf64 ? RSSI_A_PRF64_Q8 : RSSI_A_PRF16_Q8);
+    // Saturate, INT16_MIN flags empty diagnostics
+    if (db_q8 <= INT16_MIN)
+        return INT16_MIN + 1;
+    return (int16_t)(db_q8 > INT16_MAX ? INT16_MAX : db_q8);
+}
+
+static inline uint64_t
+rssi_fp_energy(const rssi_diag_t * diag){
+    return (uint64_t) diag->fp_amp * diag->fp_amp
+        + (uint64_t) diag->fp_amp2 * diag->fp_amp2
+        + (uint64_t) diag->fp_amp3 * diag->fp_amp3;
+}
+
+int16_t
+rssi_level_q8(const rssi_diag_t * diag, bool prf64){
+    if (diag->cir_pwr == 0 || diag->pacc_cnt == 0)
+        return INT16_MIN;
+    int32_t l = rssi_log2_q16(diag->cir_pwr) + (17 << 16) - 2 * rssi_log2_q16(diag->pacc_cnt);
+    return rssi_q16_to_dbm_q8(l, prf64);
+}
+
+int16_t
+rssi_fppl_q8(const rssi_diag_t * diag, bool prf64){
+    uint64_t energy = rssi_fp_energy(diag);
+    if (energy == 0 || diag->pacc_cnt == 0)
+        return INT16_MIN;
+    int32_t l = rssi_log2_q16(energy) - 2 * rssi_log2_q16(diag->pacc_cnt);
+    return rssi_q16_to_dbm_q8(l, prf64);
+}
+
+void
+rssi_batch_q8(const rssi_diag_t * diag, int16_t * rssi, int16_t * fppl, uint16_t n, bool prf64){
+    uint16_t pacc_cnt = 0;
+    int32_t pacc_log2 = 0;
+
+    for (uint16_t i = 0; i < n; i++){
+        const rssi_diag_t * d = &diag[i];
+        if (d->pacc_cnt != pacc_cnt && d->pacc_cnt){
+            pacc_cnt = d->pacc_cnt;
+            pacc_log2 = 2 * rssi_log2_q16(pacc_cnt);
+        }
+        if (rssi)
+            rssi[i] = (d->cir_pwr && d->pacc_cnt) ?
+                rssi_q16_to_dbm_q8(rssi_log2_q16(d->cir_pwr) + (17 << 16) - pacc_log2, prf64) : INT16_MIN;
+        if (fppl){
+            uint64_t energy = rssi_fp_energy(d);
+            fppl[i] = (energy && d->pacc_cnt) ?
+                rssi_q16_to_dbm_q8(rssi_log2_q16(energy) - pacc_log2, prf64) : INT16_MIN;
+        }
+    }
+}
+
+void
+rssi_diag_read(struct _dw1000_dev_instance_t * inst, rssi_diag_t * diag){
+    diag->cir_pwr = inst->rxdiag.cir_pwr;
+    diag->pacc_cnt = inst->rxdiag.pacc_cnt;
+    diag->fp_amp = inst->rxdiag.fp_amp;
+    diag->fp_amp2 = inst->rxdiag.fp_amp2;
+    diag->fp_amp3 = inst->rxdiag.fp_amp3;
+}
+
+int16_t
+dw1000_rssi_q8(struct _dw1000_dev_instance_t * inst){
+    rssi_diag_t diag;
+    rssi_diag_read(inst, &diag);
+    return rssi_level_q8(&diag, inst->config.prf == DWT_PRF_64M);
+}
+
+int16_t
+dw1000_fppl_q8(struct _dw1000_dev_instance_t * inst){
+    rssi_diag_t diag;
+    rssi_diag_read(inst, &diag);
+    return rssi_fppl_q8(&diag, inst->config.prf == DWT_PRF_64M);
+}
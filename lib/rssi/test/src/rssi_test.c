@@ -0,0 +1,117 @@
+/*
+ * Copyright 2018, Decawave Limited, All Rights Reserved
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+#include <stdint.h>
+#include <math.h>
+#include "syscfg/syscfg.h"
+#include "sysinit/sysinit.h"
+#include "testutil/testutil.h"
+#include <rssi/dw1000_rssi.h>
+
+#define RSSI_TEST_TOL_DB 0.1
+
+/*
+ * Float formulas of the user manual, 4.7.1 and 4.7.2
+ */
+static double
+rssi_test_level(const rssi_diag_t * diag, bool prf64){
+    double A = prf64 ? 121.74 : 113.77;
+    double n = diag->pacc_cnt;
+    return 10 * log10((double) diag->cir_pwr * (1 << 17) / (n * n)) - A;
+}
+
+static double
+rssi_test_fppl(const rssi_diag_t * diag, bool prf64){
+    double A = prf64 ? 121.74 : 113.77;
+    double n = diag->pacc_cnt;
+    double f1 = diag->fp_amp, f2 = diag->fp_amp2, f3 = diag->fp_amp3;
+    return 10 * log10((f1 * f1 + f2 * f2 + f3 * f3) / (n * n)) - A;
+}
+
+/*
+ * Expected Q8 value, saturated like the fixed point path
+ */
+static double
+rssi_test_clamp(double db){
+    return (db < -128.0) ? (INT16_MIN + 1) / 256.0 : db;
+}
+
+TEST_CASE(rssi_test_log2){
+    for (uint64_t x = 1; x < (1ULL << 40); x = x * 3 + 1){
+        double err = rssi_log2_q16(x) / 65536.0 - log2((double) x);
+        TEST_ASSERT(fabs(err) < 1e-4, "log2(%llu) off by %f", (unsigned long long) x, err);
+    }
+}
+
+TEST_CASE(rssi_test_levels){
+    static const uint16_t pacc_cnt[] = {16, 64, 127, 512, 1024, 2047};
+    for (uint16_t prf64 = 0; prf64 < 2; prf64++)
+        for (uint16_t p = 0; p < sizeof(pacc_cnt) / sizeof(pacc_cnt[0]); p++)
+            for (uint32_t v = 1; v <= UINT16_MAX; v = v * 5 / 4 + 1){
+                rssi_diag_t diag = {
+                    .cir_pwr = v,
+                    .pacc_cnt = pacc_cnt[p],
+                    .fp_amp = v,
+                    .fp_amp2 = v / 2,
+                    .fp_amp3 = v / 3
+                };
+                double rssi = rssi_level_q8(&diag, prf64) / 256.0;
+                double fppl = rssi_fppl_q8(&diag, prf64) / 256.0;
+                TEST_ASSERT(fabs(rssi - rssi_test_clamp(rssi_test_level(&diag, prf64))) < RSSI_TEST_TOL_DB,
+                        "rssi cir_pwr %lu pacc_cnt %u", (unsigned long) v, pacc_cnt[p]);
+                TEST_ASSERT(fabs(fppl - rssi_test_clamp(rssi_test_fppl(&diag, prf64))) < RSSI_TEST_TOL_DB,
+                        "fppl fp_amp %lu pacc_cnt %u", (unsigned long) v, pacc_cnt[p]);
+            }
+}
+
+TEST_CASE(rssi_test_batch){
+    rssi_diag_t diag[8];
+    int16_t rssi[8], fppl[8];
+    for (uint16_t i = 0; i < 8; i++)
+        diag[i] = (rssi_diag_t){
+            .cir_pwr = 1000 + 997 * i,
+            .pacc_cnt = (i < 4) ? 1024 : 1000 + i,
+            .fp_amp = 5000 + 311 * i,
+            .fp_amp2 = 4000,
+            .fp_amp3 = 3000
+        };
+    diag[5].cir_pwr = 0;
+    rssi_batch_q8(diag, rssi, fppl, 8, true);
+    for (uint16_t i = 0; i < 8; i++){
+        TEST_ASSERT(rssi[i] == rssi_level_q8(&diag[i], true), "batch rssi %u", i);
+        TEST_ASSERT(fppl[i] == rssi_fppl_q8(&diag[i], true), "batch fppl %u", i);
+    }
+    TEST_ASSERT(rssi[5] == INT16_MIN);
+}
+
+TEST_SUITE(rssi_test_all){
+    rssi_test_log2();
+    rssi_test_levels();
+    rssi_test_batch();
+}
+
+#if MYNEWT_VAL(SELFTEST)
+int
+main(int argc, char **argv){
+    sysinit();
+    rssi_test_all();
+    return tu_any_failed;
+}
+#endif
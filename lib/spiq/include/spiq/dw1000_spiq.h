@@ -0,0 +1,205 @@
+/**
+ * Copyright 2018, Decawave Limited, All Rights Reserved
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _DW1000_SPIQ_H_
+#define _DW1000_SPIQ_H_
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "syscfg/syscfg.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <os/os.h>
+#include <hal/hal_spi.h>
+#include <dw1000/dw1000_dev.h>
+
+/*
+ * A batch is a list of dw1000 register transactions staged into an arena,
+ * each as SPI header followed by data, and executed back to back with
+ * hal_spi_txrx_noblock, the completion interrupt of one transaction starting
+ * the next. The caller returns as soon as the batch is submitted.
+ */
+
+typedef struct _spiq_cmd_t{
+    uint16_t reg;
+    uint16_t subaddress;
+    uint16_t offset;                // Transaction start in the arena
+    uint16_t len;                   // Header and data bytes
+    uint8_t hlen;                   // Header bytes
+    uint8_t late_only:1;            // Executed only if the delayed start was late
+    uint8_t * rxbuf;                // Read destination, NULL for writes
+}spiq_cmd_t;
+
+typedef struct _spiq_status_t{
+    uint16_t busy:1;
+    uint16_t running:1;             // Submitted, holding the bus
+    uint16_t overflow:1;            // Batch did not fit, not submitted
+    uint16_t delay_start:1;
+    uint16_t start_tx:1;
+    uint16_t start_tx_error:1;      // Delayed transmission was late, transceiver forced off
+    uint16_t spi_error:1;
+}spiq_status_t;
+
+/*
+ * Modelled bus usage. A blocking sequence keeps the CPU for
+ * bus_nsecs + txn_nsecs; queued, the CPU spends isr_nsecs of it.
+ */
+typedef struct _spiq_stats_t{
+    uint32_t nbatches;
+    uint32_t ncmds;
+    uint32_t nbytes;
+    uint64_t bus_nsecs;
+    uint64_t txn_nsecs;
+    uint64_t isr_nsecs;
+}spiq_stats_t;
+
+struct _spiq_instance_t;
+typedef void spiq_complete_cb(struct _spiq_instance_t * spiq, void * arg);
+
+typedef struct _spiq_instance_t{
+    struct _dw1000_dev_instance_t * parent;
+    spiq_status_t status;
+    uint8_t ncmds;
+    uint8_t idx;
+    uint16_t arena_len;
+    uint8_t sys_status;             // SYS_STATUS byte 3 read back by spiq_start_tx
+    uint8_t sys_cfg;                // SYS_CFG byte 3 less RXWTOE, see spiq_sync_sys_cfg
+    spiq_complete_cb * complete_cb;
+    void * complete_arg;
+    hal_spi_txrx_cb chain_cb;       // Bus callback installed before the queue
+    void * chain_arg;
+    struct os_sem sem;
+    spiq_stats_t stats;
+    spiq_cmd_t cmds[MYNEWT_VAL(SPIQ_NCMDS)];
+    uint8_t arena[MYNEWT_VAL(SPIQ_ARENA_SIZE)];
+}spiq_instance_t;
+
+/**
+ * [spiq_init description]
+ * Attach a queue to the SPI bus of a dw1000 instance and install the
+ * transfer completion callback. One queue per bus. The HAL cannot report the
+ * callback already installed on the bus; pass it as chain_cb and completions
+ * of transfers the queue did not start are handed on to it.
+ * @param  spiq      [Queue instance]
+ * @param  inst      [dw1000 instance]
+ * @param  chain_cb  [Bus callback installed before the queue, may be NULL]
+ * @param  chain_arg [Its argument]
+ * @return           [Queue instance]
+ */
+spiq_instance_t * spiq_init(spiq_instance_t * spiq, struct _dw1000_dev_instance_t * inst,
+        hal_spi_txrx_cb chain_cb, void * chain_arg);
+
+/**
+ * [spiq_sync_sys_cfg description]
+ * Report a SYS_CFG value written outside the queue. spiq_set_rx_timeout rewrites
+ * the top byte of SYS_CFG from a copy read at spiq_init, so a blocking change of
+ * RXAUTR, AUTOACK or AACKPEND must be reported here. RXWTOE is ignored.
+ * @param  spiq    [Queue instance]
+ * @param  sys_cfg [SYS_CFG as written]
+ */
+void spiq_sync_sys_cfg(spiq_instance_t * spiq, uint32_t sys_cfg);
+
+/**
+ * [spiq_begin description]
+ * Start a new batch, waiting for the previous one to complete.
+ * @param  spiq [Queue instance]
+ */
+void spiq_begin(spiq_instance_t * spiq);
+
+/**
+ * [spiq_write description]
+ * Queue a register write. The data is copied into the arena.
+ * @param  spiq       [Queue instance]
+ * @param  reg        [Register file]
+ * @param  subaddress [Offset within the register file]
+ * @param  buffer     [Data]
+ * @param  length     [Bytes]
+ */
+void spiq_write(spiq_instance_t * spiq, uint16_t reg, uint16_t subaddress, const uint8_t * buffer, uint16_t length);
+
+/**
+ * [spiq_read description]
+ * Queue a register read. buffer is filled before the completion callback runs.
+ */
+void spiq_read(spiq_instance_t * spiq, uint16_t reg, uint16_t subaddress, uint8_t * buffer, uint16_t length);
+
+/**
+ * [spiq_write_reg description]
+ * Queue a write of the nbytes low bytes of val, little endian.
+ */
+void spiq_write_reg(spiq_instance_t * spiq, uint16_t reg, uint16_t subaddress, uint64_t val, uint16_t nbytes);
+
+/*
+ * Queued counterparts of the dw1000_mac.h transmit setup calls, in the
+ * order of a delayed response.
+ */
+void spiq_write_tx(spiq_instance_t * spiq, const uint8_t * buffer, uint16_t tx_buffer_offset, uint16_t length);
+void spiq_write_tx_fctrl(spiq_instance_t * spiq, uint16_t tx_frame_length, uint16_t tx_buffer_offset, bool ranging);
+void spiq_set_delay_start(spiq_instance_t * spiq, uint64_t delay);
+
+/**
+ * [spiq_set_rx_timeout description]
+ * Queue RX_FWTO and the RXWTOE bit of SYS_CFG, as dw1000_set_rx_timeout, 0 disables
+ * the timeout. The other bits of the top byte of SYS_CFG come from the copy kept
+ * by the queue, nothing is read while staging.
+ * @param  spiq    [Queue instance]
+ * @param  timeout [usec]
+ */
+void spiq_set_rx_timeout(spiq_instance_t * spiq, uint16_t timeout);
+
+/**
+ * [spiq_start_tx description]
+ * Queue the transmit start, honouring dw1000_set_wait4resp and spiq_set_delay_start.
+ * A delayed start is followed by a read of HPDWARN; when late the transceiver
+ * is forced off and status.start_tx_error is set before completion.
+ * @param  spiq [Queue instance]
+ */
+void spiq_start_tx(spiq_instance_t * spiq);
+
+/**
+ * [spiq_submit description]
+ * Execute the batch. The driver's SPI semaphore is held from the first
+ * transaction to the last, blocking accessors wait for the batch. Returns once
+ * the first transaction is started; cb runs in interrupt context after the last.
+ * @param  spiq [Queue instance]
+ * @param  cb   [Completion callback, may be NULL]
+ * @param  arg  [Callback argument]
+ * @return      [0 on success, -1 if the batch overflowed]
+ */
+int spiq_submit(spiq_instance_t * spiq, spiq_complete_cb * cb, void * arg);
+
+/**
+ * [spiq_wait description]
+ * Wait for the submitted batch to complete.
+ * @param  spiq    [Queue instance]
+ * @param  timeout [os ticks]
+ * @return         [OS_OK or OS_TIMEOUT]
+ */
+os_error_t spiq_wait(spiq_instance_t * spiq, os_time_t timeout);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* _DW1000_SPIQ_H_ */
@@ -0,0 +1,317 @@
+/*
+ * Copyright 2018, Decawave Limited, All Rights Reserved
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <os/os.h>
+#include <hal/hal_spi.h>
+#include <hal/hal_gpio.h>
+#include "syscfg/syscfg.h"
+
+#include <dw1000/dw1000_regs.h>
+#include <dw1000/dw1000_dev.h>
+#include <dw1000/dw1000_hal.h>
+#include <spiq/dw1000_spiq.h>
+
+#define SPIQ_NCMDS MYNEWT_VAL(SPIQ_NCMDS)
+#define SPIQ_ARENA_SIZE MYNEWT_VAL(SPIQ_ARENA_SIZE)
+
+static void spiq_next(spiq_instance_t * spiq);
+#ifndef ARCH_sim
+static void spiq_txrx_cb(void * arg, int len);
+#endif
+
+/*
+ * dw1000 SPI transaction header: R/W and sub-index flags with the register
+ * file id, then a 7 bit or extended 15 bit sub-address.
+ */
+static uint8_t
+spiq_header(uint8_t * header, uint16_t reg, uint16_t subaddress, bool write){
+    header[0] = (write ? 0x80 : 0) | (reg & 0x3F);
+    if (subaddress == 0)
+        return 1;
+    header[0] |= 0x40;
+    if (subaddress < 0x80){
+        header[1] = (uint8_t) subaddress;
+        return 2;
+    }
+    header[1] = 0x80 | (subaddress & 0x7F);
+    header[2] = (uint8_t)(subaddress >> 7);
+    return 3;
+}
+
+static spiq_cmd_t *
+spiq_stage(spiq_instance_t * spiq, uint16_t reg, uint16_t subaddress, uint16_t length, uint8_t * rxbuf){
+    uint16_t size = (3 + length) * (rxbuf ? 2 : 1);
+
+    if (spiq->ncmds == SPIQ_NCMDS || spiq->arena_len + size > SPIQ_ARENA_SIZE){
+        spiq->status.overflow = 1;
+        return NULL;
+    }
+    spiq_cmd_t * cmd = &spiq->cmds[spiq->ncmds++];
+    cmd->reg = reg;
+    cmd->subaddress = subaddress;
+    cmd->offset = spiq->arena_len;
+    cmd->hlen = spiq_header(spiq->arena + cmd->offset, reg, subaddress, rxbuf == NULL);
+    cmd->len = cmd->hlen + length;
+    cmd->rxbuf = rxbuf;
+    cmd->late_only = 0;
+    spiq->arena_len += cmd->len;
+    if (rxbuf){
+        // Dummy bytes clocked out while reading, then room for what is clocked in
+        memset(spiq->arena + cmd->offset + cmd->hlen, 0, length);
+        spiq->arena_len += cmd->len;
+    }
+    return cmd;
+}
+
+spiq_instance_t *
+spiq_init(spiq_instance_t * spiq, struct _dw1000_dev_instance_t * inst,
+        hal_spi_txrx_cb chain_cb, void * chain_arg){
+    assert(spiq);
+    assert(inst);
+
+    memset(spiq, 0, sizeof(spiq_instance_t));
+    spiq->parent = inst;
+    spiq->chain_cb = chain_cb;
+    spiq->chain_arg = chain_arg;
+    spiq_sync_sys_cfg(spiq, (uint32_t) dw1000_read_reg(inst, SYS_CFG_ID, 0, sizeof(uint32_t)));
+    os_error_t err = os_sem_init(&spiq->sem, 0x1);
+    assert(err == OS_OK);
+#ifndef ARCH_sim
+    // The blocking driver accessors poll and are unaffected by the callback
+    hal_spi_disable(inst->spi_num);
+    hal_spi_set_txrx_cb(inst->spi_num, spiq_txrx_cb, spiq);
+    hal_spi_enable(inst->spi_num);
+#endif
+    return spiq;
+}
+
+void
+spiq_sync_sys_cfg(spiq_instance_t * spiq, uint32_t sys_cfg){
+    spiq->sys_cfg = (uint8_t)((sys_cfg & ~SYS_CFG_RXWTOE) >> 24);
+}
+
+void
+spiq_begin(spiq_instance_t * spiq){
+    os_error_t err = os_sem_pend(&spiq->sem, OS_TIMEOUT_NEVER);
+    assert(err == OS_OK);
+
+    spiq->status = (spiq_status_t){.busy = 1};
+    spiq->ncmds = 0;
+    spiq->idx = 0;
+    spiq->arena_len = 0;
+}
+
+void
+spiq_write(spiq_instance_t * spiq, uint16_t reg, uint16_t subaddress, const uint8_t * buffer, uint16_t length){
+    spiq_cmd_t * cmd = spiq_stage(spiq, reg, subaddress, length, NULL);
+    if (cmd)
+        memcpy(spiq->arena + cmd->offset + cmd->hlen, buffer, length);
+}
+
+void
+spiq_read(spiq_instance_t * spiq, uint16_t reg, uint16_t subaddress, uint8_t * buffer, uint16_t length){
+    spiq_stage(spiq, reg, subaddress, length, buffer);
+}
+
+static spiq_cmd_t *
+spiq_stage_reg(spiq_instance_t * spiq, uint16_t reg, uint16_t subaddress, uint64_t val, uint16_t nbytes){
+    assert(nbytes <= sizeof(uint64_t));
+    spiq_cmd_t * cmd = spiq_stage(spiq, reg, subaddress, nbytes, NULL);
+    if (cmd == NULL)
+        return NULL;
+    uint8_t * data = spiq->arena + cmd->offset + cmd->hlen;
+    for (uint16_t i = 0; i < nbytes; i++, val >>= 8)
+        data[i] = (uint8_t) val;
+    return cmd;
+}
+
+void
+spiq_write_reg(spiq_instance_t * spiq, uint16_t reg, uint16_t subaddress, uint64_t val, uint16_t nbytes){
+    spiq_stage_reg(spiq, reg, subaddress, val, nbytes);
+}
+
+void
+spiq_write_tx(spiq_instance_t * spiq, const uint8_t * buffer, uint16_t tx_buffer_offset, uint16_t length){
+    spiq_write(spiq, TX_BUFFER_ID, tx_buffer_offset, buffer, length);
+}
+
+void
+spiq_write_tx_fctrl(spiq_instance_t * spiq, uint16_t tx_frame_length, uint16_t tx_buffer_offset, bool ranging){
+    dw1000_dev_instance_t * inst = spiq->parent;
+    // As dw1000_write_tx_fctrl, the length given excludes the FCS
+    uint32_t tx_fctrl_reg = inst->tx_fctrl | (tx_frame_length + 2) | (tx_buffer_offset << TX_FCTRL_TXBOFFS_SHFT) | (ranging << TX_FCTRL_TR_SHFT);
+    spiq_write_reg(spiq, TX_FCTRL_ID, 0, tx_fctrl_reg, sizeof(uint32_t));
+}
+
+void
+spiq_set_delay_start(spiq_instance_t * spiq, uint64_t delay){
+    // DX_TIME ignores the low 9 bits, the first byte is not written
+    spiq->status.delay_start = 1;
+    spiq_write_reg(spiq, DX_TIME_ID, 1, delay >> 8, DX_TIME_LEN - 1);
+}
+
+void
+spiq_set_rx_timeout(spiq_instance_t * spiq, uint16_t timeout){
+    // RXWTOE shares the top byte of SYS_CFG with RXAUTR, AUTOACK and AACKPEND, keep them
+    uint8_t sys_cfg = spiq->sys_cfg;
+
+    if (timeout){
+        spiq_write_reg(spiq, RX_FWTO_ID, 0, timeout, sizeof(uint16_t));
+        sys_cfg |= (uint8_t)(SYS_CFG_RXWTOE >> 24);
+    }
+    spiq_write_reg(spiq, SYS_CFG_ID, 3, sys_cfg, sizeof(uint8_t));
+}
+
+void
+spiq_start_tx(spiq_instance_t * spiq){
+    dw1000_dev_instance_t * inst = spiq->parent;
+    uint8_t sys_ctrl = SYS_CTRL_TXSTRT;
+
+    if (spiq->status.delay_start)
+        sys_ctrl |= SYS_CTRL_TXDLYS;
+    if (inst->control.wait4resp_enabled)
+        sys_ctrl |= SYS_CTRL_WAIT4RESP;
+    spiq->status.start_tx = 1;
+    spiq_write_reg(spiq, SYS_CTRL_ID, 0, sys_ctrl, sizeof(uint8_t));
+
+    if (spiq->status.delay_start){
+        // HPDWARN is bit 3 of the top status byte, as checked by dw1000_start_tx
+        spiq_cmd_t * cmd;
+        spiq_read(spiq, SYS_STATUS_ID, 3, &spiq->sys_status, sizeof(uint8_t));
+        if ((cmd = spiq_stage_reg(spiq, SYS_CTRL_ID, 0, SYS_CTRL_TRXOFF, sizeof(uint8_t))))
+            cmd->late_only = 1;
+        if ((cmd = spiq_stage_reg(spiq, SYS_STATUS_ID, 0, SYS_STATUS_ALL_TX, sizeof(uint32_t))))
+            cmd->late_only = 1;
+    }
+}
+
+/*
+ * Bookkeeping once a transaction is on the wire, common to the bus and sim paths.
+ */
+static void
+spiq_done(spiq_instance_t * spiq, spiq_cmd_t * cmd){
+    spiq->stats.ncmds++;
+    spiq->stats.nbytes += cmd->len;
+    spiq->stats.bus_nsecs += (uint64_t) cmd->len * 8 * 1000000 / MYNEWT_VAL(SPIQ_BUS_KHZ);
+    spiq->stats.txn_nsecs += MYNEWT_VAL(SPIQ_TXN_NSECS);
+    spiq->stats.isr_nsecs += MYNEWT_VAL(SPIQ_ISR_NSECS);
+
+    if (cmd->rxbuf == &spiq->sys_status && (spiq->sys_status & (uint8_t)(SYS_STATUS_HPDWARN >> 24)))
+        spiq->status.start_tx_error = 1;
+}
+
+static void
+spiq_complete(spiq_instance_t * spiq){
+#ifndef ARCH_sim
+    if (spiq->parent->spi_sem)
+        os_sem_release(spiq->parent->spi_sem);
+#endif
+    spiq->status.running = 0;
+    spiq->status.busy = 0;
+    spiq->stats.nbatches++;
+    if (spiq->complete_cb)
+        spiq->complete_cb(spiq, spiq->complete_arg);
+    os_sem_release(&spiq->sem);
+}
+
+#ifndef ARCH_sim
+static void
+spiq_txrx_cb(void * arg, int len){
+    spiq_instance_t * spiq = (spiq_instance_t *) arg;
+    if (!spiq->status.running){
+        if (spiq->chain_cb)
+            spiq->chain_cb(spiq->chain_arg, len);
+        return;
+    }
+    spiq_cmd_t * cmd = &spiq->cmds[spiq->idx++];
+
+    hal_gpio_write(spiq->parent->ss_pin, 1);
+    if (cmd->rxbuf)
+        memcpy(cmd->rxbuf, spiq->arena + cmd->offset + cmd->len + cmd->hlen, cmd->len - cmd->hlen);
+    spiq_done(spiq, cmd);
+    spiq_next(spiq);
+}
+#endif
+
+static void
+spiq_next(spiq_instance_t * spiq){
+    while (spiq->idx < spiq->ncmds && spiq->cmds[spiq->idx].late_only && !spiq->status.start_tx_error)
+        spiq->idx++;
+    if (spiq->idx == spiq->ncmds){
+        spiq_complete(spiq);
+        return;
+    }
+    spiq_cmd_t * cmd = &spiq->cmds[spiq->idx];
+    dw1000_dev_instance_t * inst = spiq->parent;
+#ifdef ARCH_sim
+    // No bus, run the transaction through the driver and account it as if clocked out
+    if (cmd->rxbuf)
+        dw1000_read(inst, cmd->reg, cmd->subaddress, cmd->rxbuf, cmd->len - cmd->hlen);
+    else
+        dw1000_write(inst, cmd->reg, cmd->subaddress, spiq->arena + cmd->offset + cmd->hlen, cmd->len - cmd->hlen);
+    spiq->idx++;
+    spiq_done(spiq, cmd);
+    spiq_next(spiq);
+#else
+    hal_gpio_write(inst->ss_pin, 0);
+    int rc = hal_spi_txrx_noblock(inst->spi_num, spiq->arena + cmd->offset,
+                cmd->rxbuf ? spiq->arena + cmd->offset + cmd->len : NULL, cmd->len);
+    if (rc){
+        hal_gpio_write(inst->ss_pin, 1);
+        spiq->status.spi_error = 1;
+        spiq_complete(spiq);
+    }
+#endif
+}
+
+int
+spiq_submit(spiq_instance_t * spiq, spiq_complete_cb * cb, void * arg){
+    assert(spiq->status.busy);
+
+    if (spiq->status.overflow){
+        spiq->status.busy = 0;
+        os_sem_release(&spiq->sem);
+        return -1;
+    }
+    spiq->complete_cb = cb;
+    spiq->complete_arg = arg;
+    spiq->idx = 0;
+#ifndef ARCH_sim
+    // On the sim the transactions go through the driver accessors, which take the semaphore themselves
+    if (spiq->parent->spi_sem){
+        os_error_t err = os_sem_pend(spiq->parent->spi_sem, OS_TIMEOUT_NEVER);
+        assert(err == OS_OK);
+    }
+#endif
+    spiq->status.running = 1;
+    spiq_next(spiq);
+    return 0;
+}
+
+os_error_t
+spiq_wait(spiq_instance_t * spiq, os_time_t timeout){
+    os_error_t err = os_sem_pend(&spiq->sem, timeout);
+    if (err == OS_OK)
+        os_sem_release(&spiq->sem);
+    return err;
+}
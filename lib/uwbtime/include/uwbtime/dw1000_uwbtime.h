@@ -0,0 +1,130 @@
+/**
+ * Copyright 2018, Decawave Limited, All Rights Reserved
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _DW1000_UWBTIME_H_
+#define _DW1000_UWBTIME_H_
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "syscfg/syscfg.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <os/os.h>
+#include <os/os_cputime.h>
+#include <dw1000/dw1000_dev.h>
+
+/*
+ * dw1000 system time runs at 499.2MHz * 128 (~15.65ps per unit) over 40 bits.
+ * uwbtime extends it to a wrap free 64-bit count, the 40-bit timestamps and
+ * delayed tx times used by the driver being its low bits, and keeps a least
+ * squares fit of os_cputime against it from periodic paired reads.
+ */
+#define UWBTIME_FREQ 63897600000ULL
+#define UWBTIME_MASK 0xFFFFFFFFFFULL
+
+typedef struct _uwbtime_status_t{
+    uint16_t started:1;
+    uint16_t valid:1;               // Fit from at least two samples
+}uwbtime_status_t;
+
+typedef struct _uwbtime_instance_t{
+    struct _dw1000_dev_instance_t * parent;
+    uwbtime_status_t status;
+    uint64_t last;                  // Latest extended time seen
+    uint64_t uwb_ref;               // Fit reference point
+    uint32_t cputime_ref;
+    double ratio;                   // os_cputime ticks per dw1000 time unit
+    uint16_t nsamples;
+    uint16_t idx;
+    uint32_t ndiscarded;
+    uint64_t uwb[MYNEWT_VAL(UWBTIME_NSAMPLES)];
+    uint32_t cputime[MYNEWT_VAL(UWBTIME_NSAMPLES)];
+    struct os_callout callout;
+}uwbtime_instance_t;
+
+/**
+ * [uwbtime_init description]
+ * Initialise with the nominal os_cputime to dw1000 ratio.
+ * @param  uwbtime [Time base instance]
+ * @param  inst    [dw1000 instance]
+ * @return         [Time base instance]
+ */
+uwbtime_instance_t * uwbtime_init(uwbtime_instance_t * uwbtime, struct _dw1000_dev_instance_t * inst);
+
+/**
+ * [uwbtime_start description]
+ * Take a first sample and correlate every UWBTIME_PERIOD_MS on the default event queue.
+ */
+void uwbtime_start(uwbtime_instance_t * uwbtime);
+
+/**
+ * [uwbtime_stop description]
+ * Stop correlating. Extension is no longer guaranteed past half a wrap.
+ */
+void uwbtime_stop(uwbtime_instance_t * uwbtime);
+
+/**
+ * [uwbtime_extend description]
+ * Extend a 40-bit dw1000 time, timestamp or delayed tx time, to 64 bits.
+ * Valid for times within half a wrap (8.6s) of the latest time seen.
+ * @param  uwbtime [Time base instance]
+ * @param  time    [40-bit dw1000 time]
+ * @return         [64-bit dw1000 time]
+ */
+uint64_t uwbtime_extend(uwbtime_instance_t * uwbtime, uint64_t time);
+
+/**
+ * [uwbtime_now description]
+ * Current 64-bit dw1000 time, reads the system time.
+ */
+uint64_t uwbtime_now(uwbtime_instance_t * uwbtime);
+
+/**
+ * [uwbtime_to_cputime description]
+ * os_cputime at which the dw1000 reaches a 64-bit time.
+ */
+uint32_t uwbtime_to_cputime(uwbtime_instance_t * uwbtime, uint64_t time);
+
+/**
+ * [uwbtime_from_cputime description]
+ * 64-bit dw1000 time at an os_cputime, within half an os_cputime wrap of the last correlation.
+ */
+uint64_t uwbtime_from_cputime(uwbtime_instance_t * uwbtime, uint32_t cputime);
+
+/**
+ * [uwbtime_timer_start description]
+ * Arm an os_cputime timer to expire lead_usecs ahead of a dw1000 time, e.g.
+ * to prepare a delayed transmission.
+ * @param  uwbtime    [Time base instance]
+ * @param  timer      [Initialised os_cputime timer]
+ * @param  time       [64-bit dw1000 time]
+ * @param  lead_usecs [Lead]
+ */
+void uwbtime_timer_start(uwbtime_instance_t * uwbtime, struct hal_timer * timer, uint64_t time, uint32_t lead_usecs);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* _DW1000_UWBTIME_H_ */
@@ -0,0 +1,178 @@
+/*
+ * Copyright 2018, Decawave Limited, All Rights Reserved
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <os/os.h>
+#include <os/os_cputime.h>
+#include "syscfg/syscfg.h"
+
+#include <dw1000/dw1000_dev.h>
+#include <dw1000/dw1000_hal.h>
+#include <dw1000/dw1000_mac.h>
+#include <uwbtime/dw1000_uwbtime.h>
+
+#define UWBTIME_NSAMPLES MYNEWT_VAL(UWBTIME_NSAMPLES)
+
+_Static_assert(MYNEWT_VAL(UWBTIME_PERIOD_MS) < 8000, "UWBTIME_PERIOD_MS must stay below half a 40-bit wrap");
+
+/*
+ * Least squares slope of cputime against uwb over the sample ring, relative
+ * to the newest sample to keep the sums small. The reference point is moved
+ * onto the fitted line so conversions carry no single-read jitter.
+ */
+static void
+uwbtime_fit(uwbtime_instance_t * uwbtime){
+    uint16_t n = uwbtime->nsamples;
+    uint16_t newest = (uwbtime->idx + UWBTIME_NSAMPLES - 1) % UWBTIME_NSAMPLES;
+    uint64_t uwb_ref = uwbtime->uwb[newest];
+    uint32_t cputime_ref = uwbtime->cputime[newest];
+    double sx = 0, sy = 0, sxx = 0, sxy = 0;
+
+    for (uint16_t i = 0; i < n; i++){
+        double x = (double)(int64_t)(uwbtime->uwb[i] - uwb_ref);
+        double y = (double)(int32_t)(uwbtime->cputime[i] - cputime_ref);
+        sx += x; sy += y;
+        sxx += x * x; sxy += x * y;
+    }
+    double den = n * sxx - sx * sx;
+    if (n < 2 || den <= 0){
+        // Nominal ratio around the single sample until a second one is in
+        uwbtime->uwb_ref = uwb_ref;
+        uwbtime->cputime_ref = cputime_ref;
+        return;
+    }
+
+    double ratio = (n * sxy - sx * sy) / den;
+    double offset = (sy - ratio * sx) / n;      // Fitted cputime at uwb_ref, relative to cputime_ref
+
+    os_sr_t sr;
+    OS_ENTER_CRITICAL(sr);
+    uwbtime->ratio = ratio;
+    uwbtime->uwb_ref = uwb_ref;
+    uwbtime->cputime_ref = cputime_ref + (int32_t)(offset < 0 ? offset - 0.5 : offset + 0.5);
+    uwbtime->status.valid = 1;
+    OS_EXIT_CRITICAL(sr);
+}
+
+static void
+uwbtime_sample(uwbtime_instance_t * uwbtime){
+    uint32_t tic = os_cputime_get32();
+    uint64_t systime = dw1000_read_systime(uwbtime->parent);
+    uint32_t toc = os_cputime_get32();
+
+    uint64_t time = uwbtime_extend(uwbtime, systime);
+    if (toc - tic > MYNEWT_VAL(UWBTIME_MAX_READ_TICKS)){
+        uwbtime->ndiscarded++;
+        return;
+    }
+    uwbtime->uwb[uwbtime->idx] = time;
+    uwbtime->cputime[uwbtime->idx] = tic + (toc - tic) / 2;
+    uwbtime->idx = (uwbtime->idx + 1) % UWBTIME_NSAMPLES;
+    if (uwbtime->nsamples < UWBTIME_NSAMPLES)
+        uwbtime->nsamples++;
+    uwbtime_fit(uwbtime);
+}
+
+static void
+uwbtime_callout_cb(struct os_event * ev){
+    uwbtime_instance_t * uwbtime = (uwbtime_instance_t *) ev->ev_arg;
+
+    uwbtime_sample(uwbtime);
+    os_callout_reset(&uwbtime->callout, OS_TICKS_PER_SEC * MYNEWT_VAL(UWBTIME_PERIOD_MS) / 1000);
+}
+
+uwbtime_instance_t *
+uwbtime_init(uwbtime_instance_t * uwbtime, struct _dw1000_dev_instance_t * inst){
+    assert(uwbtime);
+    assert(inst);
+
+    memset(uwbtime, 0, sizeof(uwbtime_instance_t));
+    uwbtime->parent = inst;
+    uwbtime->ratio = (double) MYNEWT_VAL(OS_CPUTIME_FREQ) / UWBTIME_FREQ;
+    os_callout_init(&uwbtime->callout, os_eventq_dflt_get(), uwbtime_callout_cb, uwbtime);
+    return uwbtime;
+}
+
+void
+uwbtime_start(uwbtime_instance_t * uwbtime){
+    uwbtime->status.started = 1;
+    uwbtime->last = dw1000_read_systime(uwbtime->parent);
+    uwbtime_sample(uwbtime);
+    os_callout_reset(&uwbtime->callout, OS_TICKS_PER_SEC * MYNEWT_VAL(UWBTIME_PERIOD_MS) / 1000);
+}
+
+void
+uwbtime_stop(uwbtime_instance_t * uwbtime){
+    os_callout_stop(&uwbtime->callout);
+    uwbtime->status.started = 0;
+}
+
+uint64_t
+uwbtime_extend(uwbtime_instance_t * uwbtime, uint64_t time){
+    os_sr_t sr;
+    OS_ENTER_CRITICAL(sr);
+    uint64_t last = uwbtime->last;
+    uint64_t delta = (time - last) & UWBTIME_MASK;
+    uint64_t extended;
+    if (delta & (1ULL << 39)){
+        // Behind the latest time seen, e.g. a timestamp read after a correlation
+        extended = last - ((UWBTIME_MASK + 1) - delta);
+    }else{
+        extended = last + delta;
+        uwbtime->last = extended;
+    }
+    OS_EXIT_CRITICAL(sr);
+    return extended;
+}
+
+uint64_t
+uwbtime_now(uwbtime_instance_t * uwbtime){
+    return uwbtime_extend(uwbtime, dw1000_read_systime(uwbtime->parent));
+}
+
+uint32_t
+uwbtime_to_cputime(uwbtime_instance_t * uwbtime, uint64_t time){
+    os_sr_t sr;
+    OS_ENTER_CRITICAL(sr);
+    int64_t dx = (int64_t)(time - uwbtime->uwb_ref);
+    uint32_t cputime = uwbtime->cputime_ref;
+    double ratio = uwbtime->ratio;
+    OS_EXIT_CRITICAL(sr);
+    return cputime + (int32_t)((double) dx * ratio);
+}
+
+uint64_t
+uwbtime_from_cputime(uwbtime_instance_t * uwbtime, uint32_t cputime){
+    os_sr_t sr;
+    OS_ENTER_CRITICAL(sr);
+    int32_t dy = (int32_t)(cputime - uwbtime->cputime_ref);
+    uint64_t time = uwbtime->uwb_ref;
+    double ratio = uwbtime->ratio;
+    OS_EXIT_CRITICAL(sr);
+    return time + (int64_t)((double) dy / ratio);
+}
+
+void
+uwbtime_timer_start(uwbtime_instance_t * uwbtime, struct hal_timer * timer, uint64_t time, uint32_t lead_usecs){
+    uint32_t ticks = uwbtime_to_cputime(uwbtime, time) - os_cputime_usecs_to_ticks(lead_usecs);
+    os_cputime_timer_start(timer, ticks);
+}